@@ -0,0 +1,89 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "budget_ops.h"
+
+// Oldest texture first, evicted from the front
+typedef struct {
+	void **textures;
+	int first;
+	int count;
+	int capacity;
+	size_t texture_size;
+	size_t evicted;
+} texture_cache;
+
+static void evict(texture_cache *cache, tlsf_instance *instance, int count) {
+
+	for (int i = 0; i < count && cache -> count > 0; i++) {
+		sdl_tlsf_instance_free(instance, cache -> textures[cache -> first], cache -> texture_size);
+		cache -> first = (cache -> first + 1) % cache -> capacity;
+		cache -> count--;
+		cache -> evicted++;
+	}
+}
+
+// A soft warning trims a quarter of the cache, a hard one half of it, and always at least what was asked for
+static void texture_pressure(tlsf_instance *instance, tlsf_pressure_level level, size_t needed, void *userdata) {
+
+	texture_cache *cache = userdata;
+
+	int count = level == SDL_TLSF_PRESSURE_HARD ? cache -> count / 2 : cache -> count / 4;
+	int covering = (int)((needed + cache -> texture_size - 1) / cache -> texture_size);
+
+	evict(cache, instance, count > covering ? count : covering);
+}
+
+static void run_stream(const char *label, int evicting, int textures, size_t texture_size,
+					   size_t soft_limit, size_t hard_limit) {
+
+	texture_cache cache = {0};
+	cache.capacity = textures;
+	cache.texture_size = texture_size;
+	cache.textures = SDL_malloc(sizeof(void *) * textures);
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 4);
+	sdl_tlsf_set_budget(instance, soft_limit, hard_limit);
+	if (evicting) {
+		sdl_tlsf_add_pressure_callback(instance, texture_pressure, &cache);
+	}
+	sdl_tlsf_set_instance(instance);
+
+	int failed = 0;
+	for (int i = 0; i < textures; i++) {
+		void *texture = SDL_malloc(texture_size);
+		if (texture == NULL) {
+			failed++;
+			continue;
+		}
+		memset(texture, i, texture_size);
+
+		cache.textures[(cache.first + cache.count) % cache.capacity] = texture;
+		cache.count++;
+	}
+
+	tlsf_budget_stats stats;
+	sdl_tlsf_get_budget(instance, &stats);
+
+	evict(&cache, instance, cache.count);
+	int check = sdl_tlsf_check_active_instance();
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(cache.textures);
+
+	SDL_Log("%s: peak %zu bytes mapped, %zu soft and %zu hard events (%zu recovered), %zu growths denied\n",
+			label, stats.peak_footprint, stats.soft_events, stats.hard_events, stats.hard_recovered, stats.growth_denied);
+	SDL_Log("%zu textures evicted, %d of %d loads failed, heap check %s\n",
+			cache.evicted, failed, textures, check == 0 ? "passed" : "failed");
+}
+
+void budget_pressure_test(int textures, size_t texture_size, size_t soft_limit, size_t hard_limit) {
+
+	SDL_Log("Budgets: %d textures of %zu bytes, %zu soft and %zu hard limit\n", textures, texture_size, soft_limit, hard_limit);
+
+	run_stream("Evicting cache", 1, textures, texture_size, soft_limit, hard_limit);
+	run_stream("No callbacks", 0, textures, texture_size, soft_limit, hard_limit);
+}
@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_BUDGET_OPS_H
+#define TLSF_BUDGET_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Streams textures into a budgeted instance, once with a cache that evicts under pressure and once without
+// Reports how close the footprint got to the limits, the pressure events and the failed loads
+void budget_pressure_test(int textures, size_t texture_size, size_t soft_limit, size_t hard_limit);
+
+#endif //TLSF_BUDGET_OPS_H
@@ -0,0 +1,138 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "cpu_ops.h"
+
+#include <time.h>
+
+#define CPU_LIVE_BLOCKS 64
+#define CPU_IDLE_BURST 256
+#define CPU_CACHE_DEPTH 64
+
+typedef struct {
+	int ops;
+	unsigned int seed;
+} cpu_worker;
+
+// Each thread keeps its own state, rand() would serialize them
+static unsigned int next_random(unsigned int *seed) {
+
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 16;
+}
+
+// Allocates a burst like a worker handling one job, then never allocates again
+static int idle_thread(void *data) {
+
+	void *blocks[CPU_IDLE_BURST];
+	cpu_worker *worker = data;
+
+	for (int i = 0; i < CPU_IDLE_BURST; i++) {
+		blocks[i] = SDL_malloc(16 + (next_random(&worker -> seed) % 240));
+	}
+	for (int i = 0; i < CPU_IDLE_BURST; i++) {
+		SDL_free(blocks[i]);
+	}
+
+	return 0;
+}
+
+// Keeps a window of live blocks and replaces a random one every op
+static int busy_thread(void *data) {
+
+	void *blocks[CPU_LIVE_BLOCKS] = {0};
+	cpu_worker *worker = data;
+
+	for (int i = 0; i < worker -> ops; i++) {
+		int slot = next_random(&worker -> seed) % CPU_LIVE_BLOCKS;
+
+		SDL_free(blocks[slot]);
+		blocks[slot] = SDL_malloc(16 + (next_random(&worker -> seed) % 240));
+		*(char *)blocks[slot] = (char)i;
+	}
+
+	for (int i = 0; i < CPU_LIVE_BLOCKS; i++) {
+		SDL_free(blocks[i]);
+	}
+
+	return 0;
+}
+
+static void run_threads(SDL_ThreadFunction fn, int count, int ops) {
+
+	SDL_Thread **threads = SDL_malloc(sizeof(SDL_Thread *) * count);
+	cpu_worker *workers = SDL_malloc(sizeof(cpu_worker) * count);
+
+	for (int i = 0; i < count; i++) {
+		workers[i].ops = ops;
+		workers[i].seed = 231 + i;
+		threads[i] = SDL_CreateThread(fn, "Worker", &workers[i]);
+	}
+	for (int i = 0; i < count; i++) {
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	SDL_free(workers);
+	SDL_free(threads);
+}
+
+// mode 0 runs without a cache, 1 on the spinlock fallback, 2 asks for rseq
+static double run_mode(int mode, int idle_threads, int busy_threads, int ops_per_thread) {
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 16);
+	if (instance == NULL) {
+		return 0;
+	}
+
+	if (mode > 0) {
+		sdl_tlsf_enable_cpu_cache(instance, CPU_CACHE_DEPTH, mode == 2);
+	}
+	sdl_tlsf_set_instance(instance);
+
+	run_threads(idle_thread, idle_threads, 0);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	run_threads(busy_thread, busy_threads, ops_per_thread);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+	ns /= (double)busy_threads * ops_per_thread * 2;
+
+	// Everything was freed, so whatever is still in use is sitting in the caches
+	if (mode > 0) {
+		tlsf_cpu_cache *cache = instance -> cpu_cache;
+		size_t cached = sdl_tlsf_cpu_cache_count(cache);
+		size_t cached_bytes = instance -> total_used;
+		int cpus = sdl_tlsf_cpu_cache_num_cpus(cache);
+		int rseq = sdl_tlsf_cpu_cache_uses_rseq(cache);
+
+		sdl_tlsf_disable_cpu_cache(instance);
+
+		SDL_Log("%s: %.1f ns per op, %d CPUs cache %zu blocks (%zu bytes) for %d threads, %zu bytes in use after flushing\n",
+				rseq ? "rseq" : "Spinlock fallback", ns, cpus, cached, cached_bytes, idle_threads + busy_threads,
+				instance -> total_used);
+	} else {
+		SDL_Log("Locked: %.1f ns per op\n", ns);
+	}
+
+	int check = sdl_tlsf_check_active_instance();
+	if (check != 0) {
+		SDL_Log("Heap check failed after the per-CPU cache run\n");
+	}
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	return ns;
+}
+
+void cpu_cache_test(int idle_threads, int busy_threads, int ops_per_thread) {
+
+	SDL_Log("Per-CPU caches: %d idle and %d busy threads, %d ops each\n", idle_threads, busy_threads, ops_per_thread);
+
+	run_mode(0, idle_threads, busy_threads, ops_per_thread);
+	run_mode(1, idle_threads, busy_threads, ops_per_thread);
+	run_mode(2, idle_threads, busy_threads, ops_per_thread);
+}
@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_CPU_OPS_H
+#define TLSF_CPU_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Many worker threads that allocate a burst and go idle, then a few busy ones churning small blocks
+// Times the busy threads with the lock, the spinlock fallback and rseq, and shows how much the caches hold
+void cpu_cache_test(int idle_threads, int busy_threads, int ops_per_thread);
+
+#endif //TLSF_CPU_OPS_H
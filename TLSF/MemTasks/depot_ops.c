@@ -0,0 +1,87 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "depot_ops.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+#define DEPOT_BLOCK_SIZE 4096
+
+static long minor_faults(void) {
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_minflt;
+}
+
+// Fills the instance with level_bytes of touched blocks, then frees them all so its pools empty out
+static void load_level(tlsf_instance *level, void **blocks, size_t count) {
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	sdl_tlsf_set_instance(level);
+
+	for (size_t i = 0; i < count; i++) {
+		blocks[i] = SDL_malloc(DEPOT_BLOCK_SIZE);
+		memset(blocks[i], (int)i, DEPOT_BLOCK_SIZE);
+	}
+	for (size_t i = 0; i < count; i++) {
+		SDL_free(blocks[i]);
+	}
+
+	sdl_tlsf_set_instance(previous);
+}
+
+static void run_levels(const char *label, size_t max_bytes, tlsf_depot_advice advice,
+					   int levels, size_t pool_size, size_t level_bytes) {
+
+	size_t count = level_bytes / DEPOT_BLOCK_SIZE;
+	void **blocks = SDL_malloc(sizeof(void *) * count);
+
+	sdl_tlsf_depot_trim(0);
+	sdl_tlsf_depot_configure(max_bytes, advice);
+
+	tlsf_instance *level_a = sdl_tlsf_create_instance(pool_size);
+	tlsf_instance *level_b = sdl_tlsf_create_instance(pool_size);
+
+	tlsf_depot_stats before, after;
+	sdl_tlsf_depot_get_stats(&before);
+	long faults = minor_faults();
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < levels; i++) {
+		load_level(i % 2 ? level_b : level_a, blocks, count);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	faults = minor_faults() - faults;
+	sdl_tlsf_depot_get_stats(&after);
+
+	sdl_tlsf_destroy_instance(level_a);
+	sdl_tlsf_destroy_instance(level_b);
+	SDL_free(blocks);
+
+	size_t hits = after.hits - before.hits;
+	size_t misses = after.misses - before.misses;
+	size_t syscalls = (after.mmaps - before.mmaps) + (after.munmaps - before.munmaps) + (after.madvises - before.madvises);
+	double ms = (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+
+	SDL_Log("%s: %.1f ms, %ld page faults, %zu hits %zu misses (%.1f%% hit rate), %zu pool system calls\n",
+			label, ms, faults, hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0, syscalls);
+}
+
+void depot_level_test(int levels, size_t pool_size, size_t level_bytes) {
+
+	SDL_Log("Pool depot: %d level loads of %zu bytes on %zu byte pools\n", levels, level_bytes, pool_size);
+
+	run_levels("No depot", 0, SDL_TLSF_DEPOT_KEEP, levels, pool_size, level_bytes);
+	run_levels("Depot", SDL_TLSF_DEPOT_DEFAULT_BYTES, SDL_TLSF_DEPOT_KEEP, levels, pool_size, level_bytes);
+	run_levels("Depot with MADV_FREE", SDL_TLSF_DEPOT_DEFAULT_BYTES, SDL_TLSF_DEPOT_FREE, levels, pool_size, level_bytes);
+	run_levels("Depot with MADV_DONTNEED", SDL_TLSF_DEPOT_DEFAULT_BYTES, SDL_TLSF_DEPOT_DONTNEED, levels, pool_size, level_bytes);
+
+	sdl_tlsf_depot_configure(SDL_TLSF_DEPOT_DEFAULT_BYTES, SDL_TLSF_DEPOT_KEEP);
+	sdl_tlsf_depot_trim(0);
+}
@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_DEPOT_OPS_H
+#define TLSF_DEPOT_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Two level instances take turns loading and unloading, so one shrinks while the other grows
+// Runs without the depot, with it, and with it advising the pages away, and reports hits and system calls
+void depot_level_test(int levels, size_t pool_size, size_t level_bytes);
+
+#endif //TLSF_DEPOT_OPS_H
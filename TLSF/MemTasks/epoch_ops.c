@@ -0,0 +1,184 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "epoch_ops.h"
+#include "../SDL_TLSF/sdl_tlsf_epoch.h"
+
+#include <time.h>
+
+#define EPOCH_SLOTS 256
+#define EPOCH_CHECK 0x9e3779b97f4a7c15ull
+
+// Freeing writes TLSF's free list links over the first words, so a reader that got a freed node sees a bad check
+typedef struct {
+	Uint64 key;
+	Uint64 check;
+	char payload[48];
+} epoch_node;
+
+typedef struct {
+	epoch_node *slots[EPOCH_SLOTS];
+
+	int updates;
+	size_t limit;
+	int writers_left;
+
+	size_t reads;
+	size_t corrupt;
+	Uint64 retire_ns;
+} epoch_table;
+
+static epoch_node *new_node(Uint64 key) {
+
+	epoch_node *node = SDL_malloc(sizeof(epoch_node));
+	node -> key = key;
+	node -> check = key * EPOCH_CHECK;
+	return node;
+}
+
+static int reader_thread(void *data) {
+
+	epoch_table *table = data;
+	size_t reads = 0;
+	size_t corrupt = 0;
+
+	while (__atomic_load_n(&table -> writers_left, __ATOMIC_ACQUIRE) > 0) {
+
+		sdl_tlsf_epoch_enter();
+		for (int i = 0; i < EPOCH_SLOTS; i++) {
+			epoch_node *node = __atomic_load_n(&table -> slots[i], __ATOMIC_ACQUIRE);
+			if (node -> check != node -> key * EPOCH_CHECK) {
+				corrupt++;
+			}
+		}
+		sdl_tlsf_epoch_leave();
+
+		reads += EPOCH_SLOTS;
+	}
+
+	__atomic_fetch_add(&table -> reads, reads, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&table -> corrupt, corrupt, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int writer_thread(void *data) {
+
+	epoch_table *table = data;
+	Uint64 key = (Uint64)SDL_GetCurrentThreadID() << 32;
+	double retire_ns = 0;
+
+	sdl_tlsf_epoch_set_limit(table -> limit);
+
+	for (int i = 0; i < table -> updates; i++) {
+		epoch_node *node = new_node(key + i);
+		epoch_node *old = __atomic_exchange_n(&table -> slots[(key + i) % EPOCH_SLOTS], node, __ATOMIC_ACQ_REL);
+
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		sdl_tlsf_retire(old);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		retire_ns += (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+	}
+
+	// Readers are still running, so the barrier has something to wait for
+	sdl_tlsf_epoch_barrier();
+
+	__atomic_fetch_add(&table -> retire_ns, (Uint64)retire_ns, __ATOMIC_RELAXED);
+
+	__atomic_fetch_sub(&table -> writers_left, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void run_table(epoch_table *table, int readers, int writers) {
+
+	SDL_Thread **threads = SDL_malloc(sizeof(SDL_Thread *) * (readers + writers));
+
+	table -> writers_left = writers;
+	table -> reads = 0;
+	table -> corrupt = 0;
+	table -> retire_ns = 0;
+
+	for (int i = 0; i < readers; i++) {
+		threads[i] = SDL_CreateThread(reader_thread, "Reader", table);
+	}
+	for (int i = 0; i < writers; i++) {
+		threads[readers + i] = SDL_CreateThread(writer_thread, "Writer", table);
+	}
+	for (int i = 0; i < readers + writers; i++) {
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	SDL_free(threads);
+}
+
+void epoch_reclaim_test(int readers, int writers, int updates_per_writer) {
+
+	epoch_table *table = SDL_calloc(1, sizeof(epoch_table));
+	table -> updates = updates_per_writer;
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 16);
+	if (instance == NULL) {
+		SDL_free(table);
+		return;
+	}
+	sdl_tlsf_set_instance(instance);
+
+	for (int i = 0; i < EPOCH_SLOTS; i++) {
+		table -> slots[i] = new_node(i);
+	}
+
+	SDL_Log("Epoch reclamation: %d readers, %d writers, %d updates each\n", readers, writers, updates_per_writer);
+
+	// Retire on its own, no readers to wait for, reclamation included
+	epoch_node **nodes = SDL_malloc(sizeof(epoch_node *) * updates_per_writer);
+	for (int i = 0; i < updates_per_writer; i++) {
+		nodes[i] = new_node(i);
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < updates_per_writer; i++) {
+		sdl_tlsf_retire(nodes[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sdl_tlsf_epoch_barrier();
+	SDL_free(nodes);
+
+	double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+	SDL_Log("Uncontended retire: %.1f ns\n", ns / updates_per_writer);
+
+	// The default bound, then one small enough that writers keep running into it
+	size_t limits[] = { SDL_TLSF_EPOCH_DEFAULT_LIMIT, 1 << 16 };
+
+	for (int i = 0; i < 2; i++) {
+		tlsf_epoch_stats before, after;
+		sdl_tlsf_epoch_get_stats(&before);
+
+		table -> limit = limits[i];
+		run_table(table, readers, writers);
+
+		sdl_tlsf_epoch_get_stats(&after);
+
+		SDL_Log("Limit %zu bytes: retire %.1f ns, %zu reads, %zu saw a freed node\n", limits[i],
+				(double)table -> retire_ns / ((double)writers * updates_per_writer), table -> reads, table -> corrupt);
+		SDL_Log("Retired %zu, reclaimed %zu, %zu pending, peak %zu bytes on one thread, %zu epoch advances, %zu overruns\n",
+				after.retired - before.retired, after.reclaimed - before.reclaimed, after.pending,
+				after.peak_pending_bytes, after.advances - before.advances, after.overruns - before.overruns);
+	}
+
+	for (int i = 0; i < EPOCH_SLOTS; i++) {
+		SDL_free(table -> slots[i]);
+	}
+
+	int check = sdl_tlsf_check_active_instance();
+	size_t used = instance -> total_used;
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(table);
+
+	SDL_Log("%zu bytes left in use, heap check %s\n", used, check == 0 ? "passed" : "failed");
+}
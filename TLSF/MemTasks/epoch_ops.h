@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_EPOCH_OPS_H
+#define TLSF_EPOCH_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Readers walk a table of nodes without locks while writers swap nodes out and retire the old ones
+// Checks that no reader ever sees a freed node, then times retire and shows the pending bound holding
+void epoch_reclaim_test(int readers, int writers, int updates_per_writer);
+
+#endif //TLSF_EPOCH_OPS_H
@@ -0,0 +1,95 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "growth_ops.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Resident set size from /proc, 0 if it can't be read
+static size_t resident_bytes(void) {
+
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL) {
+		return 0;
+	}
+
+	size_t pages = 0, resident = 0;
+	if (fscanf(statm, "%zu %zu", &pages, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(statm);
+
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void run_ramp(const char *label, tlsf_growth_policy policy, size_t pool_size, size_t max_pool_size, size_t target_bytes) {
+
+	// Worst case every block is the smallest size
+	size_t max_blocks = target_bytes / 1024 + 1;
+	void **blocks = SDL_malloc(sizeof(void *) * max_blocks);
+
+	// Nothing held over from the last run
+	sdl_tlsf_depot_trim(0);
+	size_t rss_before = resident_bytes();
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	// The variant has to address the biggest pool, not just the first
+	tlsf_instance *instance = sdl_tlsf_create_instance_with_variant(pool_size, sdl_tlsf_pick_variant(max_pool_size));
+	sdl_tlsf_set_growth_policy(instance, policy, max_pool_size);
+	sdl_tlsf_set_instance(instance);
+
+	unsigned int seed = 231;
+	size_t live = 0;
+	size_t count = 0;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Level streaming in: allocations of 1 to 64 KB, each touched once like a freshly loaded asset header
+	while (live < target_bytes && count < max_blocks) {
+		seed = seed * 1103515245u + 12345u;
+		size_t size = 1024 + (seed >> 16) % (63 * 1024);
+
+		void *block = SDL_malloc(size);
+		if (block == NULL) {
+			break;
+		}
+		*(char *)block = 1;
+
+		blocks[count++] = block;
+		live += size;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	size_t events = instance -> growth_events;
+	size_t pools = instance -> num_pools;
+	size_t rss = resident_bytes() - rss_before;
+
+	for (size_t i = 0; i < count; i++) {
+		SDL_free(blocks[i]);
+	}
+	size_t pools_after = instance -> num_pools;
+	size_t next_pool = instance -> next_pool_size;
+	int check = sdl_tlsf_check_active_instance();
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(blocks);
+
+	double ms = (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+	SDL_Log("%s: %.1f ms, %zu growth events, %zu pools, %zu KB resident; %zu pools left after freeing, next pool %zu KB, heap check %s\n",
+			label, ms, events, pools, rss / 1024, pools_after, next_pool / 1024, check == 0 ? "passed" : "failed");
+}
+
+void growth_ramp_test(size_t pool_size, size_t max_pool_size, size_t target_bytes) {
+
+	SDL_Log("Pool growth: %zu byte first pool ramping to %zu bytes, pools up to %zu bytes\n", pool_size, target_bytes, max_pool_size);
+
+	run_ramp("Fixed", SDL_TLSF_GROWTH_FIXED, pool_size, max_pool_size, target_bytes);
+	run_ramp("Geometric", SDL_TLSF_GROWTH_GEOMETRIC, pool_size, max_pool_size, target_bytes);
+	run_ramp("Predictive", SDL_TLSF_GROWTH_PREDICTIVE, pool_size, max_pool_size, target_bytes);
+}
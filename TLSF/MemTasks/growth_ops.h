@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_GROWTH_OPS_H
+#define TLSF_GROWTH_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Ramps an instance from pool_size up to target_bytes of live blocks and back down, under each growth policy
+// Reports growth events, pools, resident memory and time
+void growth_ramp_test(size_t pool_size, size_t max_pool_size, size_t target_bytes);
+
+#endif //TLSF_GROWTH_OPS_H
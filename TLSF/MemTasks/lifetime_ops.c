@@ -0,0 +1,141 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "lifetime_ops.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define BUFFERS_PER_REQUEST 8
+#define NORMAL_REQUESTS 4
+#define SPIKE_REQUESTS 64
+#define SPIKE_EVERY 50
+
+// Resident set size from /proc, 0 if it can't be read
+static size_t resident_bytes(void) {
+
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL) {
+		return 0;
+	}
+
+	size_t pages = 0, resident = 0;
+	if (fscanf(statm, "%zu %zu", &pages, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(statm);
+
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static unsigned int next_random(unsigned int *seed) {
+
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 16;
+}
+
+// Bytes the instance and its tag heaps have mapped right now
+static size_t mapped_bytes(tlsf_instance *instance) {
+
+	size_t bytes = instance -> total_size + instance -> huge_bytes;
+	for (tlsf_instance *heap = instance -> tags; heap != NULL; heap = heap -> next_tag) {
+		bytes += heap -> total_size + heap -> huge_bytes;
+	}
+	return bytes;
+}
+
+static void run_server(const char *label, int hinted, int num_ticks, int num_sessions, size_t pool_size) {
+
+	void **sessions = SDL_calloc(num_sessions, sizeof(void *));
+	void **buffers = SDL_malloc(sizeof(void *) * SPIKE_REQUESTS * BUFFERS_PER_REQUEST);
+
+	// Released pools have their pages dropped, so resident memory follows the pools actually held
+	sdl_tlsf_depot_trim(0);
+	sdl_tlsf_depot_configure(SDL_TLSF_DEPOT_DEFAULT_BYTES, SDL_TLSF_DEPOT_DONTNEED);
+	size_t rss_before = resident_bytes();
+	size_t peak_rss = 0;
+	size_t peak_mapped = 0;
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance(pool_size);
+	sdl_tlsf_set_instance(instance);
+
+	tlsf_lifetime transient = hinted ? SDL_TLSF_LIFETIME_TRANSIENT : SDL_TLSF_LIFETIME_DEFAULT;
+	tlsf_lifetime persistent = hinted ? SDL_TLSF_LIFETIME_PERSISTENT : SDL_TLSF_LIFETIME_DEFAULT;
+	unsigned int seed = 231;
+
+	for (int tick = 0; tick < num_ticks; tick++) {
+
+		int requests = tick % SPIKE_EVERY == SPIKE_EVERY - 1 ? SPIKE_REQUESTS : NORMAL_REQUESTS;
+		int count = 0;
+
+		for (int r = 0; r < requests; r++) {
+
+			// Parsing and response buffers
+			for (int b = 0; b < BUFFERS_PER_REQUEST; b++) {
+				size_t size = 1024 + next_random(&seed) % (15 * 1024);
+				buffers[count] = sdl_tlsf_malloc_hint(size, transient);
+				*(char *)buffers[count++] = 1;
+			}
+
+			// Every other request logs a client in, replacing whoever held the slot
+			if (next_random(&seed) % 2 == 0) {
+				int slot = (int)(next_random(&seed) % num_sessions);
+				SDL_free(sessions[slot]);
+				sessions[slot] = sdl_tlsf_malloc_hint(256 + next_random(&seed) % 768, persistent);
+			}
+		}
+
+		size_t rss = resident_bytes() - rss_before;
+		if (rss > peak_rss) {
+			peak_rss = rss;
+		}
+		if (mapped_bytes(instance) > peak_mapped) {
+			peak_mapped = mapped_bytes(instance);
+		}
+
+		for (int i = 0; i < count; i++) {
+			SDL_free(buffers[i]);
+		}
+	}
+
+	// Pools added minus the ones still held is how many were handed back on the way
+	size_t added = instance -> growth_events;
+	size_t held = instance -> num_pools - 1;
+	for (tlsf_instance *heap = instance -> tags; heap != NULL; heap = heap -> next_tag) {
+		added += heap -> growth_events;
+		held += heap -> num_pools - 1;
+	}
+
+	size_t end_mapped = mapped_bytes(instance);
+	size_t pools = instance -> num_pools;
+
+	for (int i = 0; i < num_sessions; i++) {
+		SDL_free(sessions[i]);
+	}
+	int check = sdl_tlsf_check_active_instance();
+	size_t used = instance -> total_used + sdl_tlsf_tag_used(instance, SDL_TLSF_TAG_TRANSIENT);
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(buffers);
+	SDL_free(sessions);
+
+	sdl_tlsf_depot_configure(SDL_TLSF_DEPOT_DEFAULT_BYTES, SDL_TLSF_DEPOT_KEEP);
+	sdl_tlsf_depot_trim(0);
+
+	SDL_Log("%s: %zu pools added, %zu released, peak %zu KB mapped and %zu KB resident, %zu KB mapped after the run "
+			"with %zu pools in the instance, %zu bytes in use at the end, heap check %s\n",
+			label, added, added - held, peak_mapped / 1024, peak_rss / 1024, end_mapped / 1024,
+			pools, used, check == 0 ? "passed" : "failed");
+}
+
+void lifetime_fragmentation_test(int num_ticks, int num_sessions, size_t pool_size) {
+
+	SDL_Log("Lifetime hints: %d ticks, a %d request spike every %d, %d sessions, %zu byte pools\n",
+			num_ticks, SPIKE_REQUESTS, SPIKE_EVERY, num_sessions, pool_size);
+
+	run_server("No hints", 0, num_ticks, num_sessions, pool_size);
+	run_server("Hinted", 1, num_ticks, num_sessions, pool_size);
+}
@@ -0,0 +1,15 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_LIFETIME_OPS_H
+#define TLSF_LIFETIME_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// A server handling num_ticks batches of requests with a load spike every so often. Each request allocates
+// transient buffers and sometimes a session object that stays around. Run with and without lifetime hints,
+// reports pools released, peak pool footprint and peak resident memory
+void lifetime_fragmentation_test(int num_ticks, int num_sessions, size_t pool_size);
+
+#endif //TLSF_LIFETIME_OPS_H
@@ -0,0 +1,149 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "lock_ops.h"
+
+#include <time.h>
+
+#define LOCK_LIVE_BLOCKS 256
+
+typedef struct {
+	int ops;
+	unsigned int seed;
+} lock_worker;
+
+static unsigned int next_random(unsigned int *seed) {
+
+	*seed = *seed * 1103515245u + 12345u;
+	return *seed >> 16;
+}
+
+// Replaces a random block of the window every op, mostly small with the odd few KB
+static int churn_thread(void *data) {
+
+	void *blocks[LOCK_LIVE_BLOCKS] = {0};
+	lock_worker *worker = data;
+
+	for (int i = 0; i < worker -> ops; i++) {
+		int slot = next_random(&worker -> seed) % LOCK_LIVE_BLOCKS;
+		size_t bytes = 16 + (next_random(&worker -> seed) % 240);
+
+		if (next_random(&worker -> seed) % 16 == 0) {
+			bytes = 1024 + (next_random(&worker -> seed) % 7168);
+		}
+
+		SDL_free(blocks[slot]);
+		blocks[slot] = SDL_malloc(bytes);
+		*(char *)blocks[slot] = (char)i;
+	}
+
+	for (int i = 0; i < LOCK_LIVE_BLOCKS; i++) {
+		SDL_free(blocks[i]);
+	}
+
+	return 0;
+}
+
+static double run_threads(int count, int ops) {
+
+	SDL_Thread *threads[64];
+	lock_worker workers[64];
+
+	if (count > 64) {
+		count = 64;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < count; i++) {
+		workers[i].ops = ops;
+		workers[i].seed = 977 + i;
+		threads[i] = SDL_CreateThread(churn_thread, "Churn", &workers[i]);
+	}
+	for (int i = 0; i < count; i++) {
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+	return ns / ((double)count * ops * 2);
+}
+
+static void report(const char *label, int threads, double ns) {
+
+	tlsf_lock_stats stats;
+	sdl_tlsf_get_lock_stats(&stats);
+
+	if (!stats.enabled) {
+		SDL_Log("%s: %d threads, %.1f ns per op (lock stats compiled out)\n", label, threads, ns);
+		return;
+	}
+
+	Uint64 taken = 0;
+	Uint64 contended = 0;
+	Uint64 waited = 0;
+	Uint64 held = 0;
+
+	for (int i = 0; i < SDL_TLSF_LOCK_SITES; i++) {
+		taken += stats.sites[i].acquisitions;
+		contended += stats.sites[i].contended;
+		waited += stats.sites[i].wait_ns;
+		held += stats.sites[i].hold_ns;
+	}
+
+	// Threads waiting at once overlap, so waited can be more than the wall clock
+	SDL_Log("%s: %d threads, %.1f ns per op, %llu lock acquisitions, %.1f%% contended, %.1f ns waited and %.1f ns held per op\n",
+			label, threads, ns, (unsigned long long)taken, taken ? 100.0 * (double)contended / (double)taken : 0.0,
+			(double)waited / ((double)taken / 2), (double)held / ((double)taken / 2));
+
+	const tlsf_lock_site_stats *malloc_site = &stats.sites[SDL_TLSF_LOCK_MALLOC];
+	const tlsf_lock_site_stats *free_site = &stats.sites[SDL_TLSF_LOCK_FREE];
+
+	SDL_Log("  malloc: %llu contended, wait p50 <%llu p99 <%llu ns, hold p50 <%llu p99 <%llu ns\n",
+			(unsigned long long)malloc_site -> contended,
+			(unsigned long long)sdl_tlsf_lock_percentile(malloc_site -> wait_histogram, 0.50),
+			(unsigned long long)sdl_tlsf_lock_percentile(malloc_site -> wait_histogram, 0.99),
+			(unsigned long long)sdl_tlsf_lock_percentile(malloc_site -> hold_histogram, 0.50),
+			(unsigned long long)sdl_tlsf_lock_percentile(malloc_site -> hold_histogram, 0.99));
+	SDL_Log("  free: %llu contended, wait p50 <%llu p99 <%llu ns, hold p50 <%llu p99 <%llu ns\n",
+			(unsigned long long)free_site -> contended,
+			(unsigned long long)sdl_tlsf_lock_percentile(free_site -> wait_histogram, 0.50),
+			(unsigned long long)sdl_tlsf_lock_percentile(free_site -> wait_histogram, 0.99),
+			(unsigned long long)sdl_tlsf_lock_percentile(free_site -> hold_histogram, 0.50),
+			(unsigned long long)sdl_tlsf_lock_percentile(free_site -> hold_histogram, 0.99));
+}
+
+void lock_contention_test(int max_threads, int ops_per_thread) {
+
+	SDL_Log("Lock contention: 1 and %d threads, %d ops each\n", max_threads, ops_per_thread);
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 16);
+	if (instance == NULL) {
+		return;
+	}
+
+	sdl_tlsf_set_instance(instance);
+
+	// Stats are process wide, the runs before this one would show up in the first report
+	sdl_tlsf_reset_lock_stats();
+	double alone = run_threads(1, ops_per_thread);
+	report("Alone", 1, alone);
+
+	sdl_tlsf_reset_lock_stats();
+	double shared = run_threads(max_threads, ops_per_thread);
+	report("Shared", max_threads, shared);
+
+	int check = sdl_tlsf_check_active_instance();
+	if (check != 0) {
+		SDL_Log("Heap check failed after the lock contention run\n");
+	}
+
+	SDL_Log("%zu bytes in use after freeing\n", instance -> total_used);
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+}
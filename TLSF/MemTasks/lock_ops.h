@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_LOCK_OPS_H
+#define TLSF_LOCK_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Threads churning a window of blocks on one instance, first alone and then all at once
+// Shows the time per op and, when built with SDL_TLSF_LOCK_STATS, how much of it went to waiting on tlsf_lock
+void lock_contention_test(int max_threads, int ops_per_thread);
+
+#endif //TLSF_LOCK_OPS_H
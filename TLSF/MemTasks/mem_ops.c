@@ -328,4 +328,102 @@ void tlsf_best_case_test(int seed) {
     // Clean up arrays
     SDL_free(pointers);
     SDL_free(sizes);
-}
\ No newline at end of file
+}
+void mem_perf_test(const char *workload, MemoryTestConfig config, int seed, const mem_perf_backend *backend,
+		mem_perf_report *report) {
+
+	srand(seed);
+
+	// The harness arrays and the sizes stay out of the backend and out of the measured loops
+	void **memory_blocks = calloc(config.num_operations, sizeof(void *));
+	size_t *sizes = malloc(config.num_operations * sizeof(size_t) * 2);
+	if (!memory_blocks || !sizes) {
+		SDL_Log("Failed to allocate memory for the perf test arrays.");
+		free(memory_blocks);
+		free(sizes);
+		return;
+	}
+
+	size_t span = config.max_alloc_size - config.initial_alloc_size + 1;
+	for (int i = 0; i < config.num_operations * 2; i++) {
+		sizes[i] = config.initial_alloc_size + (rand() % span);
+	}
+
+	mem_perf_counters counters;
+	mem_perf_open(&counters);
+
+	// Blocks get one byte written so they're touched, filling them would measure memset instead of the allocator
+	mem_perf_begin(&counters);
+	for (int i = 0; i < config.num_operations; i++) {
+		memory_blocks[i] = backend -> alloc(sizes[i]);
+		if (memory_blocks[i]) {
+			*(char *)memory_blocks[i] = (char)i;
+		}
+	}
+	mem_perf_end(&counters, report, backend -> name, workload, "allocation", config.num_operations);
+
+	if (config.test_reallocation) {
+		mem_perf_begin(&counters);
+		for (int i = 0; i < config.num_operations; i++) {
+			if (memory_blocks[i]) {
+				void *new_block = backend -> resize(memory_blocks[i], sizes[config.num_operations + i]);
+				if (new_block) {
+					memory_blocks[i] = new_block;
+					*(char *)new_block = (char)i;
+				}
+			}
+		}
+		mem_perf_end(&counters, report, backend -> name, workload, "reallocation", config.num_operations);
+	}
+
+	// Always freed, the flag only decides whether the free phase is measured
+	if (config.test_deallocation) {
+		mem_perf_begin(&counters);
+	}
+	for (int i = 0; i < config.num_operations; i++) {
+		backend -> release(memory_blocks[i]);
+	}
+	if (config.test_deallocation) {
+		mem_perf_end(&counters, report, backend -> name, workload, "free", config.num_operations);
+	}
+
+	mem_perf_close(&counters);
+	free(memory_blocks);
+	free(sizes);
+}
+
+void mem_perf_compare(const mem_perf_backend *backends, int count, const char *csv_path, const char *json_path) {
+
+	static mem_perf_report report;
+	report.count = 0;
+
+	MemoryTestConfig small;
+	small.initial_alloc_size = 16;
+	small.max_alloc_size = 256;
+	small.num_operations = 200000;
+	small.test_reallocation = 1;
+	small.test_deallocation = 1;
+
+	MemoryTestConfig mixed;
+	mixed.initial_alloc_size = 1024;
+	mixed.max_alloc_size = 64 * 1024;
+	mixed.num_operations = 20000;
+	mixed.test_reallocation = 1;
+	mixed.test_deallocation = 1;
+
+	SDL_Log("Performance counters: %d backends, small and mixed workloads\n", count);
+
+	for (int i = 0; i < count; i++) {
+		mem_perf_test("small", small, 231, &backends[i], &report);
+		mem_perf_test("mixed", mixed, 231, &backends[i], &report);
+	}
+
+	mem_perf_print(&report);
+
+	if (csv_path) {
+		mem_perf_write_csv(&report, csv_path);
+	}
+	if (json_path) {
+		mem_perf_write_json(&report, json_path);
+	}
+}
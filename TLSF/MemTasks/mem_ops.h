@@ -11,6 +11,8 @@
 #include <unistd.h>
 #include <time.h>
 
+#include "perf_counters.h"
+
 // Structure to configure the memory test
 typedef struct {
     size_t initial_alloc_size;  // Initial size of allocations
@@ -26,4 +28,11 @@ void mem_thread_test(int seed);
 void window_test(const char *title);
 void tlsf_best_case_test(int seed);
 
+// mem_speed_test's allocation, reallocation and free phases on one backend, each phase measured with perf_counters
+void mem_perf_test(const char *workload, MemoryTestConfig config, int seed, const mem_perf_backend *backend,
+		mem_perf_report *report);
+
+// Runs the mem_perf_test workloads on every backend, logs them per op and writes csv_path and json_path
+void mem_perf_compare(const mem_perf_backend *backends, int count, const char *csv_path, const char *json_path);
+
 #endif //TLSF_MEM_OPS_H
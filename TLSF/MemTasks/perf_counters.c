@@ -0,0 +1,313 @@
+//
+// Created by bee on 10/19/26.
+//
+
+// syscall is a GNU extension
+#define _GNU_SOURCE
+
+#include "perf_counters.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+static const char *const perf_event_names[MEM_PERF_EVENTS] = {
+	"cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses", "page_faults"
+};
+
+// The missing counters don't change between runs, they're only worth saying once
+static int perf_missing_reported = 0;
+
+#ifdef __linux__
+
+static int mem_perf_open_event(uint32_t type, uint64_t config, int exclude_kernel) {
+
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = exclude_kernel;
+	attr.exclude_hv = 1;
+
+	// Counters get multiplexed when there are more of them than the PMU has, these let us scale them back up
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static uint64_t mem_perf_cache_event(uint64_t cache, uint64_t result) {
+
+	return cache | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+#endif
+
+int mem_perf_open(mem_perf_counters *counters) {
+
+	int opened = 0;
+
+	memset(counters, 0, sizeof(*counters));
+
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		counters -> fds[i] = -1;
+	}
+
+#ifdef __linux__
+	counters -> fds[MEM_PERF_CYCLES] = mem_perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1);
+	counters -> fds[MEM_PERF_INSTRUCTIONS] = mem_perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1);
+	counters -> fds[MEM_PERF_L1D_MISSES] = mem_perf_open_event(PERF_TYPE_HW_CACHE,
+			mem_perf_cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS), 1);
+	counters -> fds[MEM_PERF_LLC_MISSES] = mem_perf_open_event(PERF_TYPE_HW_CACHE,
+			mem_perf_cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS), 1);
+	counters -> fds[MEM_PERF_DTLB_MISSES] = mem_perf_open_event(PERF_TYPE_HW_CACHE,
+			mem_perf_cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS), 1);
+	counters -> fds[MEM_PERF_BRANCH_MISSES] = mem_perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 1);
+
+	// Some PMUs have no LL cache event, the generic cache miss one is the closest
+	if (counters -> fds[MEM_PERF_LLC_MISSES] < 0) {
+		counters -> fds[MEM_PERF_LLC_MISSES] = mem_perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1);
+	}
+
+	// Faults are taken in the kernel on our behalf, only count user ones if that's all we're allowed
+	counters -> fds[MEM_PERF_PAGE_FAULTS] = mem_perf_open_event(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 0);
+	if (counters -> fds[MEM_PERF_PAGE_FAULTS] < 0) {
+		counters -> fds[MEM_PERF_PAGE_FAULTS] = mem_perf_open_event(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 1);
+	}
+#endif
+
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		if (counters -> fds[i] >= 0) {
+			opened++;
+		}
+	}
+
+	if (opened < MEM_PERF_EVENTS && !perf_missing_reported) {
+		char missing[128] = "";
+
+		for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+			if (counters -> fds[i] < 0) {
+				strncat(missing, " ", sizeof(missing) - strlen(missing) - 1);
+				strncat(missing, perf_event_names[i], sizeof(missing) - strlen(missing) - 1);
+			}
+		}
+
+		printf("Performance counters: %d of %d available, missing:%s\n", opened, MEM_PERF_EVENTS, missing);
+		perf_missing_reported = 1;
+	}
+
+	return opened;
+}
+
+void mem_perf_close(mem_perf_counters *counters) {
+
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		if (counters -> fds[i] >= 0) {
+			close(counters -> fds[i]);
+			counters -> fds[i] = -1;
+		}
+	}
+}
+
+// Value, time enabled and time running, 0 if the read fails
+static int mem_perf_read(int fd, uint64_t *values) {
+
+	if (fd < 0 || read(fd, values, sizeof(uint64_t) * 3) != (ssize_t)(sizeof(uint64_t) * 3)) {
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint64_t mem_perf_now_ns(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void mem_perf_begin(mem_perf_counters *counters) {
+
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		if (!mem_perf_read(counters -> fds[i], counters -> start[i])) {
+			memset(counters -> start[i], 0, sizeof(counters -> start[i]));
+		}
+	}
+
+#ifdef __linux__
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		if (counters -> fds[i] >= 0) {
+			ioctl(counters -> fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+
+	counters -> start_ns = mem_perf_now_ns();
+}
+
+void mem_perf_end(mem_perf_counters *counters, mem_perf_report *report, const char *backend, const char *workload,
+		const char *phase, uint64_t ops) {
+
+	uint64_t end_ns = mem_perf_now_ns();
+
+#ifdef __linux__
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		if (counters -> fds[i] >= 0) {
+			ioctl(counters -> fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+#endif
+
+	if (report -> count == MEM_PERF_MAX_SAMPLES) {
+		return;
+	}
+
+	mem_perf_sample *sample = &report -> samples[report -> count++];
+	memset(sample, 0, sizeof(*sample));
+
+	sample -> backend = backend;
+	sample -> workload = workload;
+	sample -> phase = phase;
+	sample -> ops = ops;
+	sample -> ns = end_ns - counters -> start_ns;
+
+	for (int i = 0; i < MEM_PERF_EVENTS; i++) {
+		uint64_t now[3];
+
+		if (!mem_perf_read(counters -> fds[i], now)) {
+			continue;
+		}
+
+		uint64_t value = now[0] - counters -> start[i][0];
+		uint64_t enabled = now[1] - counters -> start[i][1];
+		uint64_t running = now[2] - counters -> start[i][2];
+
+		// Never on the PMU during the phase, there's nothing to scale
+		if (running == 0) {
+			continue;
+		}
+
+		sample -> values[i] = running < enabled ? (uint64_t)((double)value * (double)enabled / (double)running) : value;
+		sample -> valid[i] = 1;
+	}
+}
+
+const char *mem_perf_event_name(mem_perf_event event) {
+
+	return event < MEM_PERF_EVENTS ? perf_event_names[event] : "unknown";
+}
+
+static double mem_perf_per_op(const mem_perf_sample *sample, uint64_t value) {
+
+	return sample -> ops ? (double)value / (double)sample -> ops : 0.0;
+}
+
+void mem_perf_print(const mem_perf_report *report) {
+
+	for (int i = 0; i < report -> count; i++) {
+
+		const mem_perf_sample *sample = &report -> samples[i];
+		char line[512];
+		size_t length = 0;
+
+		length += snprintf(line + length, sizeof(line) - length, "%s %s %s: %.1f ns", sample -> backend,
+				sample -> workload, sample -> phase, mem_perf_per_op(sample, sample -> ns));
+
+		for (int event = 0; event < MEM_PERF_EVENTS && length < sizeof(line); event++) {
+			if (sample -> valid[event]) {
+				length += snprintf(line + length, sizeof(line) - length, ", %.2f %s",
+						mem_perf_per_op(sample, sample -> values[event]), perf_event_names[event]);
+			} else {
+				length += snprintf(line + length, sizeof(line) - length, ", n/a %s", perf_event_names[event]);
+			}
+		}
+
+		if (sample -> valid[MEM_PERF_CYCLES] && sample -> valid[MEM_PERF_INSTRUCTIONS] && sample -> values[MEM_PERF_CYCLES]
+				&& length < sizeof(line)) {
+			snprintf(line + length, sizeof(line) - length, ", %.2f IPC",
+					(double)sample -> values[MEM_PERF_INSTRUCTIONS] / (double)sample -> values[MEM_PERF_CYCLES]);
+		}
+
+		printf("%s per op (%llu ops)\n", line, (unsigned long long)sample -> ops);
+	}
+}
+
+int mem_perf_write_csv(const mem_perf_report *report, const char *path) {
+
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Failed to open %s\n", path);
+		return -1;
+	}
+
+	fprintf(file, "backend,workload,phase,ops,ns_per_op");
+	for (int event = 0; event < MEM_PERF_EVENTS; event++) {
+		fprintf(file, ",%s_per_op", perf_event_names[event]);
+	}
+	fprintf(file, "\n");
+
+	for (int i = 0; i < report -> count; i++) {
+
+		const mem_perf_sample *sample = &report -> samples[i];
+
+		fprintf(file, "%s,%s,%s,%llu,%.3f", sample -> backend, sample -> workload, sample -> phase,
+				(unsigned long long)sample -> ops, mem_perf_per_op(sample, sample -> ns));
+
+		// Left empty rather than 0 so a missing counter doesn't read as a perfect score
+		for (int event = 0; event < MEM_PERF_EVENTS; event++) {
+			if (sample -> valid[event]) {
+				fprintf(file, ",%.4f", mem_perf_per_op(sample, sample -> values[event]));
+			} else {
+				fprintf(file, ",");
+			}
+		}
+		fprintf(file, "\n");
+	}
+
+	return fclose(file) == 0 ? 0 : -1;
+}
+
+int mem_perf_write_json(const mem_perf_report *report, const char *path) {
+
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Failed to open %s\n", path);
+		return -1;
+	}
+
+	fprintf(file, "[\n");
+
+	for (int i = 0; i < report -> count; i++) {
+
+		const mem_perf_sample *sample = &report -> samples[i];
+
+		fprintf(file, "  {\"backend\": \"%s\", \"workload\": \"%s\", \"phase\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.3f",
+				sample -> backend, sample -> workload, sample -> phase, (unsigned long long)sample -> ops,
+				mem_perf_per_op(sample, sample -> ns));
+
+		for (int event = 0; event < MEM_PERF_EVENTS; event++) {
+			if (sample -> valid[event]) {
+				fprintf(file, ", \"%s_per_op\": %.4f", perf_event_names[event],
+						mem_perf_per_op(sample, sample -> values[event]));
+			} else {
+				fprintf(file, ", \"%s_per_op\": null", perf_event_names[event]);
+			}
+		}
+
+		fprintf(file, "}%s\n", i + 1 < report -> count ? "," : "");
+	}
+
+	fprintf(file, "]\n");
+
+	return fclose(file) == 0 ? 0 : -1;
+}
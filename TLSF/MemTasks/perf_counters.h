@@ -0,0 +1,79 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_PERF_COUNTERS_H
+#define TLSF_PERF_COUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware counters around benchmark phases through perf_event_open, so a run says why it was faster and not only
+// that it was. Counters the kernel or the machine won't give us (no PMU in a VM, perf_event_paranoid, not Linux)
+// are left out and reported as n/a, the wall clock is always there
+// Only the calling thread is counted, user space only for the hardware events
+// Plain C and POSIX only, the core allocator test measures with it and doesn't link SDL
+
+typedef enum {
+	MEM_PERF_CYCLES,
+	MEM_PERF_INSTRUCTIONS,
+	MEM_PERF_L1D_MISSES,
+	MEM_PERF_LLC_MISSES,
+	MEM_PERF_DTLB_MISSES,
+	MEM_PERF_BRANCH_MISSES,
+	MEM_PERF_PAGE_FAULTS,
+	MEM_PERF_EVENTS
+} mem_perf_event;
+
+// The allocator a workload runs on, so the same phases can be measured on several in one process
+typedef struct {
+	const char *name;
+	void *(*alloc)(size_t bytes);
+	void *(*resize)(void *ptr, size_t bytes);
+	void (*release)(void *ptr);
+} mem_perf_backend;
+
+typedef struct {
+	int fds[MEM_PERF_EVENTS]; // -1 for a counter we couldn't open
+	uint64_t start[MEM_PERF_EVENTS][3]; // Value, time enabled and time running when the phase began
+	uint64_t start_ns;
+} mem_perf_counters;
+
+// One measured phase, values are totals scaled up for the time a counter was multiplexed out
+typedef struct {
+	const char *backend;
+	const char *workload;
+	const char *phase;
+	uint64_t ops;
+	uint64_t ns;
+	uint64_t values[MEM_PERF_EVENTS];
+	int valid[MEM_PERF_EVENTS]; // 0 when the counter wasn't available or never got scheduled
+} mem_perf_sample;
+
+#define MEM_PERF_MAX_SAMPLES 64
+
+typedef struct {
+	int count;
+	mem_perf_sample samples[MEM_PERF_MAX_SAMPLES];
+} mem_perf_report;
+
+// Opens every counter it can, returns how many. 0 still measures the wall clock
+int mem_perf_open(mem_perf_counters *counters);
+void mem_perf_close(mem_perf_counters *counters);
+
+void mem_perf_begin(mem_perf_counters *counters);
+
+// Stops the counters and adds the phase to report, dropped once report is full
+void mem_perf_end(mem_perf_counters *counters, mem_perf_report *report, const char *backend, const char *workload,
+		const char *phase, uint64_t ops);
+
+const char *mem_perf_event_name(mem_perf_event event);
+
+// Logs every phase normalized per op
+void mem_perf_print(const mem_perf_report *report);
+
+// Per op numbers too, unavailable counters are empty CSV fields and JSON nulls. Return -1 if path can't be written
+int mem_perf_write_csv(const mem_perf_report *report, const char *path);
+int mem_perf_write_json(const mem_perf_report *report, const char *path);
+
+#endif //TLSF_PERF_COUNTERS_H
@@ -0,0 +1,225 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "persist_ops.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Stand-in for an asset index, every entry and name is its own allocation
+typedef struct persist_entry {
+	struct persist_entry *next;
+	size_t id;
+	char *name;
+} persist_entry;
+
+typedef struct {
+	persist_entry **buckets;
+	size_t num_buckets;
+	size_t num_entries;
+} persist_index;
+
+static double elapsed_ms(struct timespec start, struct timespec end) {
+
+	return (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static persist_index *build_index(int num_entries) {
+
+	persist_index *index = SDL_malloc(sizeof(persist_index));
+	index -> num_buckets = num_entries / 4 + 1;
+	index -> num_entries = num_entries;
+	index -> buckets = SDL_calloc(index -> num_buckets, sizeof(persist_entry *));
+
+	for (int i = 0; i < num_entries; i++) {
+		persist_entry *entry = SDL_malloc(sizeof(persist_entry));
+		entry -> id = i;
+		entry -> name = SDL_malloc(24 + i % 40);
+		SDL_snprintf(entry -> name, 24, "asset_%d", i);
+
+		size_t bucket = (size_t)i * 2654435761u % index -> num_buckets;
+		entry -> next = index -> buckets[bucket];
+		index -> buckets[bucket] = entry;
+	}
+	return index;
+}
+
+// Touches every entry, returns how many look right
+static size_t walk_index(persist_index *index) {
+
+	size_t valid = 0;
+	char expected[24];
+
+	for (size_t b = 0; b < index -> num_buckets; b++) {
+		for (persist_entry *entry = index -> buckets[b]; entry != NULL; entry = entry -> next) {
+			SDL_snprintf(expected, sizeof(expected), "asset_%zu", entry -> id);
+			valid += strcmp(expected, entry -> name) == 0;
+		}
+	}
+	return valid;
+}
+
+void persist_startup_test(const char *path, int num_entries) {
+
+	struct timespec t0, t1, t2, t3, t4;
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+
+	tlsf_instance *instance = sdl_tlsf_create_persistent_instance((1 << 20) * 16, (size_t)(1 << 20) * 1024, NULL, NULL);
+	if (instance == NULL) {
+		return;
+	}
+	sdl_tlsf_set_instance(instance);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	persist_index *index = build_index(num_entries);
+	sdl_tlsf_persist_set_root(instance, index);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	int saved = sdl_tlsf_checkpoint_instance(instance, path);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	size_t pools = instance -> num_pools;
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+
+	if (saved != 0) {
+		return;
+	}
+
+	// What the next run of the tool would do
+	instance = sdl_tlsf_restore_instance(path);
+	clock_gettime(CLOCK_MONOTONIC, &t3);
+	if (instance == NULL) {
+		unlink(path);
+		return;
+	}
+
+	sdl_tlsf_set_instance(instance);
+	index = sdl_tlsf_persist_get_root(instance);
+	size_t valid = walk_index(index);
+	clock_gettime(CLOCK_MONOTONIC, &t4);
+
+	// The restored heap keeps working
+	SDL_free(SDL_malloc(64));
+	int check = sdl_tlsf_check_active_instance();
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	unlink(path);
+
+	SDL_Log("Persistent index: %d entries in %zu pools\n", num_entries, pools);
+	SDL_Log("Build %.1f ms, checkpoint %.1f ms, restore %.3f ms, first walk %.1f ms\n",
+			elapsed_ms(t0, t1), elapsed_ms(t1, t2), elapsed_ms(t2, t3), elapsed_ms(t3, t4));
+	SDL_Log("Restored entries valid: %zu/%d, heap check %s\n", valid, num_entries, check == 0 ? "passed" : "failed");
+}
+
+// One frame of edits, half of them write into live objects and half replace an object
+static void mutate_objects(void **objects, int num_objects, int writes, unsigned int *seed) {
+
+	for (int i = 0; i < writes; i++) {
+		*seed = *seed * 1103515245 + 12345;
+		int slot = (*seed >> 8) % num_objects;
+
+		if (i & 1) {
+			SDL_free(objects[slot]);
+			objects[slot] = SDL_malloc(64 + (*seed >> 4) % 512);
+		}
+		memset(objects[slot], i, 64);
+	}
+}
+
+void snapshot_rollback_test(int num_objects, int frames, int writes_per_frame) {
+
+	struct timespec t0, t1;
+	double cow_snapshot_ms = 0, cow_restore_ms = 0, copy_snapshot_ms = 0, copy_restore_ms = 0;
+	size_t dirty_pages = 0;
+	unsigned int seed = 77;
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+
+	tlsf_instance *instance = sdl_tlsf_create_snapshot_instance((1 << 20) * 64, (size_t)(1 << 20) * 1024, NULL);
+	if (instance == NULL) {
+		return;
+	}
+	sdl_tlsf_set_instance(instance);
+
+	// The object table lives in the heap too, so it rolls back with the objects
+	void **objects = SDL_malloc(num_objects * sizeof(void *));
+	for (int i = 0; i < num_objects; i++) {
+		objects[i] = SDL_malloc(64 + i % 512);
+		memset(objects[i], 0, 64);
+	}
+
+	// Without the page table there's nothing to measure
+	if (sdl_tlsf_clone_instance(instance) == SDL_TLSF_SNAPSHOT_FAILED) {
+		SDL_Log("Snapshot rollback: can't clone, skipped\n");
+		sdl_tlsf_set_instance(previous);
+		sdl_tlsf_destroy_instance(instance);
+		return;
+	}
+	size_t region = instance -> persist -> used;
+
+	for (int frame = 0; frame < frames; frame++) {
+
+		mutate_objects(objects, num_objects, writes_per_frame, &seed);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		size_t dirty = sdl_tlsf_restore_clone(instance);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		cow_restore_ms += elapsed_ms(t0, t1);
+
+		if (dirty != SDL_TLSF_SNAPSHOT_FAILED) {
+			dirty_pages += dirty;
+		}
+
+		// Every other frame is kept, the next rollback goes back to it
+		if (frame & 1) {
+			mutate_objects(objects, num_objects, writes_per_frame, &seed);
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			sdl_tlsf_clone_instance(instance);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			cow_snapshot_ms += elapsed_ms(t0, t1);
+		}
+	}
+
+	int check = sdl_tlsf_check_active_instance();
+
+	// Same frames with a full copy of the region as the snapshot
+	void *backup = malloc(region);
+	if (backup != NULL) {
+		memcpy(backup, instance -> persist, region);
+
+		for (int frame = 0; frame < frames; frame++) {
+
+			mutate_objects(objects, num_objects, writes_per_frame, &seed);
+
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			memcpy(instance -> persist, backup, region);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			copy_restore_ms += elapsed_ms(t0, t1);
+
+			if (frame & 1) {
+				mutate_objects(objects, num_objects, writes_per_frame, &seed);
+				clock_gettime(CLOCK_MONOTONIC, &t0);
+				memcpy(backup, instance -> persist, region);
+				clock_gettime(CLOCK_MONOTONIC, &t1);
+				copy_snapshot_ms += elapsed_ms(t0, t1);
+			}
+		}
+		free(backup);
+	}
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+
+	int snapshots = frames / 2 > 0 ? frames / 2 : 1;
+	SDL_Log("Snapshot rollback: %d objects, %zu KB region, %d writes per frame, %zu dirty pages per frame\n",
+			num_objects, region / 1024, writes_per_frame, dirty_pages / frames);
+	SDL_Log("Copy-on-write: snapshot %.3f ms, restore %.3f ms\n", cow_snapshot_ms / snapshots, cow_restore_ms / frames);
+	SDL_Log("memcpy:        snapshot %.3f ms, restore %.3f ms\n", copy_snapshot_ms / snapshots, copy_restore_ms / frames);
+	SDL_Log("Heap check after rollbacks %s\n", check == 0 ? "passed" : "failed");
+}
@@ -0,0 +1,18 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_PERSIST_OPS_H
+#define TLSF_PERSIST_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Builds an allocation heavy index in a persistent instance, snapshots it to path and restores it,
+// comparing the restore against rebuilding from scratch
+void persist_startup_test(const char *path, int num_entries);
+
+// Rolls a populated snapshot instance back after every frame of small edits, comparing the copy-on-write
+// snapshot and restore against memcpy'ing the whole region
+void snapshot_rollback_test(int num_objects, int frames, int writes_per_frame);
+
+#endif //TLSF_PERSIST_OPS_H
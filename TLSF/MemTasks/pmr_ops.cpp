@@ -0,0 +1,114 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "pmr_ops.h"
+#include "../SDL_TLSF/sdl_tlsf_pmr.hpp"
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static double elapsed_ms(clock_type::time_point start) {
+
+	return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// Grows short lived vectors from empty, so every size class the growth passes through gets hit
+template <typename Alloc>
+static double vector_churn(const Alloc &alloc, int rounds) {
+
+	auto start = clock_type::now();
+	for (int r = 0; r < rounds; r++) {
+		for (int v = 0; v < 64; v++) {
+			std::vector<int, Alloc> values(alloc);
+			for (int i = 0; i < 1000 + v * 16; i++) {
+				values.push_back(i);
+			}
+		}
+	}
+	return elapsed_ms(start);
+}
+
+// Node per insert, with half the keys erased and reinserted to mix frees into the allocations
+template <typename Alloc>
+static double map_churn(const Alloc &alloc, int rounds) {
+
+	using pair_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<const int, int>>;
+
+	auto start = clock_type::now();
+	unsigned int seed = 231;
+	for (int r = 0; r < rounds; r++) {
+		std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, pair_alloc> map(16, std::hash<int>(), std::equal_to<int>(), pair_alloc(alloc));
+		for (int i = 0; i < 20000; i++) {
+			seed = seed * 1103515245 + 12345;
+			map[(int)(seed >> 8) % 40000] = i;
+			if (i & 1) {
+				map.erase((int)(seed >> 12) % 40000);
+			}
+		}
+	}
+	return elapsed_ms(start);
+}
+
+// A queue built from list nodes, pushing at the back and popping from the front
+template <typename Alloc>
+static double list_churn(const Alloc &alloc, int rounds) {
+
+	auto start = clock_type::now();
+	for (int r = 0; r < rounds; r++) {
+		std::list<int, Alloc> queue(alloc);
+		for (int i = 0; i < 40000; i++) {
+			queue.push_back(i);
+			if (i % 3 == 2) {
+				queue.pop_front();
+				queue.pop_front();
+			}
+		}
+	}
+	return elapsed_ms(start);
+}
+
+template <typename Alloc>
+static void run_containers(const char *label, const Alloc &alloc, int rounds) {
+
+	double vector_ms = vector_churn(alloc, rounds);
+	double map_ms = map_churn(alloc, rounds);
+	double list_ms = list_churn(alloc, rounds);
+
+	SDL_Log("%-34s %10.1f %10.1f %10.1f\n", label, vector_ms, map_ms, list_ms);
+}
+
+void pmr_container_test(int rounds) {
+
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 16);
+	if (instance == nullptr) {
+		return;
+	}
+
+	sdl_tlsf::instance_resource instance_memory(instance);
+
+	SDL_Log("Container churn, %d rounds (ms)\n", rounds);
+	SDL_Log("%-34s %10s %10s %10s\n", "allocator", "vector", "map", "list");
+
+	run_containers("std::allocator", std::allocator<int>(), rounds);
+	run_containers("pmr instance_resource", std::pmr::polymorphic_allocator<int>(&instance_memory), rounds);
+	run_containers("sdl_tlsf::allocator<instance>", sdl_tlsf::allocator<int>(&instance_memory), rounds);
+
+	{
+		sdl_tlsf::unsynchronized_resource local_memory((1 << 20) * 4, &instance_memory);
+		run_containers("pmr unsynchronized_resource", std::pmr::polymorphic_allocator<int>(&local_memory), rounds);
+		run_containers("sdl_tlsf::allocator<unsynchronized>",
+					   sdl_tlsf::allocator<int, sdl_tlsf::unsynchronized_resource>(&local_memory), rounds);
+	}
+
+	int check = instance -> variant -> check(instance -> instance);
+	SDL_Log("Instance heap check %s, %zu bytes still in use\n", check == 0 ? "passed" : "failed", instance -> total_used);
+
+	sdl_tlsf_destroy_instance(instance);
+}
@@ -0,0 +1,22 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_PMR_OPS_H
+#define TLSF_PMR_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// std::vector, std::unordered_map and std::list churn on the default allocator against
+// the TLSF memory resources and allocator of sdl_tlsf_pmr.hpp
+void pmr_container_test(int rounds);
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif //TLSF_PMR_OPS_H
@@ -0,0 +1,153 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "profile_ops.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_TEXTURES 256
+#define TEXTURE_SIZE (64 * 1024)
+#define NUM_ENTITIES 40000
+#define ENTITY_SIZE 256
+#define NUM_STRINGS 100000
+#define STRING_SIZE 32
+
+static double elapsed_ns(struct timespec *start, struct timespec *end) {
+
+	return (double)(end -> tv_sec - start -> tv_sec) * 1e9 + (double)(end -> tv_nsec - start -> tv_nsec);
+}
+
+// Kept out of line, an inlined call site would show up as the test itself
+// Blocks are written once so none of them is left untouched
+__attribute__((noinline)) void profile_load_textures(void **blocks, int count, size_t size) {
+
+	for (int i = 0; i < count; i++) {
+		blocks[i] = SDL_malloc(size);
+		memset(blocks[i], 0, 64);
+	}
+}
+
+__attribute__((noinline)) void profile_spawn_entities(void **blocks, int count, size_t size) {
+
+	for (int i = 0; i < count; i++) {
+		blocks[i] = SDL_calloc(1, size);
+	}
+}
+
+__attribute__((noinline)) void profile_intern_strings(void **blocks, int count, size_t size) {
+
+	for (int i = 0; i < count; i++) {
+		blocks[i] = SDL_malloc(size);
+		SDL_snprintf(blocks[i], size, "string %d", i);
+	}
+}
+
+static double time_pairs(int num_ops) {
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < num_ops; i++) {
+		void *ptr = SDL_malloc(64 + (i & 63));
+		*(volatile char *)ptr = 1;
+		SDL_free(ptr);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return elapsed_ns(&start, &end) / num_ops;
+}
+
+// Estimated bytes on the collapsed lines that pass through the given function
+static double collapsed_bytes(const char *path, const char *function) {
+
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		return 0;
+	}
+
+	double bytes = 0;
+	char line[8192];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *count = strrchr(line, ' ');
+		if (count != NULL && strstr(line, function) != NULL) {
+			bytes += SDL_atof(count + 1);
+		}
+	}
+
+	fclose(file);
+	return bytes;
+}
+
+void profile_sampling_test(int num_ops, size_t sample_bytes, const char *path) {
+
+	void **textures = SDL_malloc(sizeof(void *) * NUM_TEXTURES);
+	void **entities = SDL_malloc(sizeof(void *) * NUM_ENTITIES);
+	void **strings = SDL_malloc(sizeof(void *) * NUM_STRINGS);
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 64);
+	if (instance == NULL) {
+		SDL_free(strings);
+		SDL_free(entities);
+		SDL_free(textures);
+		return;
+	}
+	sdl_tlsf_set_instance(instance);
+
+	double off_ns = time_pairs(num_ops);
+	sdl_tlsf_profile_start(sample_bytes);
+	double on_ns = time_pairs(num_ops);
+
+	profile_load_textures(textures, NUM_TEXTURES, TEXTURE_SIZE);
+	profile_spawn_entities(entities, NUM_ENTITIES, ENTITY_SIZE);
+	profile_intern_strings(strings, NUM_STRINGS, STRING_SIZE);
+
+	tlsf_profile_stats stats;
+	sdl_tlsf_profile_get_stats(&stats);
+
+	char heap_path[256], collapsed_path[256];
+	SDL_snprintf(heap_path, sizeof(heap_path), "%s.heap", path);
+	SDL_snprintf(collapsed_path, sizeof(collapsed_path), "%s.collapsed", path);
+
+	int dumped = sdl_tlsf_profile_dump(heap_path, SDL_TLSF_PROFILE_PPROF, instance) == 0
+			&& sdl_tlsf_profile_dump(collapsed_path, SDL_TLSF_PROFILE_COLLAPSED, instance) == 0;
+
+	double texture_bytes = collapsed_bytes(collapsed_path, "profile_load_textures");
+	double entity_bytes = collapsed_bytes(collapsed_path, "profile_spawn_entities");
+	double string_bytes = collapsed_bytes(collapsed_path, "profile_intern_strings");
+	unlink(heap_path);
+	unlink(collapsed_path);
+
+	for (int i = 0; i < NUM_TEXTURES; i++) SDL_free(textures[i]);
+	for (int i = 0; i < NUM_ENTITIES; i++) SDL_free(entities[i]);
+	for (int i = 0; i < NUM_STRINGS; i++) SDL_free(strings[i]);
+
+	tlsf_profile_stats after;
+	sdl_tlsf_profile_get_stats(&after);
+	sdl_tlsf_profile_stop();
+
+	int check = sdl_tlsf_check_active_instance();
+	size_t used = instance -> total_used;
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(strings);
+	SDL_free(entities);
+	SDL_free(textures);
+
+	size_t actual = (size_t)NUM_TEXTURES * TEXTURE_SIZE + (size_t)NUM_ENTITIES * ENTITY_SIZE + (size_t)NUM_STRINGS * STRING_SIZE;
+
+	SDL_Log("Heap profiler: one sample per %zu bytes\n", sample_bytes);
+	SDL_Log("malloc/free pair: %.1f ns profiler off, %.1f ns on\n", off_ns, on_ns);
+	SDL_Log("%zu samples on %zu stacks, %zu KB live estimated of %zu KB, %zu dropped, dump %s\n",
+			stats.live_samples, stats.live_stacks, stats.live_bytes / 1024, actual / 1024, stats.dropped, dumped ? "written" : "failed");
+	SDL_Log("Textures %.0f KB of %d KB, entities %.0f KB of %d KB, strings %.0f KB of %d KB\n",
+			texture_bytes / 1024, NUM_TEXTURES * TEXTURE_SIZE / 1024, entity_bytes / 1024, NUM_ENTITIES * ENTITY_SIZE / 1024,
+			string_bytes / 1024, NUM_STRINGS * STRING_SIZE / 1024);
+	SDL_Log("%zu samples live after freeing, %zu bytes in use at the end, heap check %s\n",
+			after.live_samples, used, check == 0 ? "passed" : "failed");
+}
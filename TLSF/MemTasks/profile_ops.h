@@ -0,0 +1,20 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_PROFILE_OPS_H
+#define TLSF_PROFILE_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Times malloc/free pairs with the profiler off and on, then loads textures, entities and strings from
+// separate functions and compares what the profile attributes to each with what they really hold
+// Writes path.heap (pprof) and path.collapsed, removed again at the end
+void profile_sampling_test(int num_ops, size_t sample_bytes, const char *path);
+
+// Call sites the profile should tell apart, not static so the collapsed output can name them
+void profile_load_textures(void **blocks, int count, size_t size);
+void profile_spawn_entities(void **blocks, int count, size_t size);
+void profile_intern_strings(void **blocks, int count, size_t size);
+
+#endif //TLSF_PROFILE_OPS_H
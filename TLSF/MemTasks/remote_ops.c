@@ -0,0 +1,145 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "remote_ops.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define REMOTE_RING_SIZE 1024
+#define REMOTE_BATCH 256
+
+// Decode to render handoff, single producer and single consumer
+typedef struct {
+	void *slots[REMOTE_RING_SIZE];
+	_Atomic size_t head;
+	_Atomic size_t tail;
+
+	int num_buffers;
+	size_t buffer_size;
+	tlsf_instance *instance;
+	int owned;
+
+	double free_ns;
+} remote_pipeline;
+
+static int decode_thread(void *data) {
+
+	remote_pipeline *pipeline = data;
+
+	if (pipeline -> owned) {
+		sdl_tlsf_set_owner(pipeline -> instance, SDL_GetCurrentThreadID());
+	}
+
+	for (int i = 0; i < pipeline -> num_buffers; i++) {
+
+		unsigned char *buffer = SDL_malloc(pipeline -> buffer_size);
+		memset(buffer, i, 64);
+
+		size_t head = atomic_load_explicit(&pipeline -> head, memory_order_relaxed);
+		while (head - atomic_load_explicit(&pipeline -> tail, memory_order_acquire) == REMOTE_RING_SIZE) {
+			sched_yield();
+		}
+		pipeline -> slots[head % REMOTE_RING_SIZE] = buffer;
+		atomic_store_explicit(&pipeline -> head, head + 1, memory_order_release);
+	}
+
+	return 0;
+}
+
+static int render_thread(void *data) {
+
+	remote_pipeline *pipeline = data;
+	void *batch[REMOTE_BATCH];
+	int received = 0;
+
+	while (received < pipeline -> num_buffers) {
+
+		size_t tail = atomic_load_explicit(&pipeline -> tail, memory_order_relaxed);
+		size_t head = atomic_load_explicit(&pipeline -> head, memory_order_acquire);
+		if (head == tail) {
+			sched_yield();
+			continue;
+		}
+
+		int count = 0;
+		while (tail != head && count < REMOTE_BATCH) {
+			batch[count++] = pipeline -> slots[tail % REMOTE_RING_SIZE];
+			tail++;
+		}
+		atomic_store_explicit(&pipeline -> tail, tail, memory_order_release);
+
+		// Only the frees are timed, the handoff costs the same either way
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		// The renderer knows whose buffers these are, so an owned instance gets them queued without the lock
+		for (int i = 0; i < count; i++) {
+			if (pipeline -> owned) {
+				sdl_tlsf_remote_free(pipeline -> instance, batch[i]);
+			} else {
+				SDL_free(batch[i]);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		pipeline -> free_ns += (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+		received += count;
+	}
+
+	return 0;
+}
+
+static double run_pipeline(remote_pipeline *pipeline, int owned) {
+
+	atomic_init(&pipeline -> head, 0);
+	atomic_init(&pipeline -> tail, 0);
+	pipeline -> owned = owned;
+	pipeline -> free_ns = 0;
+
+	SDL_Thread *decode = SDL_CreateThread(decode_thread, "Decode", pipeline);
+	SDL_Thread *render = SDL_CreateThread(render_thread, "Render", pipeline);
+	SDL_WaitThread(decode, NULL);
+	SDL_WaitThread(render, NULL);
+
+	return pipeline -> free_ns / pipeline -> num_buffers;
+}
+
+void remote_free_test(int num_buffers, size_t buffer_size) {
+
+	// Allocated before switching, so only the buffers end up in the test instance
+	remote_pipeline *pipeline = SDL_calloc(1, sizeof(remote_pipeline));
+	pipeline -> num_buffers = num_buffers;
+	pipeline -> buffer_size = buffer_size;
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 32);
+	if (instance == NULL) {
+		SDL_free(pipeline);
+		return;
+	}
+	sdl_tlsf_set_instance(instance);
+	pipeline -> instance = instance;
+
+	double locked_ns = run_pipeline(pipeline, 0);
+	double remote_ns = run_pipeline(pipeline, 1);
+
+	size_t drained = instance -> remote_drained;
+	size_t batches = instance -> remote_batches;
+
+	// Hands back whatever the decode thread didn't get to
+	sdl_tlsf_set_owner(instance, 0);
+	size_t leftover = instance -> remote_drained - drained;
+	int check = sdl_tlsf_check_active_instance();
+	size_t used = instance -> total_used;
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(pipeline);
+
+	SDL_Log("Cross-thread free: %d buffers of %zu bytes\n", num_buffers, buffer_size);
+	SDL_Log("Locked free: %.1f ns, remote queue free: %.1f ns\n", locked_ns, remote_ns);
+	SDL_Log("Owner drained %zu blocks in %zu batches, %zu left at the end, %zu bytes in use, heap check %s\n",
+			drained, batches, leftover, used, check == 0 ? "passed" : "failed");
+}
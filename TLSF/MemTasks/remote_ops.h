@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_REMOTE_OPS_H
+#define TLSF_REMOTE_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// A decode thread allocates buffers and a render thread frees them, timing the frees with the
+// render thread taking the lock against queuing them for the decode thread that owns the instance
+void remote_free_test(int num_buffers, size_t buffer_size);
+
+#endif //TLSF_REMOTE_OPS_H
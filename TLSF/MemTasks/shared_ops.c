@@ -0,0 +1,187 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "shared_ops.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHARED_RING_SIZE 1024
+
+// Single producer single consumer ring of message offsets, lives in the shared heap
+typedef struct {
+	_Atomic size_t head;
+	char pad[64 - sizeof(size_t)];
+	_Atomic size_t tail;
+	size_t slots[SHARED_RING_SIZE];
+} shared_ring;
+
+static double elapsed_seconds(struct timespec start, struct timespec end) {
+
+	return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Reads the whole message so the consumer pays for touching the data either way
+static size_t checksum(const unsigned char *data, size_t size) {
+
+	size_t sum = 0;
+	for (size_t i = 0; i < size; i += 64) {
+		sum += data[i];
+	}
+	return sum + data[size - 1];
+}
+
+static void shared_consumer(int fd, size_t num_messages, size_t message_size) {
+
+	// A fresh mapping, almost certainly at another address than the producer's
+	tlsf_shared_instance *shared = sdl_tlsf_shared_open_fd(fd);
+	if (shared == NULL) {
+		_exit(1);
+	}
+
+	shared_ring *ring = sdl_tlsf_shared_get_root(shared);
+	size_t sum = 0;
+
+	for (size_t i = 0; i < num_messages; i++) {
+
+		size_t tail = atomic_load_explicit(&ring -> tail, memory_order_relaxed);
+		while (atomic_load_explicit(&ring -> head, memory_order_acquire) == tail) {
+			// Let the producer run if we share a core
+			sched_yield();
+		}
+
+		unsigned char *message = sdl_tlsf_shared_from_offset(shared, ring -> slots[tail % SHARED_RING_SIZE]);
+		sum += checksum(message, message_size);
+		sdl_tlsf_shared_free(shared, message);
+
+		atomic_store_explicit(&ring -> tail, tail + 1, memory_order_release);
+	}
+
+	sdl_tlsf_shared_close(shared);
+	_exit(sum == 0);
+}
+
+static double shared_run(size_t num_messages, size_t message_size) {
+
+	tlsf_shared_instance *shared = sdl_tlsf_shared_create(NULL, (1 << 20) * 64);
+	if (shared == NULL) {
+		return -1;
+	}
+
+	shared_ring *ring = sdl_tlsf_shared_malloc(shared, sizeof(shared_ring));
+	atomic_init(&ring -> head, 0);
+	atomic_init(&ring -> tail, 0);
+	sdl_tlsf_shared_set_root(shared, ring);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		shared_consumer(shared -> fd, num_messages, message_size);
+	}
+
+	for (size_t i = 0; i < num_messages; i++) {
+
+		size_t head = atomic_load_explicit(&ring -> head, memory_order_relaxed);
+		while (head - atomic_load_explicit(&ring -> tail, memory_order_acquire) == SHARED_RING_SIZE) {
+			// Ring is full, wait for the consumer
+			sched_yield();
+		}
+
+		unsigned char *message;
+		while ((message = sdl_tlsf_shared_malloc(shared, message_size)) == NULL) {
+			// Heap is full of messages the consumer hasn't freed yet
+			sched_yield();
+		}
+		memset(message, (int)(i & 0xff) | 1, message_size);
+
+		ring -> slots[head % SHARED_RING_SIZE] = sdl_tlsf_shared_to_offset(shared, message);
+		atomic_store_explicit(&ring -> head, head + 1, memory_order_release);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	sdl_tlsf_shared_free(shared, ring);
+	sdl_tlsf_shared_close(shared);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		SDL_Log("Shared heap consumer failed\n");
+		return -1;
+	}
+	return elapsed_seconds(start, end);
+}
+
+static double pipe_run(size_t num_messages, size_t message_size) {
+
+	int fds[2];
+	if (pipe(fds) != 0) {
+		return -1;
+	}
+
+	unsigned char *message = SDL_malloc(message_size);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[1]);
+		size_t sum = 0;
+		for (size_t i = 0; i < num_messages; i++) {
+			size_t got = 0;
+			while (got < message_size) {
+				ssize_t n = read(fds[0], message + got, message_size - got);
+				if (n <= 0) _exit(1);
+				got += n;
+			}
+			sum += checksum(message, message_size);
+		}
+		_exit(sum == 0);
+	}
+
+	close(fds[0]);
+	for (size_t i = 0; i < num_messages; i++) {
+		memset(message, (int)(i & 0xff) | 1, message_size);
+		size_t sent = 0;
+		while (sent < message_size) {
+			ssize_t n = write(fds[1], message + sent, message_size - sent);
+			if (n <= 0) break;
+			sent += n;
+		}
+	}
+	close(fds[1]);
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	SDL_free(message);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		SDL_Log("Pipe consumer failed\n");
+		return -1;
+	}
+	return elapsed_seconds(start, end);
+}
+
+void shared_message_test(size_t num_messages, size_t message_size) {
+
+	double shared_time = shared_run(num_messages, message_size);
+	double pipe_time = pipe_run(num_messages, message_size);
+
+	double megabytes = (double)num_messages * message_size / (1 << 20);
+
+	SDL_Log("%zu messages of %zu bytes between two processes\n", num_messages, message_size);
+	if (shared_time > 0) {
+		SDL_Log("Shared tlsf heap: %.0f msgs/s, %.1f MB/s\n", num_messages / shared_time, megabytes / shared_time);
+	}
+	if (pipe_time > 0) {
+		SDL_Log("Pipe copy:        %.0f msgs/s, %.1f MB/s\n", num_messages / pipe_time, megabytes / pipe_time);
+	}
+}
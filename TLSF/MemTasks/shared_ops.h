@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_SHARED_OPS_H
+#define TLSF_SHARED_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Producer and consumer processes passing messages through a shared tlsf heap by offset,
+// compared against copying the same messages through a pipe
+void shared_message_test(size_t num_messages, size_t message_size);
+
+#endif //TLSF_SHARED_OPS_H
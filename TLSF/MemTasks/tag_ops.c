@@ -0,0 +1,111 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "tag_ops.h"
+
+#include <time.h>
+
+#define LEVEL_TAG 1
+
+static double elapsed_ms(struct timespec *start, struct timespec *end) {
+
+	return (double)(end -> tv_sec - start -> tv_sec) * 1e3 + (double)(end -> tv_nsec - start -> tv_nsec) / 1e6;
+}
+
+// Entities, strings and components of 16 bytes to 1 KB, some zeroed and some grown like a parser would
+static void load_level(void **blocks, int num_blocks) {
+
+	unsigned int seed = 97;
+
+	for (int i = 0; i < num_blocks; i++) {
+		seed = seed * 1103515245u + 12345u;
+		size_t size = 16 + (seed >> 16) % 1008;
+
+		if (i % 8 == 0) {
+			blocks[i] = SDL_calloc(1, size);
+		} else if (i % 8 == 1) {
+			blocks[i] = SDL_realloc(SDL_malloc(size / 2 + 1), size);
+		} else {
+			blocks[i] = SDL_malloc(size);
+		}
+	}
+}
+
+void tag_release_test(int num_blocks) {
+
+	// Allocated before switching, so only the level ends up in the test instance
+	void **blocks = SDL_malloc(sizeof(void *) * num_blocks);
+
+	tlsf_instance *previous = sdl_tlsf_get_instance();
+	tlsf_instance *instance = sdl_tlsf_create_instance((1 << 20) * 32);
+	if (instance == NULL) {
+		SDL_free(blocks);
+		return;
+	}
+	sdl_tlsf_set_instance(instance);
+
+	struct timespec start, end;
+
+	// Unloading block by block
+	load_level(blocks, num_blocks);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < num_blocks; i++) {
+		SDL_free(blocks[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double free_ms = elapsed_ms(&start, &end);
+
+	// The same level under a tag, with one object that has to outlive it
+	sdl_tlsf_push_tag(LEVEL_TAG);
+	load_level(blocks, num_blocks);
+
+	sdl_tlsf_push_tag(0);
+	char *save_state = SDL_malloc(256);
+	sdl_tlsf_pop_tag();
+
+	sdl_tlsf_pop_tag();
+
+	size_t tag_used = sdl_tlsf_tag_used(instance, LEVEL_TAG);
+
+	// A tag pushed on one instance follows the thread when it switches, into that instance's heap for the tag
+	tlsf_instance *other = sdl_tlsf_create_instance((1 << 20) * 4);
+	sdl_tlsf_push_tag(LEVEL_TAG);
+	sdl_tlsf_set_instance(other);
+
+	void *switched = SDL_malloc(100);
+	size_t switched_size = sdl_tlsf_usable_size(switched);
+	size_t switched_used = sdl_tlsf_tag_used(other, LEVEL_TAG);
+	SDL_free(switched);
+	size_t switched_left = sdl_tlsf_tag_used(other, LEVEL_TAG);
+
+	sdl_tlsf_set_instance(instance);
+	sdl_tlsf_pop_tag();
+	sdl_tlsf_destroy_instance(other);
+
+	// Blocks under the tag free normally as well
+	SDL_free(blocks[0]);
+	blocks[0] = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t mappings = sdl_tlsf_release_tag(instance, LEVEL_TAG);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double release_ms = elapsed_ms(&start, &end);
+
+	size_t left = instance -> total_used;
+	SDL_free(save_state);
+	int check = sdl_tlsf_check_active_instance();
+	size_t used = instance -> total_used;
+
+	sdl_tlsf_set_instance(previous);
+	sdl_tlsf_destroy_instance(instance);
+	SDL_free(blocks);
+
+	SDL_Log("Tagged heaps: level of %d blocks, %zu KB under the tag\n", num_blocks, tag_used / 1024);
+	SDL_Log("Freeing every block: %.3f ms, releasing the tag: %.3f ms (%zu mappings)\n", free_ms, release_ms, mappings);
+	SDL_Log("%zu bytes left outside the tag, %zu bytes in use at the end, heap check %s\n",
+			left, used, check == 0 ? "passed" : "failed");
+	SDL_Log("Switched instance under the tag: %zu usable bytes, %zu bytes in its tag heap, %zu after the free\n",
+			switched_size, switched_used, switched_left);
+}
@@ -0,0 +1,14 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_TAG_OPS_H
+#define TLSF_TAG_OPS_H
+
+#include "../SDL_TLSF/sdl_tlsf.h"
+
+// Loads a level of num_blocks small allocations and unloads it twice, once freeing every block and once
+// with everything under a tag that sdl_tlsf_release_tag drops. Reports both times and the mappings released
+void tag_release_test(int num_blocks);
+
+#endif //TLSF_TAG_OPS_H
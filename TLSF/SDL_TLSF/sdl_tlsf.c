@@ -4,7 +4,17 @@
 
 // ls /proc
 
+// mremap is a GNU extension
+#define _GNU_SOURCE
+
 #include "sdl_tlsf.h"
+#include "sdl_tlsf_epoch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 // Built-in Valgrind Memcheck
@@ -19,9 +29,122 @@ SDL_Mutex *tlsf_lock = NULL;
 tlsf_instance *active_instance;
 tlsf_instance *base_instance;
 
+// What sdl_tlsf_set_instance picked. active_instance gets swapped to other heaps under the lock,
+// so the paths that run without it resolve the instance from this one
+static tlsf_instance *selected_instance = NULL;
+
 // Used to keep track of the pool id
 size_t pool_id_counter = 0;
 
+// An empty pool's mapping waiting in the depot, the header sits at the start of it
+typedef struct tlsf_depot_region {
+	struct tlsf_depot_region *next;
+	size_t bytes;
+} tlsf_depot_region;
+
+// Process wide, guarded by tlsf_lock like everything else
+static tlsf_depot_region *pool_depot = NULL;
+static size_t depot_max_bytes = SDL_TLSF_DEPOT_DEFAULT_BYTES;
+static tlsf_depot_advice depot_advice = SDL_TLSF_DEPOT_KEEP;
+static tlsf_depot_stats depot_stats;
+
+// Tag heaps the calling thread has pushed, allocations go to the top one
+static _Thread_local tlsf_instance *tag_stack[SDL_TLSF_MAX_TAG_DEPTH];
+static _Thread_local int tag_depth = 0;
+static _Thread_local int tag_overflow = 0; // Pushes past the end, popped before the stack
+
+// Reallocs of a live block the calling thread is in, pressure callbacks could free that block under them
+static _Thread_local int resizing = 0;
+
+// Swaps the calling thread is inside, while it is in one active_instance is its own to read
+static _Thread_local int swap_depth = 0;
+
+// Makes instance the active one for work done under the lock, returns the one to put back
+static tlsf_instance *sdl_tlsf_swap_in(tlsf_instance *instance) {
+
+	tlsf_instance *previous = active_instance;
+	active_instance = instance;
+	swap_depth++;
+	return previous;
+}
+
+static void sdl_tlsf_swap_out(tlsf_instance *previous) {
+
+	active_instance = previous;
+	swap_depth--;
+}
+
+// The calling thread's instance without taking the lock, other threads' swaps don't show up in it
+static tlsf_instance *sdl_tlsf_current(void) {
+
+	return swap_depth ? active_instance : __atomic_load_n(&selected_instance, __ATOMIC_ACQUIRE);
+}
+
+#define SDL_TLSF_VARIANT(label, p) { \
+	label, \
+	p##_create_with_pool, p##_get_pool, p##_add_pool, p##_remove_pool, \
+	p##_malloc, p##_memalign, p##_realloc, p##_realloc_aligned, p##_calloc, p##_free, \
+	p##_expand, p##_set_deferred_free, p##_compact, \
+	p##_block_size, p##_size, p##_block_size_max, p##_fit_size, \
+	p##_check, p##_check_pool \
+}
+
+const tlsf_variant tlsf_variant_default = SDL_TLSF_VARIANT("default", tlsf);
+const tlsf_variant tlsf_variant_small = SDL_TLSF_VARIANT("small", tlsf_small);
+const tlsf_variant tlsf_variant_fine = SDL_TLSF_VARIANT("fine", tlsf_fine);
+const tlsf_variant tlsf_variant_large = SDL_TLSF_VARIANT("large", tlsf_large);
+const tlsf_variant tlsf_variant_packed = SDL_TLSF_VARIANT("packed", tlsf_packed);
+
+// Size of our metadata in front of tlsf memory, padded so tlsf keeps its alignment and the control structure
+// behind it starts on a cache line
+static size_t sdl_tlsf_header_size(size_t bytes) {
+
+	size_t align = tlsf_control_align();
+
+	return (bytes + align - 1) & ~(align - 1);
+}
+
+static int sdl_tlsf_valid_align(size_t align) {
+
+	return align != 0 && (align & (align - 1)) == 0;
+}
+
+// Whether a huge block stays aligned to align through mremap: it was made with that alignment, or align divides
+// its payload offset and the page size so wherever the kernel moves it the payload lands aligned
+static int sdl_tlsf_huge_keeps_align(tlsf_huge_block *block, size_t align) {
+
+	return align <= block -> align || (align <= (size_t)sysconf(_SC_PAGESIZE) && block -> offset % align == 0);
+}
+
+// Header of the huge block whose payload is ptr. Mappings are page aligned and payloads start at most a page in,
+// so the header opens the page ptr is in, or the page before when ptr is page aligned
+static tlsf_huge_block *sdl_tlsf_huge_block_of(void *ptr) {
+
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t address = (uintptr_t)ptr;
+
+	return (tlsf_huge_block *)((address & (page - 1)) ? address & ~(page - 1) : address - page);
+}
+
+static void *sdl_tlsf_persist_extend(tlsf_persist_header *header, int fd, size_t bytes);
+static void sdl_tlsf_free_owned(void *ptr);
+static void *sdl_tlsf_depot_take(size_t min_bytes, size_t max_bytes, size_t *bytes);
+static int sdl_tlsf_budget_allow(tlsf_instance *instance, size_t bytes);
+static size_t sdl_tlsf_budget_headroom(tlsf_instance *instance);
+static tlsf_instance *sdl_tlsf_budget_owner(tlsf_instance *instance);
+static void sdl_tlsf_add_pool_for(size_t bytes);
+static void sdl_tlsf_budget_grew(tlsf_instance *instance);
+static void sdl_tlsf_depot_donate(void *mem, size_t bytes);
+static size_t sdl_tlsf_pool_extra(void);
+static tlsf_instance *sdl_tlsf_tag_route(void);
+static tlsf_instance *sdl_tlsf_find_tag(tlsf_instance *instance, Uint32 tag);
+static tlsf_instance *sdl_tlsf_create_tag(tlsf_instance *instance, Uint32 tag);
+static tlsf_instance *sdl_tlsf_tag_owner(tlsf_instance *instance, void *ptr);
+static int sdl_tlsf_owns(tlsf_instance *instance, void *ptr);
+static void sdl_tlsf_profile_sample(void *ptr, size_t bytes);
+static void *sdl_tlsf_malloc_unsampled(size_t bytes);
+static void *sdl_tlsf_aligned_alloc_unsampled(size_t align, size_t size);
+
 // Connects the tlsf instance to SDL's memory functions
 void sdl_tlsf_init() {
 
@@ -38,6 +161,7 @@ void sdl_tlsf_init_with_size(size_t bytes) {
 	// Create the base instance and set it as the active instance
 	base_instance = sdl_tlsf_create_instance(bytes);
 	active_instance = base_instance;
+	__atomic_store_n(&selected_instance, base_instance, __ATOMIC_RELEASE);
 
 	// Init our lock
 	tlsf_lock = SDL_CreateMutex();
@@ -45,6 +169,9 @@ void sdl_tlsf_init_with_size(size_t bytes) {
 		SDL_Log("Failed to create mutex\n");
 	}
 
+	// Counted from here, a restart doesn't inherit the last run's numbers
+	sdl_tlsf_lock_clear_stats();
+
 }
 
 // Free the base instance
@@ -53,20 +180,56 @@ void sdl_tlsf_quit() {
 	// Rebase the instance, just in case
 	sdl_tlsf_rebase_instance();
 
+	// Printed while the base instance is still around for SDL_Log to allocate from
+	tlsf_lock_stats lock_stats;
+	sdl_tlsf_get_lock_stats(&lock_stats);
+	sdl_tlsf_lock_print_stats(&lock_stats);
+
 	// Destroy active instance
 	sdl_tlsf_destroy_instance(base_instance);
 
+	// Its pools just went to the depot
+	sdl_tlsf_depot_trim(0);
+
 	// Honestly our best bet at destroying the mutex
 	tlsf_lock = NULL;
 }
 
 
+const tlsf_variant *sdl_tlsf_pick_variant(size_t pool_size) {
+
+	// Smaller first level tables mean a smaller control structure and fewer bitmap words to scan
+	if (pool_size <= tlsf_variant_small.block_size_max()) {
+		return &tlsf_variant_small;
+	}
+	if (pool_size <= tlsf_variant_default.block_size_max()) {
+		return &tlsf_variant_default;
+	}
+	return &tlsf_variant_large;
+}
+
 tlsf_instance *sdl_tlsf_create_instance(size_t pool_size) {
 
-	// Calculate total size to include instance and pool metadata
-    size_t total_required_size = pool_size + sizeof(tlsf_instance) + sizeof(tlsf_pool);
+	return sdl_tlsf_create_instance_with_variant(pool_size, sdl_tlsf_pick_variant(pool_size));
+}
+
+// Size of the memory holding an instance, its first pool and their metadata
+static size_t sdl_tlsf_instance_size(size_t pool_size) {
+
+	size_t total_required_size = pool_size + sdl_tlsf_header_size(sizeof(tlsf_instance)) + sdl_tlsf_header_size(sizeof(tlsf_pool));
 	total_required_size += tlsf_pool_overhead();  // Add the overhead of the pool
 
+	return total_required_size;
+}
+
+// Lays out an instance and its first pool in mem, which must hold sdl_tlsf_instance_size bytes
+static tlsf_instance *sdl_tlsf_init_instance(void *mem, size_t pool_size, const tlsf_variant *variant);
+
+tlsf_instance *sdl_tlsf_create_instance_with_variant(size_t pool_size, const tlsf_variant *variant) {
+
+	// Calculate total size to include instance and pool metadata
+    size_t total_required_size = sdl_tlsf_instance_size(pool_size);
+
     // Create some memory for the tlsf instance using mmap
     void *mem = mmap(NULL, total_required_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (mem == MAP_FAILED) {
@@ -77,24 +240,38 @@ tlsf_instance *sdl_tlsf_create_instance(size_t pool_size) {
     // Notify Valgrind about the allocation
     VALGRIND_MALLOCLIKE_BLOCK(mem, total_required_size, 0, 0);
 
+    return sdl_tlsf_init_instance(mem, pool_size, variant);
+}
+
+static tlsf_instance *sdl_tlsf_init_instance(void *mem, size_t pool_size, const tlsf_variant *variant) {
+
 	// Initialize the tlsf_instance at the start of the mapped memory
     tlsf_instance *new_instance = (tlsf_instance *)mem;
 
     // Initialize the tlsf_pool directly after tlsf_instance in memory
-    tlsf_pool *pool = (tlsf_pool *)((char *)mem + sizeof(tlsf_instance));
+    tlsf_pool *pool = (tlsf_pool *)((char *)mem + sdl_tlsf_header_size(sizeof(tlsf_instance)));
     memset(pool, 0, sizeof(tlsf_pool));  // Zero out the pool structure
 
     // Set up the memory pool directly after the tlsf_pool in memory
-    void *pool_mem = (char *)pool + sizeof(tlsf_pool);
+    void *pool_mem = (char *)pool + sdl_tlsf_header_size(sizeof(tlsf_pool));
 
 	// Now that we have the memory divied up we can initialize variables
-    new_instance -> instance = tlsf_create_with_pool(pool_mem, pool_size);
+    new_instance -> variant = variant;
+    new_instance -> instance = variant -> create_with_pool(pool_mem, pool_size);
     new_instance -> num_pools = 1;
     new_instance -> pool_size = pool_size;
 
+    new_instance -> growth = SDL_TLSF_GROWTH_FIXED;
+    new_instance -> max_pool_size = pool_size;
+    new_instance -> next_pool_size = pool_size;
+    new_instance -> growth_rate = 0;
+    new_instance -> last_growth_ns = 0;
+    new_instance -> used_at_growth = 0;
+    new_instance -> growth_events = 0;
+
     // Configure the pool object
     pool -> mem = pool_mem;
-    pool -> pool = tlsf_get_pool(new_instance->instance); // Gets the pool from the instance
+    pool -> pool = variant -> get_pool(new_instance->instance); // Gets the pool from the instance
     pool -> bytes = pool_size;
     pool -> used = 0;
 
@@ -109,11 +286,49 @@ tlsf_instance *sdl_tlsf_create_instance(size_t pool_size) {
     // Link the pool into the new_instance
     new_instance -> tlsf_pools.header = pool;
     new_instance -> tlsf_pools.tail = pool;
+    new_instance -> last_pool = pool;
 
     // Initialize the remaining fields
     new_instance -> total_size = pool_size;
     new_instance -> total_used = 0;
 
+    // Anything over half a pool would fragment it, map those separately
+    new_instance -> huge_blocks = NULL;
+    new_instance -> huge_threshold = pool_size / 2;
+    new_instance -> huge_sized_min = new_instance -> huge_threshold;
+    new_instance -> num_huge = 0;
+    new_instance -> huge_bytes = 0;
+
+    new_instance -> realloc_growth = 0;
+
+    new_instance -> persist = NULL;
+    new_instance -> snapshot_fd = -1;
+    new_instance -> snapshot_torn = 0;
+
+    new_instance -> owner = 0;
+    new_instance -> remote_frees = NULL;
+    new_instance -> retired_pending = 0;
+    new_instance -> remote_drained = 0;
+    new_instance -> remote_batches = 0;
+
+    new_instance -> cpu_cache = NULL;
+
+    new_instance -> soft_limit = 0;
+    new_instance -> hard_limit = 0;
+    new_instance -> soft_signalled = 0;
+    new_instance -> in_pressure = 0;
+    new_instance -> num_pressure = 0;
+    new_instance -> peak_footprint = pool_size;
+    new_instance -> soft_events = 0;
+    new_instance -> hard_events = 0;
+    new_instance -> hard_recovered = 0;
+    new_instance -> growth_denied = 0;
+
+    new_instance -> tag = 0;
+    new_instance -> parent = NULL;
+    new_instance -> tags = NULL;
+    new_instance -> next_tag = NULL;
+
 
 //    SDL_Log("Break here and view whats up!");
 
@@ -121,26 +336,40 @@ tlsf_instance *sdl_tlsf_create_instance(size_t pool_size) {
 }
 
 tlsf_instance *sdl_tlsf_get_instance() {
-	return active_instance;
+	return sdl_tlsf_current();
 }
 
 void sdl_tlsf_set_instance(tlsf_instance *instance) {
-	SDL_LockMutex(tlsf_lock);
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
 	active_instance = instance;
-	SDL_UnlockMutex(tlsf_lock);
+	__atomic_store_n(&selected_instance, instance, __ATOMIC_RELEASE);
+	sdl_tlsf_lock_release(tlsf_lock);
 }
 
 tlsf_instance *sdl_tlsf_rebase_instance() {
 
-	SDL_LockMutex(tlsf_lock);
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
 
 	tlsf_instance *current_instance = sdl_tlsf_get_instance();
 	active_instance = base_instance;
+	__atomic_store_n(&selected_instance, base_instance, __ATOMIC_RELEASE);
 
-	SDL_UnlockMutex(tlsf_lock);
+	sdl_tlsf_lock_release(tlsf_lock);
 	return current_instance;
 }
 
+// Retired blocks still waiting on an epoch, for the instance and the tag heaps that go with it
+static size_t sdl_tlsf_retired_pending(tlsf_instance *instance) {
+
+	size_t pending = __atomic_load_n(&instance -> retired_pending, __ATOMIC_ACQUIRE);
+
+	for (tlsf_instance *tag = instance -> tags; tag != NULL; tag = tag -> next_tag) {
+		pending += sdl_tlsf_retired_pending(tag);
+	}
+
+	return pending;
+}
+
 void sdl_tlsf_destroy_instance( tlsf_instance *instance) {
 
 	if (!instance) {
@@ -148,18 +377,78 @@ void sdl_tlsf_destroy_instance( tlsf_instance *instance) {
         return;
     }
 
-    SDL_LockMutex(tlsf_lock);  // Ensure thread safety
+    // Our own retired blocks can be waited out, outside the lock since readers may need it to leave
+    if (sdl_tlsf_retired_pending(instance) > 0) {
+        sdl_tlsf_epoch_barrier();
+    }
+
+    sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);  // Ensure thread safety
+
+    // Another thread's retired list would free into the unmapped instance later
+    size_t retired = sdl_tlsf_retired_pending(instance);
+    if (retired > 0) {
+        SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Not destroying an instance with %zu retired blocks still pending\n", retired);
+        sdl_tlsf_lock_release(tlsf_lock);
+        return;
+    }
+
+    // Tag heaps go with their instance
+    while (instance -> tags != NULL) {
+        sdl_tlsf_destroy_instance(instance -> tags);
+    }
+
+    // Samples of blocks that are about to go without a free
+    sdl_tlsf_profile_forget_instance(instance);
+
+    // A tag heap leaves its instance's list
+    if (instance -> parent) {
+        tlsf_instance **link = &instance -> parent -> tags;
+        while (*link != instance) {
+            link = &(*link) -> next_tag;
+        }
+        *link = instance -> next_tag;
+    }
+
+    // The cached blocks live in the pools, they go with them
+    if (instance -> cpu_cache) {
+        sdl_tlsf_cpu_cache_destroy(instance -> cpu_cache);
+        instance -> cpu_cache = NULL;
+    }
+
+    // The whole region goes at once, pools and all
+    if (instance -> persist) {
+        tlsf_persist_header *header = instance -> persist;
+
+        if (active_instance == instance) active_instance = NULL;
+        if (selected_instance == instance) __atomic_store_n(&selected_instance, NULL, __ATOMIC_RELEASE);
+        if (base_instance == instance) base_instance = NULL;
+
+        if (instance -> snapshot_fd >= 0) close(instance -> snapshot_fd);
+        munmap(header, header -> reserved);
+
+        sdl_tlsf_lock_release(tlsf_lock);
+        return;
+    }
 
     // Free all pools except the head, which is contiguous with the tlsf_instance
+    // The control structure goes with the instance, so blocks still in a pool don't have to be freed first
     tlsf_pool *current_pool = instance->tlsf_pools.tail;
     while (current_pool != NULL && current_pool != instance->tlsf_pools.header) {
         tlsf_pool *prev_pool = current_pool->prev;
-        sdl_tlsf_free_pool(current_pool);
+
+        VALGRIND_FREELIKE_BLOCK(current_pool, 0);
+        sdl_tlsf_depot_donate(current_pool, current_pool -> bytes + sdl_tlsf_pool_extra());
+
         current_pool = prev_pool;
     }
 
+    // Unmap any huge blocks still owned by the instance
+    while (instance->huge_blocks != NULL) {
+        sdl_tlsf_huge_free(instance, instance->huge_blocks);
+    }
+
     // Calculate initial mmap size
-    size_t initial_alloc = sizeof(tlsf_instance) + sizeof(tlsf_pool) + instance->pool_size;
+    size_t initial_alloc = sdl_tlsf_header_size(sizeof(tlsf_instance)) + sdl_tlsf_header_size(sizeof(tlsf_pool)) + instance->pool_size;
 	initial_alloc += tlsf_pool_overhead();  // Add the overhead of the pool
 
     // Notify Valgrind that the memory is being freed
@@ -176,19 +465,52 @@ void sdl_tlsf_destroy_instance( tlsf_instance *instance) {
     if (active_instance == instance) {
         active_instance = NULL;
     }
+    if (selected_instance == instance) {
+        __atomic_store_n(&selected_instance, NULL, __ATOMIC_RELEASE);
+    }
     if (base_instance == instance) {
         base_instance = NULL;
 
 	// Don't try unlocking the mutex if we just freed all memory lol
     } else {
-		SDL_UnlockMutex(tlsf_lock);  // Release the mutex
+		sdl_tlsf_lock_release(tlsf_lock);  // Release the mutex
 	}
 
 }
 
 void sdl_tlsf_print_instance(tlsf_instance *instance) {
 
-	SDL_LockMutex(tlsf_lock);
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	SDL_Log("Variant: %s (control %zu bytes)\n", instance -> variant -> name, instance -> variant -> size());
+
+	if (instance -> growth != SDL_TLSF_GROWTH_FIXED) {
+		SDL_Log("Growth: %s up to %zu byte pools, %zu pools added\n",
+				instance -> growth == SDL_TLSF_GROWTH_GEOMETRIC ? "geometric" : "predictive",
+				instance -> max_pool_size, instance -> growth_events);
+	}
+
+	if (instance -> owner) {
+		SDL_Log("Owner thread: %llu, remote frees drained: %zu in %zu batches\n",
+				(unsigned long long)instance -> owner, instance -> remote_drained, instance -> remote_batches);
+	}
+
+	if (instance -> soft_limit || instance -> hard_limit) {
+		SDL_Log("Budget: %zu of %zu soft / %zu hard bytes, peak %zu, %zu soft and %zu hard events, %zu growths denied\n",
+				instance -> total_size + instance -> huge_bytes, instance -> soft_limit, instance -> hard_limit,
+				instance -> peak_footprint, instance -> soft_events, instance -> hard_events, instance -> growth_denied);
+	}
+
+	for (tlsf_instance *heap = instance -> tags; heap != NULL; heap = heap -> next_tag) {
+		SDL_Log("Tag %u: %zu pools, %zu huge blocks, %zu bytes used\n", heap -> tag, heap -> num_pools, heap -> num_huge,
+				heap -> total_used + heap -> huge_bytes);
+	}
+
+	if (instance -> cpu_cache) {
+		SDL_Log("CPU cache: %d CPUs (%s), %zu blocks cached\n", sdl_tlsf_cpu_cache_num_cpus(instance -> cpu_cache),
+				sdl_tlsf_cpu_cache_uses_rseq(instance -> cpu_cache) ? "rseq" : "spinlock",
+				sdl_tlsf_cpu_cache_count(instance -> cpu_cache));
+	}
 
 	tlsf_pool *pool = instance -> tlsf_pools.header;
 
@@ -204,127 +526,148 @@ void sdl_tlsf_print_instance(tlsf_instance *instance) {
 		pool = pool -> next;
 	}
 
-	SDL_UnlockMutex(tlsf_lock);
+	tlsf_huge_block *huge = instance -> huge_blocks;
+
+	while (huge != NULL) {
+
+		SDL_Log("Huge Block: %p\n", (void *)huge);
+		SDL_Log("Huge Bytes: %zu\n", huge -> bytes);
+		SDL_Log("Huge Mapped: %zu\n", huge -> map_size);
+		SDL_Log("\n");
+
+		huge = huge -> next;
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
 
 }
 
-void *sdl_tlsf_malloc(size_t bytes) {
+// Largest pool the instance will add, a single allocation has to fit in it
+static size_t sdl_tlsf_max_pool_size(tlsf_instance *instance) {
 
+	return instance -> max_pool_size > instance -> pool_size ? instance -> max_pool_size : instance -> pool_size;
+}
 
+// Largest pool the variant can address, add_pool takes the pool overhead off before making the block
+static size_t sdl_tlsf_variant_max_pool_size(const tlsf_variant *variant) {
 
-	SDL_LockMutex(tlsf_lock);
+	return variant -> block_size_max() + tlsf_pool_overhead();
+}
 
-	// Makes sure we are not allocating more memory than can fit in a pool
-	if (bytes >= (active_instance -> pool_size) - tlsf_pool_overhead()) {
-		SDL_Log("Requested memory size is greater than pool size\n");
+int sdl_tlsf_set_growth_policy(tlsf_instance *instance, tlsf_growth_policy policy, size_t max_pool_size) {
 
-		SDL_UnlockMutex(tlsf_lock);
-		return NULL;
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	// Block sizes are capped by the variant, a bigger pool would have space no block can reach
+	size_t variant_max = sdl_tlsf_variant_max_pool_size(instance -> variant);
+	if (policy != SDL_TLSF_GROWTH_FIXED && max_pool_size > variant_max) {
+		SDL_Log("The %s variant can't address pools over %zu bytes\n", instance -> variant -> name, variant_max);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return -1;
 	}
 
+	instance -> growth = policy;
+	instance -> max_pool_size = policy == SDL_TLSF_GROWTH_FIXED ? instance -> pool_size : max_pool_size;
+	instance -> next_pool_size = instance -> pool_size * 2 < instance -> max_pool_size ? instance -> pool_size * 2 : instance -> max_pool_size;
+	instance -> growth_rate = 0;
+	instance -> last_growth_ns = 0;
 
-	// Check if we have enough memory to allocate
-	if (active_instance -> total_size - active_instance -> total_used < bytes) {
+	sdl_tlsf_lock_release(tlsf_lock);
+	return 0;
+}
 
-		// Add another pool to the instance
-		sdl_tlsf_add_pool();
-	}
+void sdl_tlsf_set_huge_threshold(tlsf_instance *instance, size_t bytes) {
 
-	void *ptr = tlsf_malloc(active_instance -> instance, bytes);;
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
 
-	if (!ptr) {
+	// Anything that can't fit in a pool has to be mapped on its own
+	size_t max_threshold = sdl_tlsf_max_pool_size(instance) - tlsf_pool_overhead();
+	instance -> huge_threshold = bytes < max_threshold ? bytes : max_threshold;
 
-		// Test if the problem is having a contiguous block of memory
-		sdl_tlsf_add_pool();
-		ptr = tlsf_malloc(active_instance -> instance, bytes);
+	// Huge blocks are separate mappings that wouldn't make it into a snapshot
+	if (instance -> persist) {
+		instance -> huge_threshold = SIZE_MAX;
+	}
 
-		if (!ptr) {
-			SDL_Log("Failed to allocate memory\n");
-			SDL_UnlockMutex(tlsf_lock);
-			return NULL;
-		}
+	// Pool blocks from under a higher threshold are still around, sized frees can't assume those are huge
+	if (instance -> huge_threshold > instance -> huge_sized_min) {
+		instance -> huge_sized_min = instance -> huge_threshold;
 	}
 
-	size_t block_size = tlsf_block_size(ptr);
+	sdl_tlsf_lock_release(tlsf_lock);
+}
 
-	active_instance -> total_used += block_size;
+void sdl_tlsf_set_realloc_growth(tlsf_instance *instance, size_t percent) {
 
-	// Update the pool list
-	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
-	if (pool == NULL) {
-		SDL_Log("Failed to Assign Pool\n");
-		SDL_UnlockMutex(tlsf_lock);
-		return NULL;
-	}
-	pool -> used += block_size;
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
 
+	instance -> realloc_growth = percent;
 
-	SDL_UnlockMutex(tlsf_lock);
-	return ptr;
+	sdl_tlsf_lock_release(tlsf_lock);
 }
 
-void sdl_tlsf_free(void *ptr) {
+void sdl_tlsf_set_deferred_free(tlsf_instance *instance, int enable) {
 
-	SDL_LockMutex(tlsf_lock);
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
 
-	// Get the pool that the pointer is within
-	tlsf_pool *pool = sdl_tlsf_get_pool((size_t) ptr);
+	instance -> variant -> set_deferred_free(instance -> instance, enable);
 
-	// Get the size of the freed block
-	size_t block_size = tlsf_block_size(ptr);
+	sdl_tlsf_lock_release(tlsf_lock);
+}
 
-	// Actually free the memory
-	tlsf_free(active_instance -> instance, ptr);
+// Allocation from the pools or a huge mapping, everything but the per-CPU cache
+static void *sdl_tlsf_malloc_uncached(size_t bytes) {
 
-	// Update the pool list
-	pool -> used -= block_size;
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_MALLOC);
 
+	// Blocks other threads handed back are free again before we look for space
+	sdl_tlsf_drain_remote_frees(active_instance);
 
-	// Update the total used memory
-	active_instance -> total_used -= block_size;
+	// Large requests get their own mapping so they can be resized with mremap
+	if (bytes >= active_instance -> huge_threshold) {
+		void *ptr = sdl_tlsf_huge_alloc(active_instance, 0, bytes);
 
-	// Check how much memory is left in the pool
-	if (pool -> used == 0 && active_instance -> num_pools > 1) {
-//
-////		SDL_Log("Freeing Tail");
-//
-//		// Remove the pool
-		sdl_tlsf_free_pool(pool);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return ptr;
 	}
 
+	// Makes sure we are not allocating more memory than can fit in a pool
+	if (bytes >= sdl_tlsf_max_pool_size(active_instance) - tlsf_pool_overhead()) {
+		SDL_Log("Requested memory size is greater than pool size\n");
 
-	SDL_UnlockMutex(tlsf_lock);
-}
-
-void *sdl_tlsf_calloc(size_t nmemb, size_t size) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
 
-	SDL_LockMutex(tlsf_lock);
 
-	size_t bytes = nmemb * size;
+	// Denied growth is counted in the budget stats, logging every one would flood a heap running at its limit
+	size_t denied = sdl_tlsf_budget_owner(active_instance) -> growth_denied;
 
 	// Check if we have enough memory to allocate
 	if (active_instance -> total_size - active_instance -> total_used < bytes) {
 
 		// Add another pool to the instance
-		sdl_tlsf_add_pool();
+		sdl_tlsf_add_pool_for(bytes);
 	}
 
-	void *ptr = tlsf_calloc(active_instance -> instance, size, nmemb);
+	void *ptr = active_instance -> variant -> malloc(active_instance -> instance, bytes);;
 
 	if (!ptr) {
 
 		// Test if the problem is having a contiguous block of memory
-		sdl_tlsf_add_pool();
-		ptr = tlsf_calloc(active_instance -> instance, size, nmemb);
+		sdl_tlsf_add_pool_for(bytes);
+		ptr = active_instance -> variant -> malloc(active_instance -> instance, bytes);
 
 		if (!ptr) {
-			SDL_Log("Failed to allocate memory\n");
-			SDL_UnlockMutex(tlsf_lock);
+			if (sdl_tlsf_budget_owner(active_instance) -> growth_denied == denied) {
+				SDL_Log("Failed to allocate memory\n");
+			}
+			sdl_tlsf_lock_release(tlsf_lock);
 			return NULL;
 		}
 	}
 
-	size_t block_size = tlsf_block_size(ptr);
+	size_t block_size = active_instance -> variant -> block_size(ptr);
 
 	active_instance -> total_used += block_size;
 
@@ -332,239 +675,2793 @@ void *sdl_tlsf_calloc(size_t nmemb, size_t size) {
 	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
 	if (pool == NULL) {
 		SDL_Log("Failed to Assign Pool\n");
-		SDL_UnlockMutex(tlsf_lock);
+		sdl_tlsf_lock_release(tlsf_lock);
 		return NULL;
 	}
 	pool -> used += block_size;
 
 
-	SDL_UnlockMutex(tlsf_lock);
-
+	sdl_tlsf_lock_release(tlsf_lock);
 	return ptr;
 }
 
-void *sdl_tlsf_realloc(void *ptr, size_t size) {
-
-	SDL_LockMutex(tlsf_lock);
+// A miss takes a batch of class sized blocks of instance under one lock, returns one and caches the rest
+static void *sdl_tlsf_cpu_cache_refill(tlsf_instance *instance, int size_class) {
 
-    // Get the current block size
-    size_t current_size = ptr ? tlsf_block_size(ptr) : 0;
+	size_t bytes = (size_t)size_class << SDL_TLSF_CPU_CLASS_SHIFT;
 
-    // Check if downsizing or upsizing
-    if (size > current_size) {
-        // Make sure we are not reallocating more memory than can fit in a pool
-        if (size >= (active_instance -> pool_size - tlsf_pool_overhead())) {
-            SDL_Log("Requested realloc size is greater than pool size\n");
-            SDL_UnlockMutex(tlsf_lock);
-            return NULL;
-        }
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_MALLOC);
 
-        // Check if we need more total memory than available
-        if (active_instance -> total_size - active_instance -> total_used < size - current_size) {
-            sdl_tlsf_add_pool();  // Add another pool to the instance
-        }
-    }
+	// The cache may have gone while we waited
+	tlsf_cpu_cache *cache = instance -> cpu_cache;
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
 
-    // Attempt to reallocate memory
-    void *new_ptr = tlsf_realloc(active_instance -> instance, ptr, size);
-    if (!new_ptr && size > current_size) {
-        // If realloc fails and it's a size increase, try adding a pool and reallocating
-        sdl_tlsf_add_pool();
-        new_ptr = tlsf_realloc(active_instance -> instance, ptr, size);
-    }
+	void *ptr = sdl_tlsf_malloc_uncached(bytes);
 
-    // If still fails, or it's a decrease and failed, return NULL
-    if (!new_ptr) {
-        SDL_Log("Failed to reallocate memory\n");
-        SDL_UnlockMutex(tlsf_lock);
-        return NULL;
-    }
+	for (int i = 1; ptr != NULL && i < SDL_TLSF_CPU_REFILL; i++) {
+		void *extra = sdl_tlsf_malloc_uncached(bytes);
+		if (extra == NULL) {
+			break;
+		}
 
-    // Adjust the used memory counters
-    if (new_ptr != ptr) {
-        // Successfully reallocated to a new block
-        tlsf_pool *old_pool = sdl_tlsf_get_pool((size_t)ptr);
-        tlsf_pool *new_pool = sdl_tlsf_get_pool((size_t)new_ptr);
+		// Another thread on this CPU filled the list in the meantime
+		if (cache == NULL || !sdl_tlsf_cpu_cache_push(cache, size_class, extra)) {
+			sdl_tlsf_free_owned(extra);
+			break;
+		}
+	}
 
-        // Update the old and new pool used memory
-        if (old_pool) old_pool -> used -= current_size;
-        if (new_pool) new_pool -> used += tlsf_block_size(new_ptr);
+	sdl_tlsf_swap_out(previous);
+	sdl_tlsf_lock_release(tlsf_lock);
+	return ptr;
+}
 
-        // Check if the old pool is empty and consider removing it
-        if (old_pool && old_pool -> used <= 0 && active_instance -> num_pools > 1) {
-            sdl_tlsf_free_pool(old_pool);
-        }
-    } else {
-        // Reallocated in place, adjust only the current pool's used memory
-        tlsf_pool *pool = sdl_tlsf_get_pool((size_t)new_ptr);
-        if (pool) {
-            pool->used += tlsf_block_size(new_ptr) - current_size;
-        }
-    }
+// Everything sdl_tlsf_malloc does but profiling, for the paths that sample on their own
+static void *sdl_tlsf_malloc_unsampled(size_t bytes) {
 
-    SDL_UnlockMutex(tlsf_lock);
-    return new_ptr;
-}
+	// Inside a tag the block comes from the tag's heap
+	tlsf_instance *heap = sdl_tlsf_tag_route();
+	if (heap != NULL) {
+		sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_MALLOC);
 
-int sdl_tlsf_check_active_instance() {
+		tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+		void *ptr = sdl_tlsf_malloc_unsampled(bytes);
+		sdl_tlsf_swap_out(previous);
 
-	SDL_LockMutex(tlsf_lock);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return ptr;
+	}
 
-	int ret_val = tlsf_check(active_instance  -> instance);
+	// Small requests come off this CPU's list without the lock
+	tlsf_instance *instance = sdl_tlsf_current();
+	tlsf_cpu_cache *cache = instance -> cpu_cache;
+	if (cache != NULL && bytes > 0 && bytes <= SDL_TLSF_CPU_MAX_SIZE) {
+		int size_class = (int)((bytes + (1 << SDL_TLSF_CPU_CLASS_SHIFT) - 1) >> SDL_TLSF_CPU_CLASS_SHIFT);
 
-	SDL_UnlockMutex(tlsf_lock);
+		void *ptr = sdl_tlsf_cpu_cache_pop(cache, size_class);
+		if (ptr == NULL) {
+			ptr = sdl_tlsf_cpu_cache_refill(instance, size_class);
+		}
+		return ptr;
+	}
 
-	return ret_val;
+	return sdl_tlsf_malloc_uncached(bytes);
 }
 
-int sdl_tlsf_check_pool(pool_t pool) {
+void *sdl_tlsf_malloc(size_t bytes) {
+
+	void *ptr = sdl_tlsf_malloc_unsampled(bytes);
 
-	SDL_LockMutex(tlsf_lock);
+	// Unsampled allocations stop at the decrement
+	if (sdl_tlsf_profile_tick(bytes)) {
+		sdl_tlsf_profile_sample(ptr, bytes);
+	}
+	return ptr;
+}
+
+// Puts a small block on this CPU's list, 0 if it has to be freed for real
+static int sdl_tlsf_cpu_cache_free(void *ptr) {
 
-	int ret_val = tlsf_check_pool(pool);
+	// With tags the block may not be ours, finding out costs a pool search so the cache is skipped
+	tlsf_instance *instance = sdl_tlsf_current();
+	tlsf_cpu_cache *cache = instance -> cpu_cache;
+	if (cache == NULL || instance -> tags != NULL) {
+		return 0;
+	}
 
-	SDL_UnlockMutex(tlsf_lock);
+	// Huge payloads sit behind zeroed header padding, so they read as 0 here and never get cached
+	// A block holds at least its class size, whatever it was requested with
+	size_t block_size = instance -> variant -> block_size(ptr);
+	if (block_size < (1 << SDL_TLSF_CPU_CLASS_SHIFT) || block_size > SDL_TLSF_CPU_MAX_SIZE) {
+		return 0;
+	}
 
-	return ret_val;
+	return sdl_tlsf_cpu_cache_push(cache, (int)(block_size >> SDL_TLSF_CPU_CLASS_SHIFT), ptr);
 }
 
-// Loop through the pool list and check if the pointer is within the range of the pool
-tlsf_pool *sdl_tlsf_get_pool(size_t ptr_addr) {
+// Hands a pool block back to TLSF and releases the pool once nothing is left in it
+static void sdl_tlsf_free_block(tlsf_pool *pool, void *ptr, size_t block_size) {
 
-	SDL_LockMutex(tlsf_lock);
+	// Actually free the memory
+	active_instance -> variant -> free(active_instance -> instance, ptr);
 
-	tlsf_pool_list poolList = active_instance  -> tlsf_pools;
-	tlsf_pool *pool = poolList.header;
+	// Update the pool list
+	pool -> used -= block_size;
 
-	while (pool != NULL) {
-		if (ptr_addr >= (size_t)pool -> start && ptr_addr <= (size_t)pool -> end) {
 
-			SDL_UnlockMutex(tlsf_lock);
-			return pool;
-		}
-		pool = pool -> next;
-	}
+	// Update the total used memory
+	active_instance -> total_used -= block_size;
 
-	SDL_UnlockMutex(tlsf_lock);
+	// Check how much memory is left in the pool
+	if (pool -> used == 0 && active_instance -> num_pools > 1) {
+		sdl_tlsf_free_pool(pool);
+	}
+}
 
-	return NULL;
+// Whether a block of instance has to go on its remote queue instead of being freed here
+static int sdl_tlsf_is_remote_free(tlsf_instance *instance) {
 
+	Uint64 owner = __atomic_load_n(&instance -> owner, __ATOMIC_RELAXED);
 
+	return owner != 0 && owner != SDL_GetCurrentThreadID();
 }
 
-void sdl_tlsf_add_pool() {
+// Frees into the active instance, the caller is the owner or the instance has none
+static void sdl_tlsf_free_owned(void *ptr) {
 
-	SDL_LockMutex(tlsf_lock);
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE);
 
-    size_t pool_size = active_instance->pool_size;
-    size_t alloc_size = pool_size + sizeof(tlsf_pool) + tlsf_pool_overhead();
+	// Get the pool that the pointer is within
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t) ptr);
 
-    void *mem = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (mem == MAP_FAILED) {
-        SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to create memory for new pool\n");
-        SDL_UnlockMutex(tlsf_lock);
-        return;
-    }
+	// Not in any pool, it must have its own mapping
+	if (pool == NULL) {
+		tlsf_huge_block *huge = sdl_tlsf_get_huge_block(active_instance, ptr);
+		tlsf_instance *heap = huge ? NULL : sdl_tlsf_tag_owner(active_instance, ptr);
+
+		if (huge) {
+			sdl_tlsf_huge_free(active_instance, huge);
+		} else if (heap) {
+			tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+			sdl_tlsf_free_owned(ptr);
+			sdl_tlsf_swap_out(previous);
+		} else {
+			SDL_Log("Attempt to free memory not owned by the instance\n");
+		}
 
-    VALGRIND_MALLOCLIKE_BLOCK(mem, alloc_size, 0, 0);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
 
-    tlsf_pool *new_pool = (tlsf_pool *)mem;
-    void *pool_mem = (char *)mem + sizeof(tlsf_pool);
+	sdl_tlsf_free_block(pool, ptr, active_instance -> variant -> block_size(ptr));
 
-    pool_t pool = tlsf_add_pool(active_instance->instance, pool_mem, pool_size);
-    if (pool == NULL) {
-        SDL_Log("Failed to add pool to instance\n");
-        munmap(mem, alloc_size);
-        SDL_UnlockMutex(tlsf_lock);
-        return;
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_free(void *ptr) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	sdl_tlsf_profile_forget(ptr);
+
+	// Any thread can use the per-CPU lists, owner or not
+	if (sdl_tlsf_cpu_cache_free(ptr)) {
+		return;
+	}
+
+	// Other threads swap active_instance in and out under the lock, it only says whose block this is while we hold it
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE);
+
+	// Another thread's instance, hand the block over and leave the TLSF work to the owner
+	if (sdl_tlsf_is_remote_free(active_instance)) {
+		sdl_tlsf_remote_free(active_instance, ptr);
+	} else {
+		sdl_tlsf_free_owned(ptr);
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_free_sized(void *ptr, size_t size) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	sdl_tlsf_profile_forget(ptr);
+
+	if (size <= SDL_TLSF_CPU_MAX_SIZE && sdl_tlsf_cpu_cache_free(ptr)) {
+		return;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE);
+
+	if (sdl_tlsf_is_remote_free(active_instance)) {
+		sdl_tlsf_remote_free(active_instance, ptr);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	// Tag heaps have thresholds of their own, the regular path finds which heap the block is in
+	if (active_instance -> tags != NULL) {
+		sdl_tlsf_free_owned(ptr);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	// Requests this big always got their own mapping, the header is found from the pointer alone
+	if (size >= active_instance -> huge_sized_min) {
+		tlsf_huge_block *huge = sdl_tlsf_huge_block_of(ptr);
+
+#ifndef NDEBUG
+		if (huge != sdl_tlsf_get_huge_block(active_instance, ptr)) {
+			SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "sdl_tlsf_free_sized: %zu bytes passed for a block that isn't huge\n", size);
+			sdl_tlsf_free_owned(ptr);
+
+			sdl_tlsf_lock_release(tlsf_lock);
+			return;
+		}
+		if (size > huge -> map_size - huge -> offset) {
+			SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "sdl_tlsf_free_sized: %zu bytes passed for a %zu byte huge block\n",
+							size, huge -> map_size - huge -> offset);
+		}
+#endif
+
+		sdl_tlsf_huge_free(active_instance, huge);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
+	if (pool == NULL) {
+		// Aligned requests can be huge below the threshold, the regular path sorts them out
+		sdl_tlsf_free_owned(ptr);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	// TLSF reads the header to coalesce right after, and a block can be bigger than the request when
+	// the tail wasn't split off, so the accounting keeps using the real size
+	size_t block_size = active_instance -> variant -> block_size(ptr);
+
+#ifndef NDEBUG
+	if (size > block_size) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "sdl_tlsf_free_sized: %zu bytes passed for a %zu byte block\n",
+						size, block_size);
+	}
+#endif
+
+	sdl_tlsf_free_block(pool, ptr, block_size);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+size_t sdl_tlsf_usable_size(void *ptr) {
+
+	if (ptr == NULL) {
+		return 0;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_USABLE_SIZE);
+
+	size_t usable = 0;
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
+
+	if (pool) {
+		usable = active_instance -> variant -> block_size(ptr);
+	} else {
+		tlsf_huge_block *huge = sdl_tlsf_get_huge_block(active_instance, ptr);
+		tlsf_instance *heap = huge ? NULL : sdl_tlsf_tag_owner(active_instance, ptr);
+
+		if (huge) {
+			usable = huge -> map_size - huge -> offset;
+		} else if (heap) {
+			tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+			usable = sdl_tlsf_usable_size(ptr);
+			sdl_tlsf_swap_out(previous);
+		}
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return usable;
+}
+
+static void *sdl_tlsf_calloc_unsampled(size_t nmemb, size_t size) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_CALLOC);
+
+	tlsf_instance *heap = sdl_tlsf_tag_route();
+	if (heap != NULL) {
+		tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+		void *ptr = sdl_tlsf_calloc_unsampled(nmemb, size);
+		sdl_tlsf_swap_out(previous);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return ptr;
+	}
+
+	sdl_tlsf_drain_remote_frees(active_instance);
+
+	size_t bytes = nmemb * size;
+
+	// Fresh mappings are already zeroed
+	if (bytes >= active_instance -> huge_threshold) {
+		void *ptr = sdl_tlsf_huge_alloc(active_instance, 0, bytes);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return ptr;
+	}
+
+	// Denied growth is counted in the budget stats, logging every one would flood a heap running at its limit
+	size_t denied = sdl_tlsf_budget_owner(active_instance) -> growth_denied;
+
+	// Check if we have enough memory to allocate
+	if (active_instance -> total_size - active_instance -> total_used < bytes) {
+
+		// Add another pool to the instance
+		sdl_tlsf_add_pool_for(bytes);
+	}
+
+	void *ptr = active_instance -> variant -> calloc(active_instance -> instance, size, nmemb);
+
+	if (!ptr) {
+
+		// Test if the problem is having a contiguous block of memory
+		sdl_tlsf_add_pool_for(bytes);
+		ptr = active_instance -> variant -> calloc(active_instance -> instance, size, nmemb);
+
+		if (!ptr) {
+			if (sdl_tlsf_budget_owner(active_instance) -> growth_denied == denied) {
+				SDL_Log("Failed to allocate memory\n");
+			}
+			sdl_tlsf_lock_release(tlsf_lock);
+			return NULL;
+		}
+	}
+
+	size_t block_size = active_instance -> variant -> block_size(ptr);
+
+	active_instance -> total_used += block_size;
+
+	// Update the pool list
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
+	if (pool == NULL) {
+		SDL_Log("Failed to Assign Pool\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
+	pool -> used += block_size;
+
+
+	sdl_tlsf_lock_release(tlsf_lock);
+
+	return ptr;
+}
+
+void *sdl_tlsf_calloc(size_t nmemb, size_t size) {
+
+	void *ptr = sdl_tlsf_calloc_unsampled(nmemb, size);
+
+	if (sdl_tlsf_profile_tick(nmemb * size)) {
+		sdl_tlsf_profile_sample(ptr, nmemb * size);
+	}
+	return ptr;
+}
+
+static void *sdl_tlsf_realloc_unsampled(void *ptr, size_t size) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_REALLOC);
+
+	// New blocks come from the current tag, existing ones are resized in whichever heap holds them
+	tlsf_instance *heap = ptr ? NULL : sdl_tlsf_tag_route();
+	if (ptr && active_instance -> tags && !sdl_tlsf_owns(active_instance, ptr)) {
+		heap = sdl_tlsf_tag_owner(active_instance, ptr);
+	}
+
+	if (heap != NULL) {
+		tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+		void *new_ptr = sdl_tlsf_realloc_unsampled(ptr, size);
+		sdl_tlsf_swap_out(previous);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return new_ptr;
+	}
+
+    // Blocks with their own mapping are resized by the kernel, no copy needed
+    tlsf_huge_block *huge = NULL;
+    if (ptr && sdl_tlsf_get_pool((size_t)ptr) == NULL) {
+        huge = sdl_tlsf_get_huge_block(active_instance, ptr);
     }
 
-	// Setup the metadata for the new pool
-    new_pool->mem = pool_mem;
-    new_pool->pool = pool;
-    new_pool->bytes = pool_size;
-    new_pool->used = 0;
+    if (huge) {
+        void *new_ptr = NULL;
+
+        if (size >= active_instance -> huge_threshold) {
+            new_ptr = sdl_tlsf_huge_realloc(active_instance, huge, size);
+        } else {
+            // Shrunk below the threshold, move it back into the pools
+            new_ptr = size ? sdl_tlsf_malloc_unsampled(size) : NULL;
+            if (new_ptr || size == 0) {
+                if (new_ptr) {
+                    memcpy(new_ptr, ptr, size);
+                }
+                sdl_tlsf_huge_free(active_instance, huge);
+            }
+        }
 
-	pool_id_counter++;
-    new_pool->pool_id = pool_id_counter;
+        sdl_tlsf_lock_release(tlsf_lock);
+        return new_ptr;
+    }
 
-	// Address Range
-    new_pool->start = pool_mem;
-    new_pool->end = (char *)pool_mem + pool_size;
+    // Get the current block size
+    size_t current_size = ptr ? active_instance -> variant -> block_size(ptr) : 0;
 
-    new_pool->next = NULL;  // This new pool is the new tail, so no next.
-    new_pool->prev = active_instance->tlsf_pools.tail;  // Link to the previous tail.
+    // Grown past the threshold, move it into its own mapping
+    if (size >= active_instance -> huge_threshold) {
+        void *new_ptr = sdl_tlsf_huge_alloc(active_instance, 0, size);
 
-    if (active_instance->tlsf_pools.tail) {
-        active_instance->tlsf_pools.tail->next = new_pool;  // Link the old tail to the new tail.
+        if (new_ptr && ptr) {
+            memcpy(new_ptr, ptr, current_size < size ? current_size : size);
+            sdl_tlsf_free(ptr);
+        }
+
+        sdl_tlsf_lock_release(tlsf_lock);
+        return new_ptr;
     }
 
-    active_instance->tlsf_pools.tail = new_pool;  // Update the tail to the new pool.
+    // Geometric growth policy, keep the slack on small shrinks and reserve extra on growth
+    if (ptr && active_instance -> realloc_growth) {
 
-    if (!active_instance->tlsf_pools.header) {
-        active_instance->tlsf_pools.header = new_pool;  // If there's no head, this is also the head (shouldn't happen unless the instance is reset somehow).
+        // Give back memory only once the block is less than half used
+        if (size <= current_size && size >= current_size / 2) {
+            sdl_tlsf_lock_release(tlsf_lock);
+            return ptr;
+        }
+
+        if (size > current_size) {
+            size_t target = current_size + current_size * active_instance -> realloc_growth / 100;
+            if (target < size) {
+                target = size;
+            }
+            if (target >= active_instance -> huge_threshold) {
+                target = size;
+            }
+
+            // Taking the slack in place skips the copy entirely
+            if (sdl_tlsf_try_expand(ptr, size, target)) {
+                sdl_tlsf_lock_release(tlsf_lock);
+                return ptr;
+            }
+
+            size = target;
+        }
     }
 
-    active_instance->num_pools++;
-    active_instance->total_size += alloc_size;
+    // Check if downsizing or upsizing
+    if (size > current_size) {
+        // Make sure we are not reallocating more memory than can fit in a pool
+        if (size >= (sdl_tlsf_max_pool_size(active_instance) - tlsf_pool_overhead())) {
+            SDL_Log("Requested realloc size is greater than pool size\n");
+            sdl_tlsf_lock_release(tlsf_lock);
+            return NULL;
+        }
 
-//    SDL_Log("Added new pool: %zu to instance", new_pool->pool_id);
+        // Check if we need more total memory than available
+        if (active_instance -> total_size - active_instance -> total_used < size - current_size) {
+            sdl_tlsf_add_pool_for(size);  // Add another pool to the instance
+        }
+    }
+
+    // Attempt to reallocate memory
+    void *new_ptr = active_instance -> variant -> realloc(active_instance -> instance, ptr, size);
+    if (!new_ptr && size > current_size) {
+        // If realloc fails and it's a size increase, try adding a pool and reallocating
+        sdl_tlsf_add_pool_for(size);
+        new_ptr = active_instance -> variant -> realloc(active_instance -> instance, ptr, size);
+    }
+
+    // If still fails, or it's a decrease and failed, return NULL
+    if (!new_ptr) {
+        SDL_Log("Failed to reallocate memory\n");
+        sdl_tlsf_lock_release(tlsf_lock);
+        return NULL;
+    }
+
+    // Adjust the used memory counters
+    if (new_ptr != ptr) {
+        // Successfully reallocated to a new block
+        tlsf_pool *old_pool = sdl_tlsf_get_pool((size_t)ptr);
+        tlsf_pool *new_pool = sdl_tlsf_get_pool((size_t)new_ptr);
+
+        size_t new_size = active_instance -> variant -> block_size(new_ptr);
+
+        // Update the old and new pool used memory
+        if (old_pool) old_pool -> used -= current_size;
+        if (new_pool) new_pool -> used += new_size;
+        active_instance -> total_used += new_size - current_size;
+
+        // Check if the old pool is empty and consider removing it
+        if (old_pool && old_pool -> used <= 0 && active_instance -> num_pools > 1) {
+            sdl_tlsf_free_pool(old_pool);
+        }
+    } else {
+        // Reallocated in place, adjust only the current pool's used memory
+        tlsf_pool *pool = sdl_tlsf_get_pool((size_t)new_ptr);
+        size_t new_size = active_instance -> variant -> block_size(new_ptr);
+        if (pool) {
+            pool->used += new_size - current_size;
+        }
+        active_instance -> total_used += new_size - current_size;
+    }
 
-    SDL_UnlockMutex(tlsf_lock);
+    sdl_tlsf_lock_release(tlsf_lock);
+    return new_ptr;
 }
 
-void sdl_tlsf_free_pool(tlsf_pool *pool) {
+void *sdl_tlsf_realloc(void *ptr, size_t size) {
 
-	SDL_LockMutex(tlsf_lock);
+	// A resized block is sampled like a new one, the old sample goes before the block can be reused
+	sdl_tlsf_profile_forget(ptr);
 
-	size_t id = pool -> pool_id;
+	resizing += ptr != NULL;
+	void *new_ptr = sdl_tlsf_realloc_unsampled(ptr, size);
+	resizing -= ptr != NULL;
 
-//	SDL_Log("Freeing Pool: %zu to Instance\n", id);
+	if (sdl_tlsf_profile_tick(size)) {
+		sdl_tlsf_profile_sample(new_ptr, size);
+	}
+	return new_ptr;
+}
 
-	// Removing the pool from the list
-	tlsf_pool *prev = pool -> prev;
-	tlsf_pool *next = pool -> next;
+// Charges a fresh pool block to its pool and the active instance
+static void sdl_tlsf_account_alloc(tlsf_pool *pool, void *ptr) {
 
-	// Update the prev and next's that are connected to the pool
-	if (prev) prev->next = next;
-	if (next) next->prev = prev;
+	size_t block_size = active_instance -> variant -> block_size(ptr);
 
-	// Update the header and tail if necessary
-	if (pool == active_instance -> tlsf_pools.header) {
-		active_instance -> tlsf_pools.header = next;
+	pool -> used += block_size;
+	active_instance -> total_used += block_size;
+}
+
+// Gives a pool block's space back to its pool and the active instance
+static void sdl_tlsf_account_free(tlsf_pool *pool, size_t block_size) {
+
+	pool -> used -= block_size;
+	active_instance -> total_used -= block_size;
+}
+
+static void *sdl_tlsf_aligned_alloc_unsampled(size_t align, size_t size) {
+
+	if (!sdl_tlsf_valid_align(align)) {
+		SDL_Log("Alignment %zu isn't a power of two\n", align);
+		return NULL;
 	}
 
-	if (pool == active_instance -> tlsf_pools.tail) {
-		active_instance -> tlsf_pools.tail = prev;
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_ALIGNED);
+
+	tlsf_instance *heap = sdl_tlsf_tag_route();
+	if (heap != NULL) {
+		tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+		void *ptr = sdl_tlsf_aligned_alloc_unsampled(align, size);
+		sdl_tlsf_swap_out(previous);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return ptr;
 	}
 
-	// Update Active Instance
-	active_instance -> num_pools -= 1;
-	active_instance -> total_size -= active_instance -> pool_size;
+	sdl_tlsf_drain_remote_frees(active_instance);
 
-	sdl_tlsf_free_pool_mem(pool);
+	// The pool path may need up to align extra bytes to trim a leading gap
+	if (size + align >= active_instance -> huge_threshold) {
+		void *ptr = sdl_tlsf_huge_alloc(active_instance, align, size);
 
-//	SDL_Log("Freed Pool: %zu to Instance\n", id);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return ptr;
+	}
 
+	// Check if we have enough memory to allocate
+	if (active_instance -> total_size - active_instance -> total_used < size + align) {
+		sdl_tlsf_add_pool_for(size + align);
+	}
+
+	void *ptr = active_instance -> variant -> memalign(active_instance -> instance, align, size);
+
+	if (!ptr) {
+
+		// Test if the problem is having a contiguous block of memory
+		sdl_tlsf_add_pool_for(size + align);
+		ptr = active_instance -> variant -> memalign(active_instance -> instance, align, size);
+
+		if (!ptr) {
+			SDL_Log("Failed to allocate aligned memory\n");
+			sdl_tlsf_lock_release(tlsf_lock);
+			return NULL;
+		}
+	}
+
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
+	if (pool == NULL) {
+		SDL_Log("Failed to Assign Pool\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
+	sdl_tlsf_account_alloc(pool, ptr);
 
-	SDL_UnlockMutex(tlsf_lock);
+	sdl_tlsf_lock_release(tlsf_lock);
+	return ptr;
 }
 
-void sdl_tlsf_free_pool_mem(tlsf_pool *pool) {
+void *sdl_tlsf_aligned_alloc(size_t align, size_t size) {
 
-	SDL_LockMutex(tlsf_lock);
+	void *ptr = sdl_tlsf_aligned_alloc_unsampled(align, size);
 
-	size_t pool_size = active_instance->pool_size;
-    size_t alloc_size = pool_size + sizeof(tlsf_pool) + tlsf_pool_overhead();
+	if (sdl_tlsf_profile_tick(size)) {
+		sdl_tlsf_profile_sample(ptr, size);
+	}
+	return ptr;
+}
 
-	// Free the pool
-	tlsf_remove_pool(active_instance -> instance, pool -> pool);
+static void *sdl_tlsf_aligned_realloc_unsampled(void *ptr, size_t align, size_t size) {
 
-	// Notify Valgrind that the pool is being freed
-	VALGRIND_FREELIKE_BLOCK(pool, 0);
+	if (!sdl_tlsf_valid_align(align)) {
+		SDL_Log("Alignment %zu isn't a power of two\n", align);
+		return NULL;
+	}
 
-	// Free the entire block of memory containing the pool
-	munmap(pool, alloc_size);
+	if (ptr == NULL) {
+		return sdl_tlsf_aligned_alloc_unsampled(align, size);
+	}
+
+	if (size == 0) {
+		sdl_tlsf_free(ptr);
+		return NULL;
+	}
 
-	SDL_UnlockMutex(tlsf_lock);
-}
\ No newline at end of file
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_ALIGNED);
+
+	if (active_instance -> tags && !sdl_tlsf_owns(active_instance, ptr)) {
+		tlsf_instance *heap = sdl_tlsf_tag_owner(active_instance, ptr);
+
+		if (heap != NULL) {
+			tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+			void *new_ptr = sdl_tlsf_aligned_realloc_unsampled(ptr, align, size);
+			sdl_tlsf_swap_out(previous);
+
+			sdl_tlsf_lock_release(tlsf_lock);
+			return new_ptr;
+		}
+	}
+
+	void *new_ptr = NULL;
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
+
+	// Huge blocks keep their payload offset across mremap, so stay aligned
+	if (pool == NULL) {
+		tlsf_huge_block *huge = sdl_tlsf_get_huge_block(active_instance, ptr);
+
+		if (huge == NULL) {
+			SDL_Log("Attempt to reallocate memory not owned by the instance\n");
+		} else if (size + align >= active_instance -> huge_threshold && sdl_tlsf_huge_keeps_align(huge, align)) {
+			new_ptr = sdl_tlsf_huge_realloc(active_instance, huge, size);
+		} else {
+			new_ptr = sdl_tlsf_aligned_alloc_unsampled(align, size);
+			if (new_ptr) {
+				memcpy(new_ptr, ptr, huge -> bytes < size ? huge -> bytes : size);
+				sdl_tlsf_huge_free(active_instance, huge);
+			}
+		}
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return new_ptr;
+	}
+
+	size_t current_size = active_instance -> variant -> block_size(ptr);
+
+	// Grown past the threshold, move it into its own mapping
+	if (size + align >= active_instance -> huge_threshold) {
+		new_ptr = sdl_tlsf_huge_alloc(active_instance, align, size);
+		if (new_ptr) {
+			memcpy(new_ptr, ptr, current_size < size ? current_size : size);
+			sdl_tlsf_free(ptr);
+		}
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return new_ptr;
+	}
+
+	if (size > current_size && active_instance -> total_size - active_instance -> total_used < size + align) {
+		sdl_tlsf_add_pool_for(size + align);
+	}
+
+	new_ptr = active_instance -> variant -> realloc_aligned(active_instance -> instance, ptr, align, size);
+	if (!new_ptr && size > current_size) {
+		sdl_tlsf_add_pool_for(size + align);
+		new_ptr = active_instance -> variant -> realloc_aligned(active_instance -> instance, ptr, align, size);
+	}
+
+	if (!new_ptr) {
+		SDL_Log("Failed to reallocate aligned memory\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
+
+	// The old block may have moved to another pool
+	tlsf_pool *new_pool = new_ptr == ptr ? pool : sdl_tlsf_get_pool((size_t)new_ptr);
+	sdl_tlsf_account_free(pool, current_size);
+	sdl_tlsf_account_alloc(new_pool, new_ptr);
+
+	if (pool != new_pool && pool -> used == 0 && active_instance -> num_pools > 1) {
+		sdl_tlsf_free_pool(pool);
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return new_ptr;
+}
+
+void *sdl_tlsf_aligned_realloc(void *ptr, size_t align, size_t size) {
+
+	sdl_tlsf_profile_forget(ptr);
+
+	resizing += ptr != NULL;
+	void *new_ptr = sdl_tlsf_aligned_realloc_unsampled(ptr, align, size);
+	resizing -= ptr != NULL;
+
+	if (sdl_tlsf_profile_tick(size)) {
+		sdl_tlsf_profile_sample(new_ptr, size);
+	}
+	return new_ptr;
+}
+
+void sdl_tlsf_set_owner(tlsf_instance *instance, Uint64 thread_id) {
+
+	__atomic_store_n(&instance -> owner, thread_id, __ATOMIC_RELAXED);
+
+	// Nobody is left to drain a queue without an owner
+	if (thread_id == 0) {
+		sdl_tlsf_drain_remote_frees(instance);
+	}
+}
+
+void sdl_tlsf_remote_free(tlsf_instance *instance, void *ptr) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	sdl_tlsf_profile_forget(ptr);
+
+	// Only pushes happen concurrently and the drain takes the whole list, so there is no ABA to worry about
+	void *head = __atomic_load_n(&instance -> remote_frees, __ATOMIC_RELAXED);
+	do {
+		*(void **)ptr = head;
+	} while (!__atomic_compare_exchange_n(&instance -> remote_frees, &head, ptr, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+size_t sdl_tlsf_drain_remote_frees(tlsf_instance *instance) {
+
+	// Checked without the lock, the common case is an empty queue
+	if (__atomic_load_n(&instance -> remote_frees, __ATOMIC_RELAXED) == NULL) {
+		return 0;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE);
+
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
+
+	void *block = __atomic_exchange_n(&instance -> remote_frees, NULL, __ATOMIC_ACQUIRE);
+	size_t count = 0;
+
+	while (block != NULL) {
+		void *next = *(void **)block;
+		sdl_tlsf_free_owned(block);
+		block = next;
+		count++;
+	}
+
+	instance -> remote_drained += count;
+	instance -> remote_batches++;
+
+	sdl_tlsf_swap_out(previous);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return count;
+}
+
+void sdl_tlsf_free_batch(tlsf_instance *instance, void **ptrs, size_t count) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE);
+
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
+
+	// One trip through the lock for the lot, and straight to TLSF since the caller already waited for them
+	for (size_t i = 0; i < count; i++) {
+		if (ptrs[i] != NULL) {
+			sdl_tlsf_profile_forget(ptrs[i]);
+			sdl_tlsf_free_owned(ptrs[i]);
+		}
+	}
+
+	sdl_tlsf_swap_out(previous);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_enable_cpu_cache(tlsf_instance *instance, size_t max_depth, int use_rseq) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	// A restore would bring back blocks the lists still hand out
+	if (instance -> persist) {
+		SDL_Log("Per-CPU caches aren't available on persistent instances\n");
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	if (instance -> cpu_cache == NULL) {
+		instance -> cpu_cache = sdl_tlsf_cpu_cache_create(max_depth, use_rseq);
+		if (instance -> cpu_cache == NULL) {
+			SDL_Log("Failed to map the per-CPU cache\n");
+		}
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_disable_cpu_cache(tlsf_instance *instance) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	tlsf_cpu_cache *cache = instance -> cpu_cache;
+	if (cache == NULL) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	// Detach first so the frees below go to TLSF
+	instance -> cpu_cache = NULL;
+
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
+
+	for (int cpu = 0; cpu < sdl_tlsf_cpu_cache_num_cpus(cache); cpu++) {
+		for (int size_class = 0; size_class < SDL_TLSF_CPU_CLASSES; size_class++) {
+
+			void *node = sdl_tlsf_cpu_cache_take(cache, cpu, size_class);
+			while (node != NULL) {
+				void *next = *(void **)node;
+				sdl_tlsf_free_owned(node);
+				node = next;
+			}
+		}
+	}
+
+	sdl_tlsf_swap_out(previous);
+	sdl_tlsf_cpu_cache_destroy(cache);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void *sdl_tlsf_instance_alloc(tlsf_instance *instance, size_t align, size_t bytes) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_MALLOC);
+
+	// The lock is recursive, so the instance can stand in as the active one for the call
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
+
+	void *ptr = align <= tlsf_align_size() ? sdl_tlsf_malloc(bytes) : sdl_tlsf_aligned_alloc(align, bytes);
+
+	sdl_tlsf_swap_out(previous);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return ptr;
+}
+
+void sdl_tlsf_instance_free(tlsf_instance *instance, void *ptr, size_t bytes) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE);
+
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
+
+	sdl_tlsf_free_sized(ptr, bytes);
+
+	sdl_tlsf_swap_out(previous);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+size_t sdl_tlsf_try_expand(void *ptr, size_t min_size, size_t max_size) {
+
+	if (ptr == NULL) {
+		return 0;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_REALLOC);
+
+	if (active_instance -> tags && !sdl_tlsf_owns(active_instance, ptr)) {
+		tlsf_instance *heap = sdl_tlsf_tag_owner(active_instance, ptr);
+
+		if (heap != NULL) {
+			tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+			size_t usable = sdl_tlsf_try_expand(ptr, min_size, max_size);
+			sdl_tlsf_swap_out(previous);
+
+			sdl_tlsf_lock_release(tlsf_lock);
+			return usable;
+		}
+	}
+
+	tlsf_pool *pool = sdl_tlsf_get_pool((size_t)ptr);
+
+	// Huge blocks can grow in place if the kernel finds room after the mapping
+	if (pool == NULL) {
+		tlsf_huge_block *huge = sdl_tlsf_get_huge_block(active_instance, ptr);
+		size_t usable = 0;
+
+		if (huge) {
+			size_t current = huge -> map_size - huge -> offset;
+			size_t wanted = max_size > min_size ? max_size : min_size;
+
+			if (min_size <= current) {
+				usable = current;
+			} else if (sdl_tlsf_huge_expand(active_instance, huge, wanted)
+						|| sdl_tlsf_huge_expand(active_instance, huge, min_size)) {
+				usable = huge -> map_size - huge -> offset;
+			}
+		}
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return usable;
+	}
+
+	size_t current_size = active_instance -> variant -> block_size(ptr);
+	size_t new_size = active_instance -> variant -> expand(active_instance -> instance, ptr, min_size, max_size);
+
+	if (new_size > current_size) {
+		pool -> used += new_size - current_size;
+		active_instance -> total_used += new_size - current_size;
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return new_size;
+}
+
+int sdl_tlsf_check_active_instance() {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	int ret_val = active_instance -> variant -> check(active_instance -> instance);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+
+	return ret_val;
+}
+
+int sdl_tlsf_check_pool(pool_t pool) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	int ret_val = active_instance -> variant -> check_pool(pool);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+
+	return ret_val;
+}
+
+// Loop through the pool list and check if the pointer is within the range of the pool
+tlsf_pool *sdl_tlsf_get_pool(size_t ptr_addr) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_GET_POOL);
+
+	// Frees tend to follow allocations from the same pool
+	tlsf_pool *last = active_instance -> last_pool;
+	if (last != NULL && ptr_addr >= (size_t)last -> start && ptr_addr <= (size_t)last -> end) {
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return last;
+	}
+
+	tlsf_pool_list poolList = active_instance  -> tlsf_pools;
+	tlsf_pool *pool = poolList.header;
+
+	while (pool != NULL) {
+		if (ptr_addr >= (size_t)pool -> start && ptr_addr <= (size_t)pool -> end) {
+
+			active_instance -> last_pool = pool;
+			sdl_tlsf_lock_release(tlsf_lock);
+			return pool;
+		}
+		pool = pool -> next;
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+
+	return NULL;
+
+
+}
+
+// Space a pool mapping needs besides the pool itself
+static size_t sdl_tlsf_pool_extra(void) {
+
+	return sdl_tlsf_header_size(sizeof(tlsf_pool)) + tlsf_pool_overhead();
+}
+
+// Size of the next pool under the instance's growth policy, always big enough for a request of bytes
+static size_t sdl_tlsf_next_pool_size(tlsf_instance *instance, size_t bytes) {
+
+	size_t pool_size = instance -> pool_size;
+
+	if (instance -> growth == SDL_TLSF_GROWTH_GEOMETRIC) {
+		pool_size = instance -> next_pool_size;
+	} else if (instance -> growth == SDL_TLSF_GROWTH_PREDICTIVE) {
+		pool_size = (size_t)(instance -> growth_rate * (double)SDL_TLSF_GROWTH_HORIZON_NS);
+	}
+
+	// Searches round a request up to the next list, a pool that only just holds it would never be picked
+	size_t needed = instance -> variant -> fit_size(bytes, 0) + tlsf_pool_overhead();
+	if (pool_size < needed) pool_size = needed;
+	if (pool_size < instance -> pool_size) pool_size = instance -> pool_size;
+	if (pool_size > sdl_tlsf_max_pool_size(instance)) pool_size = sdl_tlsf_max_pool_size(instance);
+
+	if (instance -> growth == SDL_TLSF_GROWTH_FIXED) {
+		return pool_size;
+	}
+
+	// Fill the mapping out to whole pages, keeping TLSF's alignment
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t extra = sdl_tlsf_pool_extra();
+	size_t alloc_size = (pool_size + extra + page_size - 1) & ~(page_size - 1);
+
+	pool_size = (alloc_size - extra) & ~(tlsf_align_size() - 1);
+	if (pool_size > sdl_tlsf_max_pool_size(instance)) {
+		pool_size = sdl_tlsf_max_pool_size(instance) & ~(tlsf_align_size() - 1);
+	}
+	return pool_size;
+}
+
+// Feeds a growth event into the policy's state
+static void sdl_tlsf_growth_update(tlsf_instance *instance, size_t pool_size) {
+
+	instance -> growth_events++;
+
+	size_t doubled = pool_size * 2;
+	instance -> next_pool_size = doubled < sdl_tlsf_max_pool_size(instance) ? doubled : sdl_tlsf_max_pool_size(instance);
+
+	// Net bytes per nanosecond since the last pool, averaged with the previous estimate
+	Uint64 now = SDL_GetTicksNS();
+	if (instance -> last_growth_ns != 0 && now > instance -> last_growth_ns) {
+		size_t grown = instance -> total_used > instance -> used_at_growth ? instance -> total_used - instance -> used_at_growth : 0;
+		double rate = (double)grown / (double)(now - instance -> last_growth_ns);
+
+		instance -> growth_rate = instance -> growth_rate > 0 ? (instance -> growth_rate + rate) / 2 : rate;
+	}
+
+	instance -> last_growth_ns = now;
+	instance -> used_at_growth = instance -> total_used;
+}
+
+void sdl_tlsf_add_pool() {
+
+	sdl_tlsf_add_pool_for(0);
+}
+
+static void sdl_tlsf_add_pool_for(size_t bytes) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_ADD_POOL);
+
+    size_t pool_size = sdl_tlsf_next_pool_size(active_instance, bytes);
+    size_t alloc_size = pool_size + sdl_tlsf_pool_extra();
+
+    if (!sdl_tlsf_budget_allow(active_instance, alloc_size)) {
+        sdl_tlsf_lock_release(tlsf_lock);
+        return;
+    }
+
+    // Persistent instances grow inside their reserved region so the pool ends up in the snapshot
+    // A depot region up to twice the size is worth taking over a fresh mapping, the pool grows to fill it
+    void *mem;
+    if (active_instance -> persist) {
+        mem = sdl_tlsf_persist_extend(active_instance -> persist, active_instance -> snapshot_fd, alloc_size);
+    } else {
+        size_t max_alloc_size = active_instance -> growth == SDL_TLSF_GROWTH_FIXED ? alloc_size : alloc_size * 2;
+        if (max_alloc_size - sdl_tlsf_pool_extra() > sdl_tlsf_max_pool_size(active_instance)) {
+            max_alloc_size = sdl_tlsf_max_pool_size(active_instance) + sdl_tlsf_pool_extra();
+        }
+
+        // The budget only allowed alloc_size, a larger depot region has to fit under the hard limit too
+        size_t headroom = sdl_tlsf_budget_headroom(active_instance);
+        if (max_alloc_size > headroom) {
+            max_alloc_size = headroom > alloc_size ? headroom : alloc_size;
+        }
+
+        mem = sdl_tlsf_depot_take(alloc_size, max_alloc_size, &alloc_size);
+        pool_size = (alloc_size - sdl_tlsf_pool_extra()) & ~(tlsf_align_size() - 1);
+    }
+    if (mem == MAP_FAILED) {
+        SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to create memory for new pool\n");
+        sdl_tlsf_lock_release(tlsf_lock);
+        return;
+    }
+
+    VALGRIND_MALLOCLIKE_BLOCK(mem, alloc_size, 0, 0);
+
+    tlsf_pool *new_pool = (tlsf_pool *)mem;
+    void *pool_mem = (char *)mem + sdl_tlsf_header_size(sizeof(tlsf_pool));
+
+    pool_t pool = active_instance -> variant -> add_pool(active_instance -> instance, pool_mem, pool_size);
+    if (pool == NULL) {
+        SDL_Log("Failed to add pool to instance\n");
+        sdl_tlsf_depot_donate(mem, alloc_size);
+        sdl_tlsf_lock_release(tlsf_lock);
+        return;
+    }
+
+	// Setup the metadata for the new pool
+    new_pool->mem = pool_mem;
+    new_pool->pool = pool;
+    new_pool->bytes = pool_size;
+    new_pool->used = 0;
+
+	pool_id_counter++;
+    new_pool->pool_id = pool_id_counter;
+
+	// Address Range
+    new_pool->start = pool_mem;
+    new_pool->end = (char *)pool_mem + pool_size;
+
+    new_pool->next = NULL;  // This new pool is the new tail, so no next.
+    new_pool->prev = active_instance->tlsf_pools.tail;  // Link to the previous tail.
+
+    if (active_instance->tlsf_pools.tail) {
+        active_instance->tlsf_pools.tail->next = new_pool;  // Link the old tail to the new tail.
+    }
+
+    active_instance->tlsf_pools.tail = new_pool;  // Update the tail to the new pool.
+
+    if (!active_instance->tlsf_pools.header) {
+        active_instance->tlsf_pools.header = new_pool;  // If there's no head, this is also the head (shouldn't happen unless the instance is reset somehow).
+    }
+
+    active_instance->num_pools++;
+    active_instance->total_size += alloc_size;
+    sdl_tlsf_budget_grew(active_instance);
+    sdl_tlsf_growth_update(active_instance, pool_size);
+
+//    SDL_Log("Added new pool: %zu to instance", new_pool->pool_id);
+
+    sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_free_pool(tlsf_pool *pool) {
+
+	// Taken before looking at active_instance, other threads swap it while they hold the lock
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE_POOL);
+
+	// Pools of a persistent instance are part of its region, they stay for the next allocation
+	if (active_instance -> persist) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	// The first pool shares the instance's mapping, it can't be unmapped or handed to the depot on its own
+	if ((char *)pool == (char *)active_instance + sdl_tlsf_header_size(sizeof(tlsf_instance))) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return;
+	}
+
+	size_t id = pool -> pool_id;
+
+//	SDL_Log("Freeing Pool: %zu to Instance\n", id);
+
+	// Removing the pool from the list
+	tlsf_pool *prev = pool -> prev;
+	tlsf_pool *next = pool -> next;
+
+	// Update the prev and next's that are connected to the pool
+	if (prev) prev->next = next;
+	if (next) next->prev = prev;
+
+	// Update the header and tail if necessary
+	if (pool == active_instance -> tlsf_pools.header) {
+		active_instance -> tlsf_pools.header = next;
+	}
+
+	if (pool == active_instance -> tlsf_pools.tail) {
+		active_instance -> tlsf_pools.tail = prev;
+	}
+
+	if (pool == active_instance -> last_pool) {
+		active_instance -> last_pool = NULL;
+	}
+
+	// Update Active Instance
+	active_instance -> num_pools -= 1;
+	active_instance -> total_size -= pool -> bytes + sdl_tlsf_pool_extra();
+
+	// Demand is falling, the next pool doesn't need to be as big
+	size_t halved = active_instance -> next_pool_size / 2;
+	active_instance -> next_pool_size = halved > active_instance -> pool_size ? halved : active_instance -> pool_size;
+	active_instance -> growth_rate /= 2;
+
+	sdl_tlsf_free_pool_mem(pool);
+
+//	SDL_Log("Freed Pool: %zu to Instance\n", id);
+
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_free_pool_mem(tlsf_pool *pool) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_FREE_POOL);
+
+	// Pools can differ in size, each one knows its own
+    size_t alloc_size = pool -> bytes + sdl_tlsf_pool_extra();
+
+	// Free the pool
+	active_instance -> variant -> remove_pool(active_instance -> instance, pool -> pool);
+
+	// Notify Valgrind that the pool is being freed
+	VALGRIND_FREELIKE_BLOCK(pool, 0);
+
+	// Free the entire block of memory containing the pool, or keep it around for the next instance that grows
+	sdl_tlsf_depot_donate(pool, alloc_size);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+// Tag heaps grow against the budget of the instance they belong to
+static tlsf_instance *sdl_tlsf_budget_owner(tlsf_instance *instance) {
+
+	return instance -> parent ? instance -> parent : instance;
+}
+
+// Pools and huge blocks, the instance's tag heaps included, what the budget limits are held against
+static size_t sdl_tlsf_footprint(tlsf_instance *instance) {
+
+	size_t footprint = instance -> total_size + instance -> huge_bytes;
+
+	for (tlsf_instance *tag = instance -> tags; tag != NULL; tag = tag -> next_tag) {
+		footprint += tag -> total_size + tag -> huge_bytes;
+	}
+
+	return footprint;
+}
+
+static void sdl_tlsf_run_pressure(tlsf_instance *instance, tlsf_pressure_level level, size_t needed) {
+
+	instance -> in_pressure = 1;
+
+	// The callbacks free through the active instance
+	tlsf_instance *previous = sdl_tlsf_swap_in(instance);
+
+	for (int i = 0; i < instance -> num_pressure; i++) {
+		instance -> pressure[i].callback(instance, level, needed, instance -> pressure[i].userdata);
+	}
+
+	sdl_tlsf_swap_out(previous);
+	instance -> in_pressure = 0;
+}
+
+// Whether the instance may map bytes more, calling the pressure callbacks on the way
+// Bytes the instance can still grow by before the hard limit, SIZE_MAX without one
+static size_t sdl_tlsf_budget_headroom(tlsf_instance *instance) {
+
+	instance = sdl_tlsf_budget_owner(instance);
+	size_t footprint = sdl_tlsf_footprint(instance);
+
+	if (instance -> hard_limit == 0) {
+		return SIZE_MAX;
+	}
+	return footprint < instance -> hard_limit ? instance -> hard_limit - footprint : 0;
+}
+
+static int sdl_tlsf_budget_allow(tlsf_instance *instance, size_t bytes) {
+
+	instance = sdl_tlsf_budget_owner(instance);
+	size_t footprint = sdl_tlsf_footprint(instance);
+
+	if (instance -> hard_limit && footprint + bytes > instance -> hard_limit) {
+
+		// Emptied pools go back as the callbacks free, that may be enough
+		if (!instance -> in_pressure && !resizing) {
+			instance -> hard_events++;
+			sdl_tlsf_run_pressure(instance, SDL_TLSF_PRESSURE_HARD, footprint + bytes - instance -> hard_limit);
+			footprint = sdl_tlsf_footprint(instance);
+
+			if (footprint + bytes <= instance -> hard_limit) {
+				instance -> hard_recovered++;
+			}
+		}
+
+		if (footprint + bytes > instance -> hard_limit) {
+			instance -> growth_denied++;
+			return 0;
+		}
+	}
+
+	if (instance -> soft_limit && footprint + bytes > instance -> soft_limit) {
+		// Left unsignalled during a realloc, the next growth gets to run them
+		if (!instance -> soft_signalled && !instance -> in_pressure && !resizing) {
+			instance -> soft_signalled = 1;
+			instance -> soft_events++;
+			sdl_tlsf_run_pressure(instance, SDL_TLSF_PRESSURE_SOFT, footprint + bytes - instance -> soft_limit);
+		}
+	} else {
+		instance -> soft_signalled = 0;
+	}
+
+	return 1;
+}
+
+static void sdl_tlsf_budget_grew(tlsf_instance *instance) {
+
+	instance = sdl_tlsf_budget_owner(instance);
+	size_t footprint = sdl_tlsf_footprint(instance);
+	if (footprint > instance -> peak_footprint) {
+		instance -> peak_footprint = footprint;
+	}
+}
+
+void sdl_tlsf_set_budget(tlsf_instance *instance, size_t soft_limit, size_t hard_limit) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	instance -> soft_limit = soft_limit;
+	instance -> hard_limit = hard_limit;
+	instance -> soft_signalled = 0;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+int sdl_tlsf_add_pressure_callback(tlsf_instance *instance, tlsf_pressure_callback callback, void *userdata) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	if (instance -> num_pressure == SDL_TLSF_MAX_PRESSURE_CALLBACKS) {
+		SDL_Log("Instance already has %d pressure callbacks\n", SDL_TLSF_MAX_PRESSURE_CALLBACKS);
+
+		sdl_tlsf_lock_release(tlsf_lock);
+		return -1;
+	}
+
+	instance -> pressure[instance -> num_pressure].callback = callback;
+	instance -> pressure[instance -> num_pressure].userdata = userdata;
+	instance -> num_pressure++;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return 0;
+}
+
+void sdl_tlsf_remove_pressure_callback(tlsf_instance *instance, tlsf_pressure_callback callback, void *userdata) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	for (int i = 0; i < instance -> num_pressure; i++) {
+		if (instance -> pressure[i].callback == callback && instance -> pressure[i].userdata == userdata) {
+			instance -> pressure[i] = instance -> pressure[--instance -> num_pressure];
+			break;
+		}
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+// Bytes handed out from one heap's pools and huge blocks
+static size_t sdl_tlsf_heap_used(tlsf_instance *heap) {
+
+	size_t used = heap -> total_used;
+
+	for (tlsf_huge_block *huge = heap -> huge_blocks; huge != NULL; huge = huge -> next) {
+		used += huge -> bytes;
+	}
+
+	return used;
+}
+
+void sdl_tlsf_get_budget(tlsf_instance *instance, tlsf_budget_stats *stats) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	// The tag heaps' blocks are the instance's too
+	size_t used = sdl_tlsf_heap_used(instance);
+	for (tlsf_instance *tag = instance -> tags; tag != NULL; tag = tag -> next_tag) {
+		used += sdl_tlsf_heap_used(tag);
+	}
+
+	stats -> footprint = sdl_tlsf_footprint(instance);
+	stats -> peak_footprint = instance -> peak_footprint;
+	stats -> used = used;
+	stats -> soft_limit = instance -> soft_limit;
+	stats -> hard_limit = instance -> hard_limit;
+	stats -> soft_events = instance -> soft_events;
+	stats -> hard_events = instance -> hard_events;
+	stats -> hard_recovered = instance -> hard_recovered;
+	stats -> growth_denied = instance -> growth_denied;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+// A pool mapping between min_bytes and max_bytes, the smallest fit from the depot if it has one
+// *bytes is set to the size actually handed out
+static void *sdl_tlsf_depot_take(size_t min_bytes, size_t max_bytes, size_t *bytes) {
+
+	tlsf_depot_region **best = NULL;
+
+	for (tlsf_depot_region **link = &pool_depot; *link != NULL; link = &(*link) -> next) {
+		size_t region_bytes = (*link) -> bytes;
+
+		if (region_bytes >= min_bytes && region_bytes <= max_bytes && (best == NULL || region_bytes < (*best) -> bytes)) {
+			best = link;
+		}
+	}
+
+	if (best != NULL) {
+		tlsf_depot_region *region = *best;
+		*best = region -> next;
+
+		depot_stats.regions--;
+		depot_stats.bytes -= region -> bytes;
+		depot_stats.hits++;
+
+		*bytes = region -> bytes;
+		return region;
+	}
+
+	depot_stats.misses++;
+	depot_stats.mmaps++;
+
+	*bytes = min_bytes;
+	return mmap(NULL, min_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+// Keeps an empty pool mapping for later, or unmaps it when the depot is full
+static void sdl_tlsf_depot_donate(void *mem, size_t bytes) {
+
+	if (depot_stats.bytes + bytes > depot_max_bytes) {
+		depot_stats.rejected++;
+		depot_stats.munmaps++;
+		munmap(mem, bytes);
+		return;
+	}
+
+	// The first page holds the region header, everything after it can go
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	if (depot_advice != SDL_TLSF_DEPOT_KEEP && bytes > page_size) {
+		madvise((char *)mem + page_size, bytes - page_size, depot_advice == SDL_TLSF_DEPOT_FREE ? MADV_FREE : MADV_DONTNEED);
+		depot_stats.madvises++;
+	}
+
+	tlsf_depot_region *region = mem;
+	region -> bytes = bytes;
+	region -> next = pool_depot;
+	pool_depot = region;
+
+	depot_stats.regions++;
+	depot_stats.bytes += bytes;
+	depot_stats.donated++;
+}
+
+void sdl_tlsf_depot_configure(size_t max_bytes, tlsf_depot_advice advice) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_DEPOT);
+
+	depot_max_bytes = max_bytes;
+	depot_advice = advice;
+
+	sdl_tlsf_depot_trim(max_bytes);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_depot_trim(size_t keep_bytes) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_DEPOT);
+
+	while (pool_depot != NULL && depot_stats.bytes > keep_bytes) {
+		tlsf_depot_region *region = pool_depot;
+		pool_depot = region -> next;
+
+		depot_stats.regions--;
+		depot_stats.bytes -= region -> bytes;
+		depot_stats.munmaps++;
+		munmap(region, region -> bytes);
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_get_lock_stats(tlsf_lock_stats *stats) {
+
+	// Copied under the lock so no site is halfway through an update, this acquisition isn't in the copy yet
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+	sdl_tlsf_lock_copy_stats(stats);
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_reset_lock_stats(void) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+	sdl_tlsf_lock_clear_stats();
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_depot_get_stats(tlsf_depot_stats *stats) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_DEPOT);
+
+	*stats = depot_stats;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+// Size of the mapping backing a huge block, rounded to whole pages
+static size_t sdl_tlsf_huge_map_size(size_t offset, size_t bytes) {
+
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t map_size = bytes + offset;
+
+	return (map_size + page_size - 1) & ~(page_size - 1);
+}
+
+void *sdl_tlsf_huge_alloc(tlsf_instance *instance, size_t align, size_t bytes) {
+
+	if (align != 0 && !sdl_tlsf_valid_align(align)) {
+		SDL_Log("Huge block alignment %zu isn't a power of two\n", align);
+		return NULL;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_HUGE);
+
+	// Mappings are page aligned, up to a page pushing the payload to the alignment is enough
+	// Past that the payload starts a page into the mapping and the mapping itself is aligned below
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t offset = align > SDL_TLSF_HUGE_HEADER_SIZE ? align : SDL_TLSF_HUGE_HEADER_SIZE;
+	if (align > page_size) {
+		offset = page_size;
+	}
+	size_t map_size = sdl_tlsf_huge_map_size(offset, bytes);
+
+	if (!sdl_tlsf_budget_allow(instance, map_size)) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
+
+	// Over map by the alignment and trim what's on either side of an aligned window
+	size_t slack = align > page_size ? align : 0;
+	char *raw = mmap(NULL, map_size + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to create memory for huge block\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
+
+	char *mem = raw;
+	if (slack) {
+		uintptr_t payload = ((uintptr_t)raw + offset + align - 1) & ~(uintptr_t)(align - 1);
+		mem = (char *)(payload - offset);
+
+		if (mem > raw) {
+			munmap(raw, (size_t)(mem - raw));
+		}
+		if (raw + map_size + slack > mem + map_size) {
+			munmap(mem + map_size, (size_t)(raw + map_size + slack - (mem + map_size)));
+		}
+	}
+
+	VALGRIND_MALLOCLIKE_BLOCK(mem, map_size, 0, 0);
+
+	tlsf_huge_block *block = (tlsf_huge_block *)mem;
+	block -> bytes = bytes;
+	block -> map_size = map_size;
+	block -> offset = offset;
+	block -> align = align;
+
+	// Push onto the front of the instance's list
+	block -> prev = NULL;
+	block -> next = instance -> huge_blocks;
+	if (block -> next) {
+		block -> next -> prev = block;
+	}
+	instance -> huge_blocks = block;
+
+	instance -> num_huge++;
+	instance -> huge_bytes += map_size;
+	sdl_tlsf_budget_grew(instance);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return (char *)mem + offset;
+}
+
+void *sdl_tlsf_huge_realloc(tlsf_instance *instance, tlsf_huge_block *block, size_t bytes) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_HUGE);
+
+	size_t old_map_size = block -> map_size;
+	size_t map_size = sdl_tlsf_huge_map_size(block -> offset, bytes);
+
+	if (map_size > old_map_size && !sdl_tlsf_budget_allow(instance, map_size - old_map_size)) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return NULL;
+	}
+
+	// Let the kernel move the pages instead of copying them
+	tlsf_huge_block *moved = block;
+	if (map_size != old_map_size) {
+
+		// A moved mapping is only page aligned, larger alignments have to grow in place or into a fresh block
+		int flags = block -> align > (size_t)sysconf(_SC_PAGESIZE) ? 0 : MREMAP_MAYMOVE;
+
+		moved = mremap(block, old_map_size, map_size, flags);
+		if (moved == MAP_FAILED && flags == 0) {
+			void *new_ptr = sdl_tlsf_huge_alloc(instance, block -> align, bytes);
+			if (new_ptr) {
+				memcpy(new_ptr, (char *)block + block -> offset, block -> bytes < bytes ? block -> bytes : bytes);
+				sdl_tlsf_huge_free(instance, block);
+			}
+
+			sdl_tlsf_lock_release(tlsf_lock);
+			return new_ptr;
+		}
+		if (moved == MAP_FAILED) {
+			SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to remap huge block\n");
+			sdl_tlsf_lock_release(tlsf_lock);
+			return NULL;
+		}
+
+		VALGRIND_FREELIKE_BLOCK(block, 0);
+		VALGRIND_MALLOCLIKE_BLOCK(moved, map_size, 0, 0);
+	}
+
+	// The header moved along with the mapping, fix up the neighbours
+	if (moved -> prev) {
+		moved -> prev -> next = moved;
+	} else {
+		instance -> huge_blocks = moved;
+	}
+	if (moved -> next) {
+		moved -> next -> prev = moved;
+	}
+
+	moved -> bytes = bytes;
+	moved -> map_size = map_size;
+	instance -> huge_bytes = instance -> huge_bytes - old_map_size + map_size;
+	sdl_tlsf_budget_grew(instance);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return (char *)moved + moved -> offset;
+}
+
+int sdl_tlsf_huge_expand(tlsf_instance *instance, tlsf_huge_block *block, size_t bytes) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_HUGE);
+
+	size_t old_map_size = block -> map_size;
+	size_t map_size = sdl_tlsf_huge_map_size(block -> offset, bytes);
+
+	if (map_size > old_map_size && !sdl_tlsf_budget_allow(instance, map_size - old_map_size)) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return 0;
+	}
+
+	// Without MREMAP_MAYMOVE this fails instead of moving the block
+	if (map_size > old_map_size && mremap(block, old_map_size, map_size, 0) == MAP_FAILED) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return 0;
+	}
+
+	if (map_size > old_map_size) {
+		VALGRIND_RESIZEINPLACE_BLOCK(block, old_map_size, map_size, 0);
+
+		block -> map_size = map_size;
+		instance -> huge_bytes += map_size - old_map_size;
+		sdl_tlsf_budget_grew(instance);
+	}
+
+	if (bytes > block -> bytes) {
+		block -> bytes = bytes;
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return 1;
+}
+
+void sdl_tlsf_huge_free(tlsf_instance *instance, tlsf_huge_block *block) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_HUGE);
+
+	if (block -> prev) {
+		block -> prev -> next = block -> next;
+	} else {
+		instance -> huge_blocks = block -> next;
+	}
+	if (block -> next) {
+		block -> next -> prev = block -> prev;
+	}
+
+	instance -> num_huge--;
+	instance -> huge_bytes -= block -> map_size;
+
+	VALGRIND_FREELIKE_BLOCK(block, 0);
+	munmap(block, block -> map_size);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+tlsf_huge_block *sdl_tlsf_get_huge_block(tlsf_instance *instance, void *ptr) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_HUGE);
+
+	tlsf_huge_block *block = instance -> huge_blocks;
+
+	while (block != NULL) {
+		if ((char *)block + block -> offset == (char *)ptr) {
+			break;
+		}
+		block = block -> next;
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return block;
+}
+
+void sdl_tlsf_compact() {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_INSTANCE);
+
+	active_instance -> variant -> compact(active_instance -> instance);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+// ###### ALLOCATION TAGS ######
+
+// Heap new allocations on this thread go to, NULL when that's the active instance anyway
+static tlsf_instance *sdl_tlsf_tag_route(void) {
+
+	if (tag_depth == 0) {
+		return NULL;
+	}
+
+	tlsf_instance *heap = tag_stack[tag_depth - 1];
+	tlsf_instance *instance = sdl_tlsf_current();
+
+	// Tag 0 allocates from the instance, and a tag heap swapped in has been routed to already
+	if (heap -> tag == 0 || instance -> parent != NULL) {
+		return NULL;
+	}
+	if (heap -> parent == instance) {
+		return heap;
+	}
+
+	// Pushed while another instance was active, the tag follows the thread to the one it allocates from now
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_TAG);
+
+	heap = sdl_tlsf_find_tag(instance, heap -> tag);
+	if (heap == NULL && instance -> persist == NULL) {
+		heap = sdl_tlsf_create_tag(instance, tag_stack[tag_depth - 1] -> tag);
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return heap;
+}
+
+// Whether ptr lies in one of the instance's pools or huge blocks
+static int sdl_tlsf_owns(tlsf_instance *instance, void *ptr) {
+
+	for (tlsf_pool *pool = instance -> tlsf_pools.header; pool != NULL; pool = pool -> next) {
+		if ((char *)ptr >= (char *)pool -> start && (char *)ptr < (char *)pool -> end) {
+			return 1;
+		}
+	}
+
+	return sdl_tlsf_get_huge_block(instance, ptr) != NULL;
+}
+
+// Tag heap of the instance holding ptr, NULL if none does
+static tlsf_instance *sdl_tlsf_tag_owner(tlsf_instance *instance, void *ptr) {
+
+	for (tlsf_instance *heap = instance -> tags; heap != NULL; heap = heap -> next_tag) {
+		if (sdl_tlsf_owns(heap, ptr)) {
+			return heap;
+		}
+	}
+	return NULL;
+}
+
+static tlsf_instance *sdl_tlsf_find_tag(tlsf_instance *instance, Uint32 tag) {
+
+	tlsf_instance *heap = instance -> tags;
+	while (heap != NULL && heap -> tag != tag) {
+		heap = heap -> next_tag;
+	}
+	return heap;
+}
+
+// A tag heap starts small on the instance's variant and doubles up to the instance's largest pool
+static tlsf_instance *sdl_tlsf_create_tag(tlsf_instance *instance, Uint32 tag) {
+
+	size_t pool_size = instance -> pool_size < SDL_TLSF_TAG_POOL_SIZE ? instance -> pool_size : SDL_TLSF_TAG_POOL_SIZE;
+
+	// The first pool is charged to the instance like any other, the allocations stay in the instance if it's refused
+	if (!sdl_tlsf_budget_allow(instance, sdl_tlsf_instance_size(pool_size))) {
+		return NULL;
+	}
+
+	tlsf_instance *heap = sdl_tlsf_create_instance_with_variant(pool_size, instance -> variant);
+	if (heap == NULL) {
+		return NULL;
+	}
+
+	// Tags grow up to the instance's largest pool, within what the variant can address
+	size_t max_pool_size = sdl_tlsf_max_pool_size(instance);
+	if (max_pool_size > sdl_tlsf_variant_max_pool_size(instance -> variant)) {
+		max_pool_size = sdl_tlsf_variant_max_pool_size(instance -> variant);
+	}
+	if (sdl_tlsf_set_growth_policy(heap, SDL_TLSF_GROWTH_GEOMETRIC, max_pool_size) != 0) {
+		sdl_tlsf_destroy_instance(heap);
+		return NULL;
+	}
+	sdl_tlsf_set_huge_threshold(heap, instance -> huge_threshold);
+
+	heap -> tag = tag;
+	heap -> parent = instance;
+	heap -> next_tag = instance -> tags;
+	instance -> tags = heap;
+	sdl_tlsf_budget_grew(instance);
+
+	return heap;
+}
+
+void sdl_tlsf_push_tag(Uint32 tag) {
+
+	if (tag_depth == SDL_TLSF_MAX_TAG_DEPTH) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Tag stack is full, allocations stay in tag %u\n", sdl_tlsf_current_tag());
+		tag_overflow++;
+		return;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_TAG);
+
+	// Tags always belong to a regular instance, even when pushed from inside another tag
+	tlsf_instance *instance = active_instance -> parent ? active_instance -> parent : active_instance;
+	tlsf_instance *heap = tag ? sdl_tlsf_find_tag(instance, tag) : instance;
+
+	if (heap == NULL) {
+		// Tag heaps would be separate mappings that don't make it into a snapshot
+		if (instance -> persist) {
+			SDL_Log("Persistent instances can't have tags, tag %u allocates from the instance\n", tag);
+		} else {
+			heap = sdl_tlsf_create_tag(instance, tag);
+		}
+
+		// Still pushed so the pops line up
+		if (heap == NULL) {
+			heap = instance;
+		}
+	}
+
+	tag_stack[tag_depth++] = heap;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void sdl_tlsf_pop_tag(void) {
+
+	if (tag_overflow > 0) {
+		tag_overflow--;
+		return;
+	}
+
+	if (tag_depth == 0) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "sdl_tlsf_pop_tag without a matching push\n");
+		return;
+	}
+
+	tag_depth--;
+}
+
+Uint32 sdl_tlsf_current_tag(void) {
+
+	return tag_depth ? tag_stack[tag_depth - 1] -> tag : 0;
+}
+
+size_t sdl_tlsf_release_tag(tlsf_instance *instance, Uint32 tag) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_TAG);
+
+	tlsf_instance *heap = sdl_tlsf_find_tag(instance, tag);
+	if (heap == NULL) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return 0;
+	}
+
+	// Only this thread's stack can be checked, the others are up to the caller
+	for (int i = 0; i < tag_depth; i++) {
+		if (tag_stack[i] == heap) {
+			SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Tag %u is still pushed, not releasing it\n", tag);
+
+			sdl_tlsf_lock_release(tlsf_lock);
+			return 0;
+		}
+	}
+
+	// Pools go to the depot and huge blocks are unmapped, the blocks in them are never looked at
+	size_t mappings = heap -> num_pools + heap -> num_huge;
+	sdl_tlsf_destroy_instance(heap);
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return mappings;
+}
+
+size_t sdl_tlsf_tag_used(tlsf_instance *instance, Uint32 tag) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_TAG);
+
+	tlsf_instance *heap = sdl_tlsf_find_tag(instance, tag);
+	size_t used = heap ? heap -> total_used + heap -> huge_bytes : 0;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return used;
+}
+
+// ###### HEAP PROFILING ######
+
+// A sampled block is charged to the heap it actually came from, the instance or one of its tags
+static void sdl_tlsf_profile_sample(void *ptr, size_t bytes) {
+
+	// Stopped, every thread still comes through here once per idle stretch and shouldn't queue on the lock for it
+	if (sdl_tlsf_profile_sampling() == 0) {
+		return;
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PROFILE);
+
+	tlsf_instance *heap = active_instance;
+	if (ptr != NULL && heap -> tags != NULL && !sdl_tlsf_owns(heap, ptr)) {
+		tlsf_instance *tag = sdl_tlsf_tag_owner(heap, ptr);
+		if (tag != NULL) {
+			heap = tag;
+		}
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+
+	sdl_tlsf_profile_record(heap, ptr, bytes);
+}
+
+// ###### LIFETIME HINTS ######
+
+void *sdl_tlsf_malloc_hint(size_t bytes, tlsf_lifetime lifetime) {
+
+	if (lifetime != SDL_TLSF_LIFETIME_TRANSIENT) {
+		return sdl_tlsf_malloc(bytes);
+	}
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_MALLOC);
+
+	tlsf_instance *instance = active_instance -> parent ? active_instance -> parent : active_instance;
+	tlsf_instance *heap = sdl_tlsf_find_tag(instance, SDL_TLSF_TAG_TRANSIENT);
+
+	if (heap == NULL && instance -> persist == NULL) {
+		heap = sdl_tlsf_create_tag(instance, SDL_TLSF_TAG_TRANSIENT);
+	}
+
+	// Straight to the transient heap, whatever tag is pushed
+	void *ptr;
+	if (heap != NULL) {
+		tlsf_instance *previous = sdl_tlsf_swap_in(heap);
+		ptr = sdl_tlsf_malloc_uncached(bytes);
+		sdl_tlsf_swap_out(previous);
+
+		if (sdl_tlsf_profile_tick(bytes)) {
+			sdl_tlsf_profile_sample(ptr, bytes);
+		}
+	} else {
+		ptr = sdl_tlsf_malloc(bytes);
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return ptr;
+}
+
+// ###### SHARED INSTANCES ######
+
+// Returns -1 without the lock once a process has died in the middle of changing the heap
+static int sdl_tlsf_shared_lock(tlsf_shared_instance *shared) {
+
+	int result = pthread_mutex_lock(&shared -> header -> lock);
+
+	// The previous owner died holding the lock, the heap is only usable if it didn't die inside tlsf itself
+	if (result == EOWNERDEAD) {
+		const tlsf_variant *variant = shared -> variant;
+
+		if (variant -> check(shared -> instance) == 0 && variant -> check_pool(variant -> get_pool(shared -> instance)) == 0) {
+			pthread_mutex_consistent(&shared -> header -> lock);
+			return 0;
+		}
+
+		// Unlocking without marking it consistent leaves the lock unrecoverable for every process
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Shared heap was left corrupt by a dead process\n");
+		pthread_mutex_unlock(&shared -> header -> lock);
+		return -1;
+	}
+
+	if (result != 0) {
+		SDL_Log("Shared heap is unusable\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void sdl_tlsf_shared_unlock(tlsf_shared_instance *shared) {
+
+	pthread_mutex_unlock(&shared -> header -> lock);
+}
+
+// Maps an existing shared heap and checks it was set up by a compatible build
+static tlsf_shared_instance *sdl_tlsf_shared_map(int fd) {
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(tlsf_shared_header)) {
+		SDL_Log("Shared heap is missing or truncated\n");
+		return NULL;
+	}
+
+	void *mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to map shared heap\n");
+		return NULL;
+	}
+
+	tlsf_shared_header *header = (tlsf_shared_header *)mem;
+	if (header -> magic != SDL_TLSF_SHARED_MAGIC || header -> version != SDL_TLSF_SHARED_VERSION || header -> bytes != (size_t)st.st_size) {
+		SDL_Log("Shared heap has an unknown layout\n");
+		munmap(mem, st.st_size);
+		return NULL;
+	}
+
+	tlsf_shared_instance *shared = calloc(1, sizeof(tlsf_shared_instance));
+	if (shared == NULL) {
+		munmap(mem, st.st_size);
+		return NULL;
+	}
+
+	shared -> header = header;
+	shared -> variant = &tlsf_variant_packed;
+	shared -> instance = (tlsf_t)((char *)mem + header -> heap_offset);
+	shared -> bytes = header -> bytes;
+	shared -> fd = fd;
+
+	return shared;
+}
+
+tlsf_shared_instance *sdl_tlsf_shared_create(const char *name, size_t bytes) {
+
+	const tlsf_variant *variant = &tlsf_variant_packed;
+	size_t heap_offset = sdl_tlsf_header_size(sizeof(tlsf_shared_header));
+
+	if (bytes <= heap_offset + variant -> size() || bytes - heap_offset > variant -> block_size_max()) {
+		SDL_Log("Shared heap size must be under %zu bytes\n", variant -> block_size_max());
+		return NULL;
+	}
+
+	int fd = name ? shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600) : memfd_create("sdl_tlsf_shared", MFD_CLOEXEC);
+	if (fd < 0) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to create shared heap\n");
+		return NULL;
+	}
+
+	if (ftruncate(fd, bytes) != 0) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to size shared heap\n");
+		close(fd);
+		if (name) shm_unlink(name);
+		return NULL;
+	}
+
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to map shared heap\n");
+		close(fd);
+		if (name) shm_unlink(name);
+		return NULL;
+	}
+
+	tlsf_shared_header *header = (tlsf_shared_header *)mem;
+	header -> bytes = bytes;
+	header -> heap_offset = heap_offset;
+	header -> root = 0;
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&header -> lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	// The packed variant links blocks by offset, so the heap works wherever it's mapped
+	variant -> create_with_pool((char *)mem + heap_offset, bytes - heap_offset);
+
+	// Published last, a process that opens the heap early sees a bad magic instead of a half built heap
+	header -> version = SDL_TLSF_SHARED_VERSION;
+	__atomic_store_n(&header -> magic, SDL_TLSF_SHARED_MAGIC, __ATOMIC_RELEASE);
+
+	munmap(mem, bytes);
+
+	return sdl_tlsf_shared_map(fd);
+}
+
+tlsf_shared_instance *sdl_tlsf_shared_open(const char *name) {
+
+	int fd = shm_open(name, O_RDWR, 0600);
+	if (fd < 0) {
+		SDL_Log("Failed to open shared heap %s\n", name);
+		return NULL;
+	}
+
+	tlsf_shared_instance *shared = sdl_tlsf_shared_map(fd);
+	if (shared == NULL) {
+		close(fd);
+	}
+
+	return shared;
+}
+
+tlsf_shared_instance *sdl_tlsf_shared_open_fd(int fd) {
+
+	// Our own descriptor, the caller keeps theirs
+	int own_fd = dup(fd);
+	if (own_fd < 0) {
+		return NULL;
+	}
+
+	tlsf_shared_instance *shared = sdl_tlsf_shared_map(own_fd);
+	if (shared == NULL) {
+		close(own_fd);
+	}
+
+	return shared;
+}
+
+void sdl_tlsf_shared_close(tlsf_shared_instance *shared) {
+
+	munmap(shared -> header, shared -> bytes);
+	close(shared -> fd);
+	free(shared);
+}
+
+void *sdl_tlsf_shared_malloc(tlsf_shared_instance *shared, size_t bytes) {
+
+	if (sdl_tlsf_shared_lock(shared) != 0) {
+		return NULL;
+	}
+
+	void *ptr = shared -> variant -> malloc(shared -> instance, bytes);
+
+	sdl_tlsf_shared_unlock(shared);
+	return ptr;
+}
+
+void sdl_tlsf_shared_free(tlsf_shared_instance *shared, void *ptr) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	if (sdl_tlsf_shared_lock(shared) != 0) {
+		return;
+	}
+
+	shared -> variant -> free(shared -> instance, ptr);
+
+	sdl_tlsf_shared_unlock(shared);
+}
+
+size_t sdl_tlsf_shared_to_offset(tlsf_shared_instance *shared, const void *ptr) {
+
+	return ptr ? (size_t)((const char *)ptr - (const char *)shared -> header) : 0;
+}
+
+void *sdl_tlsf_shared_from_offset(tlsf_shared_instance *shared, size_t offset) {
+
+	return offset ? (char *)shared -> header + offset : NULL;
+}
+
+void sdl_tlsf_shared_set_root(tlsf_shared_instance *shared, void *ptr) {
+
+	if (sdl_tlsf_shared_lock(shared) != 0) {
+		return;
+	}
+
+	shared -> header -> root = sdl_tlsf_shared_to_offset(shared, ptr);
+
+	sdl_tlsf_shared_unlock(shared);
+}
+
+void *sdl_tlsf_shared_get_root(tlsf_shared_instance *shared) {
+
+	if (sdl_tlsf_shared_lock(shared) != 0) {
+		return NULL;
+	}
+
+	void *ptr = sdl_tlsf_shared_from_offset(shared, shared -> header -> root);
+
+	sdl_tlsf_shared_unlock(shared);
+	return ptr;
+}
+
+// ###### PERSISTENT INSTANCES ######
+
+const tlsf_variant *sdl_tlsf_find_variant(const char *name) {
+
+	const tlsf_variant *variants[] = {
+		&tlsf_variant_default, &tlsf_variant_small, &tlsf_variant_fine, &tlsf_variant_large, &tlsf_variant_packed
+	};
+
+	for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+		if (strcmp(variants[i] -> name, name) == 0) {
+			return variants[i];
+		}
+	}
+	return NULL;
+}
+
+static size_t sdl_tlsf_page_align(size_t bytes) {
+
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	return (bytes + page - 1) & ~(page - 1);
+}
+
+// Anything that changes how the structures in a snapshot are laid out
+static uint64_t sdl_tlsf_persist_layout(const tlsf_variant *variant) {
+
+	return (uint64_t)sizeof(tlsf_instance)
+		| (uint64_t)sizeof(tlsf_pool) << 16
+		| (uint64_t)variant -> size() << 32
+		| (uint64_t)tlsf_align_size() << 56;
+}
+
+// FNV-1a, a word at a time so checksumming a heap's worth of pages stays cheap next to writing them
+static uint64_t sdl_tlsf_persist_hash(const void *data, size_t bytes) {
+
+	const unsigned char *tail = (const unsigned char *)data;
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (; bytes >= sizeof(uint64_t); bytes -= sizeof(uint64_t), tail += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, tail, sizeof(word));
+		hash = (hash ^ word) * 1099511628211ULL;
+	}
+	for (size_t i = 0; i < bytes; i++) {
+		hash = (hash ^ tail[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Of the header up to the checksum
+static uint64_t sdl_tlsf_persist_checksum(const tlsf_persist_header *header) {
+
+	return sdl_tlsf_persist_hash(header, offsetof(tlsf_persist_header, checksum));
+}
+
+// Of the instance, its pools and every allocation, everything behind the header page
+static uint64_t sdl_tlsf_persist_body_checksum(const tlsf_persist_header *header) {
+
+	size_t header_size = sdl_tlsf_page_align(sizeof(tlsf_persist_header));
+
+	return sdl_tlsf_persist_hash((const char *)header + header_size, header -> used - header_size);
+}
+
+// Makes a rename in path's directory survive a crash
+static int sdl_tlsf_persist_sync_dir(const char *path) {
+
+	char dir[4096];
+	const char *slash = strrchr(path, '/');
+
+	if (slash == NULL) {
+		SDL_strlcpy(dir, ".", sizeof(dir));
+	} else if (slash == path) {
+		SDL_strlcpy(dir, "/", sizeof(dir));
+	} else {
+		size_t length = (size_t)(slash - path) + 1;
+		SDL_strlcpy(dir, path, length < sizeof(dir) ? length : sizeof(dir));
+	}
+
+	int fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		return -1;
+	}
+
+	int result = fsync(fd);
+	close(fd);
+	return result;
+}
+
+// Reserves address space for a region, at address if it's given and free
+static void *sdl_tlsf_persist_reserve(void *address, size_t bytes) {
+
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_FIXED_NOREPLACE
+	if (address) flags |= MAP_FIXED_NOREPLACE;
+#endif
+
+	void *mem = mmap(address, bytes, PROT_NONE, flags, -1, 0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+
+	// Older kernels treat the address as a hint
+	if (address && mem != address) {
+		munmap(mem, bytes);
+		return NULL;
+	}
+	return mem;
+}
+
+// Hands out the next bytes of the region, backed by fd for snapshot instances. MAP_FAILED once it's full
+static void *sdl_tlsf_persist_extend(tlsf_persist_header *header, int fd, size_t bytes) {
+
+	bytes = sdl_tlsf_page_align(bytes);
+
+	if (header -> used + bytes > header -> reserved) {
+		SDL_Log("Persistent instance is out of reserved space\n");
+		return MAP_FAILED;
+	}
+
+	void *mem = (char *)header + header -> used;
+	if (fd < 0) {
+		if (mprotect(mem, bytes, PROT_READ | PROT_WRITE) != 0) {
+			return MAP_FAILED;
+		}
+	} else {
+		// The memfd only ever grows, a restore to a smaller snapshot leaves the tail for the next extend
+		struct stat st;
+		if (fstat(fd, &st) != 0
+			|| ((size_t)st.st_size < header -> used + bytes && ftruncate(fd, header -> used + bytes) != 0)
+			|| mmap(mem, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, header -> used) == MAP_FAILED) {
+			return MAP_FAILED;
+		}
+	}
+
+	header -> used += bytes;
+	return mem;
+}
+
+tlsf_instance *sdl_tlsf_create_persistent_instance(size_t pool_size, size_t max_bytes, void *address, const tlsf_variant *variant) {
+
+	if (variant == NULL) {
+		variant = sdl_tlsf_pick_variant(pool_size);
+	}
+	if (address == NULL) {
+		address = SDL_TLSF_PERSIST_ADDRESS;
+	}
+
+	size_t header_size = sdl_tlsf_page_align(sizeof(tlsf_persist_header));
+	size_t first_size = sdl_tlsf_page_align(sdl_tlsf_instance_size(pool_size));
+	max_bytes = sdl_tlsf_page_align(max_bytes);
+
+	if (header_size + first_size > max_bytes) {
+		SDL_Log("Persistent instance needs at least %zu bytes\n", header_size + first_size);
+		return NULL;
+	}
+
+	tlsf_persist_header *header = sdl_tlsf_persist_reserve(address, max_bytes);
+	if (header == NULL) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to reserve %p for a persistent instance\n", address);
+		return NULL;
+	}
+
+	mprotect(header, header_size, PROT_READ | PROT_WRITE);
+
+	header -> magic = SDL_TLSF_PERSIST_MAGIC;
+	header -> version = SDL_TLSF_PERSIST_VERSION;
+	header -> layout = sdl_tlsf_persist_layout(variant);
+	header -> base = (uint64_t)(uintptr_t)header;
+	header -> used = header_size;
+	header -> reserved = max_bytes;
+	header -> root = 0;
+	SDL_strlcpy(header -> variant, variant -> name, sizeof(header -> variant));
+
+	void *mem = sdl_tlsf_persist_extend(header, -1, first_size);
+	tlsf_instance *instance = sdl_tlsf_init_instance(mem, pool_size, variant);
+
+	instance -> persist = header;
+	instance -> huge_threshold = SIZE_MAX;
+	instance -> huge_sized_min = SIZE_MAX;
+
+	return instance;
+}
+
+int sdl_tlsf_checkpoint_instance(tlsf_instance *instance, const char *path) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PERSIST);
+
+	if (instance -> persist == NULL) {
+		SDL_Log("Only persistent instances can be checkpointed\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return -1;
+	}
+
+	// Queued blocks would come back as leaks
+	sdl_tlsf_drain_remote_frees(instance);
+
+	tlsf_persist_header *header = instance -> persist;
+	header -> body_checksum = sdl_tlsf_persist_body_checksum(header);
+	header -> checksum = sdl_tlsf_persist_checksum(header);
+
+	// Written next to the old snapshot and renamed over it, a crash leaves one or the other
+	char tmp_path[4096];
+	SDL_snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	int fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0) {
+		SDL_Log("Failed to create %s\n", tmp_path);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return -1;
+	}
+
+	const char *data = (const char *)header;
+	size_t written = 0;
+	while (written < header -> used) {
+		ssize_t n = write(fd, data + written, header -> used - written);
+		if (n <= 0) {
+			break;
+		}
+		written += n;
+	}
+
+	int ok = written == header -> used && fsync(fd) == 0;
+	close(fd);
+
+	if (!ok || rename(tmp_path, path) != 0) {
+		SDL_Log("Failed to write snapshot %s\n", path);
+		unlink(tmp_path);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return -1;
+	}
+
+	// The new name is only durable once the directory entry is
+	if (sdl_tlsf_persist_sync_dir(path) != 0) {
+		SDL_Log("Failed to sync the directory of %s\n", path);
+		sdl_tlsf_lock_release(tlsf_lock);
+		return -1;
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return 0;
+}
+
+// Moves the pointers the SDL layer keeps about an instance by delta, the heap itself is relative already
+static void sdl_tlsf_persist_relocate(tlsf_instance *instance, ptrdiff_t delta) {
+
+	#define SDL_TLSF_RELOCATE(ptr) ((ptr) = (void *)((char *)(ptr) + delta))
+
+	SDL_TLSF_RELOCATE(instance -> instance);
+	SDL_TLSF_RELOCATE(instance -> tlsf_pools.header);
+	SDL_TLSF_RELOCATE(instance -> tlsf_pools.tail);
+	if (instance -> last_pool) SDL_TLSF_RELOCATE(instance -> last_pool);
+
+	for (tlsf_pool *pool = instance -> tlsf_pools.header; pool != NULL; pool = pool -> next) {
+		SDL_TLSF_RELOCATE(pool -> pool);
+		SDL_TLSF_RELOCATE(pool -> mem);
+		SDL_TLSF_RELOCATE(pool -> start);
+		SDL_TLSF_RELOCATE(pool -> end);
+		if (pool -> next) SDL_TLSF_RELOCATE(pool -> next);
+		if (pool -> prev) SDL_TLSF_RELOCATE(pool -> prev);
+	}
+
+	#undef SDL_TLSF_RELOCATE
+}
+
+tlsf_instance *sdl_tlsf_restore_instance(const char *path) {
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	// Validate everything we can before touching the address space
+	tlsf_persist_header saved;
+	struct stat st;
+	const tlsf_variant *variant = NULL;
+
+	if (pread(fd, &saved, sizeof(saved), 0) != (ssize_t)sizeof(saved)
+		|| fstat(fd, &st) != 0
+		|| saved.magic != SDL_TLSF_PERSIST_MAGIC
+		|| saved.version != SDL_TLSF_PERSIST_VERSION
+		|| saved.checksum != sdl_tlsf_persist_checksum(&saved)
+		|| saved.used != (uint64_t)st.st_size
+		|| saved.used > saved.reserved
+		|| (variant = sdl_tlsf_find_variant(saved.variant)) == NULL
+		|| saved.layout != sdl_tlsf_persist_layout(variant)) {
+		SDL_Log("%s is not a snapshot this build can restore\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	// Back where it was saved, unless something else lives there now and the heap can move
+	void *base = sdl_tlsf_persist_reserve((void *)(uintptr_t)saved.base, saved.reserved);
+	if (base == NULL && variant == &tlsf_variant_packed) {
+		base = sdl_tlsf_persist_reserve(NULL, saved.reserved);
+	}
+	if (base == NULL) {
+		SDL_Log("Address %p for %s is taken\n", (void *)(uintptr_t)saved.base, path);
+		close(fd);
+		return NULL;
+	}
+
+	// Private so the snapshot only changes on the next checkpoint, pages are read in as they're touched
+	if (mmap(base, saved.used, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to map %s\n", path);
+		munmap(base, saved.reserved);
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+
+	tlsf_persist_header *header = base;
+
+	// A torn or corrupted body would hand out a broken heap
+	if (header -> body_checksum != sdl_tlsf_persist_body_checksum(header)) {
+		SDL_Log("%s is corrupt\n", path);
+		munmap(base, saved.reserved);
+		return NULL;
+	}
+
+	tlsf_instance *instance = (tlsf_instance *)((char *)base + sdl_tlsf_page_align(sizeof(tlsf_persist_header)));
+
+	if ((uintptr_t)base != saved.base) {
+		sdl_tlsf_persist_relocate(instance, (char *)base - (char *)(uintptr_t)saved.base);
+		header -> base = (uint64_t)(uintptr_t)base;
+	}
+
+	// Process local state from the run that saved it
+	instance -> variant = variant;
+	instance -> persist = header;
+	instance -> snapshot_fd = -1;
+	instance -> snapshot_torn = 0;
+
+	// The owning thread is gone, and the checkpoint drained the queue
+	instance -> owner = 0;
+	instance -> remote_frees = NULL;
+	instance -> retired_pending = 0;
+	instance -> huge_blocks = NULL;
+	instance -> num_huge = 0;
+	instance -> huge_bytes = 0;
+
+	// Callbacks point into the old process, the limits carry over
+	instance -> num_pressure = 0;
+	instance -> in_pressure = 0;
+
+	return instance;
+}
+
+void sdl_tlsf_persist_set_root(tlsf_instance *instance, void *ptr) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PERSIST);
+
+	instance -> persist -> root = ptr ? (uint64_t)((char *)ptr - (char *)instance -> persist) : 0;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+}
+
+void *sdl_tlsf_persist_get_root(tlsf_instance *instance) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PERSIST);
+
+	void *ptr = instance -> persist -> root ? (char *)instance -> persist + instance -> persist -> root : NULL;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return ptr;
+}
+
+// ###### SNAPSHOT INSTANCES ######
+
+// Walks the region's page table entries, a page that is present but no longer backed by the memfd
+// (or was swapped out) got its own copy when it was written. Copies those into the memfd when flush is set
+// Returns the page count, SDL_TLSF_SNAPSHOT_FAILED if a page couldn't be looked at or copied
+static size_t sdl_tlsf_snapshot_scan(tlsf_instance *instance, int flush) {
+
+	tlsf_persist_header *header = instance -> persist;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t num_pages = header -> used / page;
+	size_t dirty = 0;
+
+	int pagemap = open("/proc/self/pagemap", O_RDONLY);
+	if (pagemap < 0) {
+		SDL_Log("Can't read /proc/self/pagemap\n");
+		return SDL_TLSF_SNAPSHOT_FAILED;
+	}
+
+	uint64_t entries[512];
+	off_t first = (off_t)((uintptr_t)header / page) * sizeof(uint64_t);
+
+	for (size_t i = 0; i < num_pages; i += 512) {
+
+		size_t count = num_pages - i < 512 ? num_pages - i : 512;
+		if (pread(pagemap, entries, count * sizeof(uint64_t), first + i * sizeof(uint64_t)) != (ssize_t)(count * sizeof(uint64_t))) {
+			SDL_Log("Can't read /proc/self/pagemap\n");
+			close(pagemap);
+			return SDL_TLSF_SNAPSHOT_FAILED;
+		}
+
+		for (size_t j = 0; j < count; j++) {
+
+			int present = (entries[j] >> 63) & 1;
+			int swapped = (entries[j] >> 62) & 1;
+			int file = (entries[j] >> 61) & 1;
+
+			if ((present && !file) || swapped) {
+				dirty++;
+				if (flush) {
+					size_t offset = (i + j) * page;
+					if (pwrite(instance -> snapshot_fd, (char *)header + offset, page, offset) != (ssize_t)page) {
+						SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to write snapshot page\n");
+						close(pagemap);
+						return SDL_TLSF_SNAPSHOT_FAILED;
+					}
+				}
+			}
+		}
+	}
+
+	close(pagemap);
+	return dirty;
+}
+
+tlsf_instance *sdl_tlsf_create_snapshot_instance(size_t pool_size, size_t max_bytes, const tlsf_variant *variant) {
+
+	if (variant == NULL) {
+		variant = sdl_tlsf_pick_variant(pool_size);
+	}
+
+	size_t header_size = sdl_tlsf_page_align(sizeof(tlsf_persist_header));
+	size_t first_size = sdl_tlsf_page_align(sdl_tlsf_instance_size(pool_size));
+	max_bytes = sdl_tlsf_page_align(max_bytes);
+
+	if (header_size + first_size > max_bytes) {
+		SDL_Log("Snapshot instance needs at least %zu bytes\n", header_size + first_size);
+		return NULL;
+	}
+
+	int fd = memfd_create("sdl_tlsf_snapshot", MFD_CLOEXEC);
+	if (fd < 0 || ftruncate(fd, header_size) != 0) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to create memfd for a snapshot instance\n");
+		if (fd >= 0) close(fd);
+		return NULL;
+	}
+
+	// Anywhere will do, snapshots are only ever restored in place
+	tlsf_persist_header *header = sdl_tlsf_persist_reserve(NULL, max_bytes);
+	if (header == NULL || mmap(header, header_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to map a snapshot instance\n");
+		if (header) munmap(header, max_bytes);
+		close(fd);
+		return NULL;
+	}
+
+	header -> magic = SDL_TLSF_PERSIST_MAGIC;
+	header -> version = SDL_TLSF_PERSIST_VERSION;
+	header -> layout = sdl_tlsf_persist_layout(variant);
+	header -> base = (uint64_t)(uintptr_t)header;
+	header -> used = header_size;
+	header -> reserved = max_bytes;
+	header -> root = 0;
+	SDL_strlcpy(header -> variant, variant -> name, sizeof(header -> variant));
+
+	void *mem = sdl_tlsf_persist_extend(header, fd, first_size);
+	if (mem == MAP_FAILED) {
+		munmap(header, max_bytes);
+		close(fd);
+		return NULL;
+	}
+
+	tlsf_instance *instance = sdl_tlsf_init_instance(mem, pool_size, variant);
+	instance -> persist = header;
+	instance -> snapshot_fd = fd;
+	instance -> huge_threshold = SIZE_MAX;
+	instance -> huge_sized_min = SIZE_MAX;
+
+	// The memfd is all zeros so far, the first snapshot is the freshly built heap
+	if (sdl_tlsf_clone_instance(instance) == SDL_TLSF_SNAPSHOT_FAILED) {
+		munmap(header, max_bytes);
+		close(fd);
+		return NULL;
+	}
+
+	return instance;
+}
+
+size_t sdl_tlsf_clone_instance(tlsf_instance *instance) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PERSIST);
+
+	if (instance -> snapshot_fd < 0) {
+		SDL_Log("Only snapshot instances can be cloned\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return SDL_TLSF_SNAPSHOT_FAILED;
+	}
+
+	// Cleared before the scan so the copy of the instance in the memfd says the snapshot is whole
+	instance -> snapshot_torn = 0;
+
+	tlsf_persist_header *header = instance -> persist;
+	size_t dirty = sdl_tlsf_snapshot_scan(instance, 1);
+
+	// Remapping now would read back pages that never made it into the memfd, the live heap has the only copy
+	if (dirty == SDL_TLSF_SNAPSHOT_FAILED) {
+		instance -> snapshot_torn = 1;
+		sdl_tlsf_lock_release(tlsf_lock);
+		return SDL_TLSF_SNAPSHOT_FAILED;
+	}
+
+	// Dropping the private copies makes every page read from the memfd again, which now matches them
+	if (mmap(header, header -> used, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, instance -> snapshot_fd, 0) == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to remap snapshot instance\n");
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return dirty;
+}
+
+size_t sdl_tlsf_restore_clone(tlsf_instance *instance) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PERSIST);
+
+	if (instance -> snapshot_fd < 0) {
+		SDL_Log("Only snapshot instances can be restored from a clone\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return SDL_TLSF_SNAPSHOT_FAILED;
+	}
+
+	if (instance -> snapshot_torn) {
+		SDL_Log("Last clone of the snapshot instance failed, nothing to restore\n");
+		sdl_tlsf_lock_release(tlsf_lock);
+		return SDL_TLSF_SNAPSHOT_FAILED;
+	}
+
+	tlsf_persist_header *header = instance -> persist;
+	size_t dirty = sdl_tlsf_snapshot_scan(instance, 0);
+	if (dirty == SDL_TLSF_SNAPSHOT_FAILED) {
+		sdl_tlsf_lock_release(tlsf_lock);
+		return SDL_TLSF_SNAPSHOT_FAILED;
+	}
+
+	// Pools added since the snapshot go back to being reserved address space
+	tlsf_persist_header saved;
+	size_t current_used = header -> used;
+	if (pread(instance -> snapshot_fd, &saved, sizeof(saved), 0) == (ssize_t)sizeof(saved) && saved.used < current_used) {
+		mmap((char *)header + saved.used, current_used - saved.used, PROT_NONE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+		current_used = saved.used;
+	}
+
+	// The instance struct lives in the region too, so it comes back with everything else
+	if (mmap(header, current_used, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, instance -> snapshot_fd, 0) == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to remap snapshot instance\n");
+	}
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return dirty;
+}
+
+size_t sdl_tlsf_dirty_pages(tlsf_instance *instance) {
+
+	sdl_tlsf_lock_acquire(tlsf_lock, SDL_TLSF_LOCK_PERSIST);
+
+	size_t dirty = instance -> persist ? sdl_tlsf_snapshot_scan(instance, 0) : 0;
+
+	sdl_tlsf_lock_release(tlsf_lock);
+	return dirty;
+}
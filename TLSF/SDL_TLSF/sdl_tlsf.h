@@ -6,10 +6,20 @@
 #define TLSF_SDL_TLSF_H
 
 #include <sys/mman.h>
+#include <pthread.h>
+#include <stdint.h>
 
 #include "../tlsf.h"
+#include "../tlsf_variants.h"
+#include "sdl_tlsf_cpu.h"
+#include "sdl_tlsf_profile.h"
+#include "sdl_tlsf_lock.h"
 #include "../SDL/include/SDL3/SDL.h"
 
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
 // Our Memory Pool
 typedef struct tlsf_pool {
 
@@ -33,6 +43,174 @@ typedef struct tlsf_pool {
 
 } tlsf_pool;
 
+// An allocation too large for the pools, lives in its own mapping
+typedef struct tlsf_huge_block {
+
+	size_t bytes; // Requested size
+	size_t map_size; // Size of the mapping, header included
+	size_t offset; // Where the payload starts, keeps the requested alignment
+	size_t align; // Requested alignment, 0 for the default
+
+	// Doubly linked list
+	struct tlsf_huge_block *next;
+	struct tlsf_huge_block *prev;
+
+} tlsf_huge_block;
+
+// Huge block payloads start at least a cache line into the mapping
+#define SDL_TLSF_HUGE_HEADER_SIZE 64
+
+// One compiled TLSF configuration, every instance allocates through one of these
+typedef struct tlsf_variant {
+
+	const char *name;
+
+	tlsf_t (*create_with_pool)(void *mem, size_t bytes);
+	pool_t (*get_pool)(tlsf_t tlsf);
+	pool_t (*add_pool)(tlsf_t tlsf, void *mem, size_t bytes);
+	void (*remove_pool)(tlsf_t tlsf, pool_t pool);
+
+	void *(*malloc)(tlsf_t tlsf, size_t bytes);
+	void *(*memalign)(tlsf_t tlsf, size_t align, size_t bytes);
+	void *(*realloc)(tlsf_t tlsf, void *ptr, size_t size);
+	void *(*realloc_aligned)(tlsf_t tlsf, void *ptr, size_t align, size_t size);
+	void *(*calloc)(tlsf_t tlsf, size_t elem_size, size_t num_elems);
+	void (*free)(tlsf_t tlsf, void *ptr);
+	size_t (*expand)(tlsf_t tlsf, void *ptr, size_t min_size, size_t max_size);
+	void (*set_deferred_free)(tlsf_t tlsf, int enable);
+	void (*compact)(tlsf_t tlsf);
+
+	// Header layouts differ between variants, so block sizes have to be read by the one that made the block
+	size_t (*block_size)(void *ptr);
+	size_t (*size)(void);
+	size_t (*block_size_max)(void);
+	size_t (*fit_size)(size_t size, size_t align); // Smallest free block a request is sure to be served from
+
+	int (*check)(tlsf_t tlsf);
+	int (*check_pool)(pool_t pool);
+
+} tlsf_variant;
+
+// Default build, up to 16 MB pools on the small one and 1 TB on the large one, fine has 64 lists per size class
+// Packed has 16 byte minimum blocks for small object heaps, pools up to 256 MB
+extern const tlsf_variant tlsf_variant_default;
+extern const tlsf_variant tlsf_variant_small;
+extern const tlsf_variant tlsf_variant_fine;
+extern const tlsf_variant tlsf_variant_large;
+extern const tlsf_variant tlsf_variant_packed;
+
+// Front of a persistent instance's region and of its snapshot file
+typedef struct {
+
+	uint32_t magic;
+	uint32_t version;
+
+	uint64_t layout; // Structure sizes of the build that wrote it, a different build can't read it
+	uint64_t base; // Address the region was mapped at, pointers in the heap are only valid there
+	uint64_t used; // Bytes of the region in use, also the size of the file
+	uint64_t reserved; // Address space held for the region to grow into
+	uint64_t root; // Offset of the object a restored run starts from, 0 if unset
+	char variant[16]; // Name of the tlsf variant running the heap
+	uint64_t body_checksum; // Of the region after the header page, up to used
+
+	uint64_t checksum; // Of everything above
+
+} tlsf_persist_header;
+
+#define SDL_TLSF_PERSIST_MAGIC 0x544c5350 // "TLSP"
+#define SDL_TLSF_PERSIST_VERSION 2
+
+// Where persistent regions go when the caller has no preference
+#define SDL_TLSF_PERSIST_ADDRESS ((void *)0x600000000000)
+
+// What happens to the pages of a pool handed to the depot
+typedef enum {
+	SDL_TLSF_DEPOT_KEEP, // Left resident, the next instance to take it doesn't fault them back in
+	SDL_TLSF_DEPOT_FREE, // MADV_FREE, the kernel reclaims them only under memory pressure
+	SDL_TLSF_DEPOT_DONTNEED // MADV_DONTNEED, given back right away and zero-filled on the next touch
+} tlsf_depot_advice;
+
+typedef struct {
+
+	size_t regions; // Held right now
+	size_t bytes;
+
+	size_t hits; // Pools added from the depot
+	size_t misses; // Pools that had to be mapped
+	size_t donated; // Empty pools taken in
+	size_t rejected; // Empty pools unmapped because the depot was full
+
+	// System calls actually made for pools, a hit saves an mmap and the munmap of the pool it reuses
+	size_t mmaps;
+	size_t munmaps;
+	size_t madvises;
+
+} tlsf_depot_stats;
+
+// Default depot capacity
+#define SDL_TLSF_DEPOT_DEFAULT_BYTES ((size_t)(1 << 20) * 256)
+
+// How an instance sizes the pools it adds
+typedef enum {
+	SDL_TLSF_GROWTH_FIXED, // Every pool is pool_size
+	SDL_TLSF_GROWTH_GEOMETRIC, // Each pool doubles the last one, freeing a pool halves the next
+	SDL_TLSF_GROWTH_PREDICTIVE // Sized for the net allocation rate over SDL_TLSF_GROWTH_HORIZON_NS
+} tlsf_growth_policy;
+
+// How far ahead predictive growth provisions for
+#define SDL_TLSF_GROWTH_HORIZON_NS ((Uint64)250 * 1000000)
+
+// Tags one thread can have pushed at once
+#define SDL_TLSF_MAX_TAG_DEPTH 16
+
+// First pool of a tag heap, later ones grow geometrically up to the instance's largest pool
+#define SDL_TLSF_TAG_POOL_SIZE ((size_t)(1 << 20) * 4)
+
+// Tag the instance serves transient allocations from, not for user tags
+#define SDL_TLSF_TAG_TRANSIENT 0xFFFFFFFFu
+
+// How long an allocation is expected to live
+typedef enum {
+	SDL_TLSF_LIFETIME_DEFAULT, // No idea, same as sdl_tlsf_malloc
+	SDL_TLSF_LIFETIME_TRANSIENT, // Freed soon, kept out of the pools long-lived blocks are in
+	SDL_TLSF_LIFETIME_PERSISTENT // Outlives most of what's around it
+} tlsf_lifetime;
+
+// How close an instance is to its budget when the pressure callbacks run
+typedef enum {
+	SDL_TLSF_PRESSURE_SOFT, // Growth crossed the soft limit, the allocation goes ahead either way
+	SDL_TLSF_PRESSURE_HARD // Growth would cross the hard limit, it's retried once the callbacks return
+} tlsf_pressure_level;
+
+struct tlsf_instance;
+
+// Drops caches or anything else it can free from the instance, needed is how many bytes over the limit it is
+// Runs with the SDL_TLSF lock held on the allocating thread, so it can free and allocate but other threads wait
+typedef void (*tlsf_pressure_callback)(struct tlsf_instance *instance, tlsf_pressure_level level, size_t needed, void *userdata);
+
+typedef struct {
+	tlsf_pressure_callback callback;
+	void *userdata;
+} tlsf_pressure_handler;
+
+#define SDL_TLSF_MAX_PRESSURE_CALLBACKS 8
+
+typedef struct {
+
+	size_t footprint; // Bytes mapped for pools and huge blocks, what the limits apply to
+	size_t peak_footprint;
+	size_t used; // Bytes handed out from the pools and huge blocks
+
+	size_t soft_limit;
+	size_t hard_limit;
+
+	size_t soft_events;
+	size_t hard_events;
+	size_t hard_recovered; // Hard limit events where the callbacks made enough room to grow
+	size_t growth_denied; // Pools or huge blocks refused, the allocation only succeeds if freed space fits it
+
+} tlsf_budget_stats;
+
 // List of memory pools
 typedef struct {
 	tlsf_pool *header;
@@ -40,26 +218,124 @@ typedef struct {
 } tlsf_pool_list;
 
 // Our TLSF Instance, contains the tlsf instance and the memory pool list
-typedef struct {
+typedef struct tlsf_instance {
 
 	tlsf_t instance;
+	const tlsf_variant *variant; // Configuration the instance was created with
 	tlsf_pool_list tlsf_pools;
+	tlsf_pool *last_pool; // Where the last pool lookup landed, checked before walking the list
 
 	size_t num_pools;
-	size_t pool_size;
+	size_t pool_size; // Size of the first pool, and of every pool under the fixed policy
+
+	// Pools can be any size from pool_size up to max_pool_size
+	tlsf_growth_policy growth;
+	size_t max_pool_size;
+	size_t next_pool_size; // Geometric growth's next pool
+	double growth_rate; // Predictive growth's estimate, bytes per nanosecond
+	Uint64 last_growth_ns;
+	size_t used_at_growth;
+	size_t growth_events; // Pools added over the instance's life
 
 	// Total size of all pools
 	size_t total_size;
 	size_t total_used;
 
+	// Allocations at or above the threshold get their own mapping
+	tlsf_huge_block *huge_blocks;
+	size_t huge_threshold;
+	size_t huge_sized_min; // Largest threshold the instance has had, every request from there up is a huge block
+	size_t num_huge;
+	size_t huge_bytes;
+
+	// Percent to over-provision growing reallocs by, 0 disables
+	size_t realloc_growth;
+
+	// Start of the region for persistent instances, NULL for regular ones
+	tlsf_persist_header *persist;
+
+	// memfd holding the last snapshot of a snapshot instance, -1 otherwise
+	int snapshot_fd;
+
+	// A clone failed partway, the memfd holds a mix of two snapshots until the next clone succeeds
+	int snapshot_torn;
+
+	// Thread the instance belongs to, 0 for none. Frees from any other thread go on remote_frees
+	Uint64 owner;
+
+	// Blocks freed by other threads, linked through their first word and pushed with a CAS
+	// The next allocation takes the whole list and frees it under the lock
+	void *remote_frees;
+	size_t remote_drained;
+	size_t remote_batches;
+
+	// Blocks on some thread's epoch retired list, the instance can't be destroyed while any are left
+	size_t retired_pending;
+
+	// Per-CPU lists of small blocks in front of the lock, NULL when disabled
+	// Cached blocks still count as used, they only go back to TLSF when the cache is disabled
+	tlsf_cpu_cache *cpu_cache;
+
+	// Limits on total_size plus huge_bytes, 0 for none
+	size_t soft_limit;
+	size_t hard_limit;
+	int soft_signalled; // The soft callbacks ran, they run again once growth stays under the limit
+	int in_pressure; // Callbacks are running, growth they cause doesn't call them again
+
+	tlsf_pressure_handler pressure[SDL_TLSF_MAX_PRESSURE_CALLBACKS];
+	int num_pressure;
+
+	size_t peak_footprint;
+	size_t soft_events;
+	size_t hard_events;
+	size_t hard_recovered;
+	size_t growth_denied;
+
+	// Every tag gets a heap of its own, an instance with its own pools that is released in one go
+	Uint32 tag; // 0 for regular instances
+	struct tlsf_instance *parent; // Instance the tag heap belongs to, NULL for regular instances
+	struct tlsf_instance *tags; // This instance's tag heaps
+	struct tlsf_instance *next_tag;
+
 	// TODO: Explore Thread Specific Instances for shits and giggles
 	// SDL_Mutex *lock;
 
 } tlsf_instance;
 
+// Header at the start of a shared heap mapping, everything in it is an offset so any process can map it anywhere
+typedef struct {
+
+	uint32_t magic;
+	uint32_t version;
+
+	size_t bytes; // Size of the whole mapping
+	size_t heap_offset; // Where the tlsf control structure starts
+	size_t root; // Offset of an object the processes agreed on, 0 if unset
+
+	// Process shared and robust, a crashed process doesn't wedge the others
+	pthread_mutex_t lock;
+
+} tlsf_shared_header;
+
+#define SDL_TLSF_SHARED_MAGIC 0x544c5346 // "TLSF"
+#define SDL_TLSF_SHARED_VERSION 1
+
+// One process' view of a shared heap, the heap runs on the packed variant which stores no absolute pointers
+typedef struct {
+
+	tlsf_shared_header *header; // Start of this process' mapping
+	tlsf_t instance;
+	const tlsf_variant *variant;
+
+	size_t bytes;
+	int fd;
+
+} tlsf_shared_instance;
+
 //size_t base_pool_size = 1 << 20;
 
-// The current instance of tlsf
+// The current instance of tlsf, only meaningful under tlsf_lock since other heaps get swapped in while it's held
+// Use sdl_tlsf_get_instance without the lock
 extern tlsf_instance *active_instance;
 extern tlsf_instance *base_instance;
 
@@ -80,6 +356,12 @@ void sdl_tlsf_quit();
 // Creates a new instance of tlsf  (you can treat these as memory pools for specific data structures)
 tlsf_instance *sdl_tlsf_create_instance(size_t bytes);
 
+// Creates an instance on a specific TLSF configuration instead of the one picked for the pool size
+tlsf_instance *sdl_tlsf_create_instance_with_variant(size_t bytes, const tlsf_variant *variant);
+
+// Smallest configuration whose blocks can span a pool of this size
+const tlsf_variant *sdl_tlsf_pick_variant(size_t pool_size);
+
 // Gets the current active instance of tlsf
 tlsf_instance *sdl_tlsf_get_instance();
 
@@ -91,23 +373,143 @@ void sdl_tlsf_set_instance(tlsf_instance *instance);
 tlsf_instance *sdl_tlsf_rebase_instance();
 
 // Destroys that memory pool within the instance.
+// Blocks the calling thread retired from it are drained first, if other threads still hold some it's left alone
 void sdl_tlsf_destroy_instance(tlsf_instance *instance);
 
 void sdl_tlsf_print_instance(tlsf_instance *instance);
 
+// Picks how new pools are sized, max_pool_size caps them (and what a single pool allocation can be)
+// Returns -1 and leaves the policy alone if the instance's variant can't address pools that big,
+// create it with sdl_tlsf_pick_variant(max_pool_size) to grow that far
+int sdl_tlsf_set_growth_policy(tlsf_instance *instance, tlsf_growth_policy policy, size_t max_pool_size);
+
+// Sets the size at which allocations bypass the pools and get their own mapping
+void sdl_tlsf_set_huge_threshold(tlsf_instance *instance, size_t bytes);
+
+// Growing reallocs reserve this percent of extra space so later growth can stay in place, 0 disables
+void sdl_tlsf_set_realloc_growth(tlsf_instance *instance, size_t percent);
+
+// Enables lazy coalescing for the instance, freed blocks are parked and reused by same-size requests
+void sdl_tlsf_set_deferred_free(tlsf_instance *instance, int enable);
+
+// ###### BUDGETS ######
+// Limits on the bytes the instance maps, 0 for none. Growth past soft_limit calls the pressure callbacks once
+// Growth past hard_limit calls them and then only happens if they freed enough, otherwise the allocation gets
+// whatever space they freed in the existing pools or fails
+// Growth inside sdl_tlsf_realloc of a live block never calls them, they could free the block being resized
+// Tag heaps count against their instance's limits and stats, and growing one calls the instance's callbacks
+void sdl_tlsf_set_budget(tlsf_instance *instance, size_t soft_limit, size_t hard_limit);
+
+// Returns 0, or -1 when SDL_TLSF_MAX_PRESSURE_CALLBACKS are registered already
+int sdl_tlsf_add_pressure_callback(tlsf_instance *instance, tlsf_pressure_callback callback, void *userdata);
+void sdl_tlsf_remove_pressure_callback(tlsf_instance *instance, tlsf_pressure_callback callback, void *userdata);
+
+void sdl_tlsf_get_budget(tlsf_instance *instance, tlsf_budget_stats *stats);
+
 // ###### INSTANCE LOCAL MEMORY MANAGEMENT ######
-// Used within a tlsf instance to add a memory pool
+// Used within a tlsf instance to add a memory pool, sized by the growth policy
 // Could be called outside if you want to add memory pools ahead of allocation
 void sdl_tlsf_add_pool();
 void sdl_tlsf_free_pool(tlsf_pool *pool);
 void sdl_tlsf_free_pool_mem(tlsf_pool *pool);
 
+// ###### POOL DEPOT ######
+// Empty pools are kept process wide instead of unmapped, and any instance adding a pool of the same size takes one
+// max_bytes 0 turns the depot off, anything over it is unmapped as before
+void sdl_tlsf_depot_configure(size_t max_bytes, tlsf_depot_advice advice);
+
+// Unmaps held pools until at most keep_bytes are left
+void sdl_tlsf_depot_trim(size_t keep_bytes);
+
+void sdl_tlsf_depot_get_stats(tlsf_depot_stats *stats);
+
+// ###### LOCK STATS ######
+// What tlsf_lock went through per call site since init or the last reset, all zero unless built with
+// SDL_TLSF_LOCK_STATS (see sdl_tlsf_lock.h). sdl_tlsf_quit prints them
+void sdl_tlsf_get_lock_stats(tlsf_lock_stats *stats);
+void sdl_tlsf_reset_lock_stats(void);
+
+// Coalesces any blocks parked by deferred freeing in the active instance
+void sdl_tlsf_compact();
+
 // Memory allocation functions, overloads the SDL memory functions
 void *sdl_tlsf_malloc(size_t bytes);
 void sdl_tlsf_free(void *ptr);
 void *sdl_tlsf_calloc(size_t nmemb, size_t size);
 void *sdl_tlsf_realloc(void *ptr, size_t size);
 
+// Aligned allocation, align must be a power of two. Free with sdl_tlsf_free
+void *sdl_tlsf_aligned_alloc(size_t align, size_t size);
+
+// Reallocates keeping the alignment the block was allocated with
+void *sdl_tlsf_aligned_realloc(void *ptr, size_t align, size_t size);
+
+// Grows the block in place to somewhere in [min_size, max_size], never moves it
+// Returns the new usable size, or 0 if it can't grow without moving. A block already min_size or larger comes back
+// as it is, and huge blocks grow by whole pages so they can end up past max_size
+size_t sdl_tlsf_try_expand(void *ptr, size_t min_size, size_t max_size);
+
+// Frees a block whose size the caller still knows, size being what it was allocated or last reallocated with
+// (not what sdl_tlsf_try_expand grew it to). Large sizes go straight to the huge block's header without a pool
+// or huge list search, the rest skip the huge list. Debug builds check the size against the block
+void sdl_tlsf_free_sized(void *ptr, size_t size);
+
+// Bytes the block can actually hold, at least what was asked for. 0 for NULL or memory the active instance doesn't own
+size_t sdl_tlsf_usable_size(void *ptr);
+
+// ###### REMOTE FREES ######
+// Makes thread_id (SDL_GetCurrentThreadID) the owner of the instance, 0 clears it and drains the queue
+void sdl_tlsf_set_owner(tlsf_instance *instance, Uint64 thread_id);
+
+// Queues ptr for the instance's owner with one CAS, never takes the lock
+// sdl_tlsf_free queues too, but has to take the lock to find out which instance is active
+void sdl_tlsf_remote_free(tlsf_instance *instance, void *ptr);
+
+// Frees everything queued so far, returns how many blocks that was
+size_t sdl_tlsf_drain_remote_frees(tlsf_instance *instance);
+
+// Frees count blocks of the instance under a single lock, NULL entries are skipped
+void sdl_tlsf_free_batch(tlsf_instance *instance, void **ptrs, size_t count);
+
+// ###### PER-CPU CACHES ######
+// Small mallocs and frees (up to SDL_TLSF_CPU_MAX_SIZE) on the instance skip the lock and use the calling
+// CPU's lists, so the memory held scales with CPUs instead of threads. max_depth caps each list
+// use_rseq 0 forces the spinlock fallback. Not available on persistent instances
+void sdl_tlsf_enable_cpu_cache(tlsf_instance *instance, size_t max_depth, int use_rseq);
+
+// Returns every cached block to TLSF, nothing may be allocating from the instance at the same time
+void sdl_tlsf_disable_cpu_cache(tlsf_instance *instance);
+
+// ###### ALLOCATION TAGS ######
+// Until the matching pop, allocations on the calling thread go to the tag's heap inside the active instance,
+// SDL's own allocations included. Tags nest, and tag 0 sends allocations back to the instance itself
+// Frees, reallocs and usable sizes find the heap a block came from on their own
+// Not available on persistent instances
+void sdl_tlsf_push_tag(Uint32 tag);
+void sdl_tlsf_pop_tag(void);
+
+// Tag on top of the calling thread's stack, 0 if there is none
+Uint32 sdl_tlsf_current_tag(void);
+
+// Frees everything allocated under the tag by dropping its pools and huge blocks, without looking at a single block
+// Returns how many mappings went. No thread may still have the tag pushed or use its blocks
+size_t sdl_tlsf_release_tag(tlsf_instance *instance, Uint32 tag);
+
+// Bytes in use under the tag, pools and huge blocks
+size_t sdl_tlsf_tag_used(tlsf_instance *instance, Uint32 tag);
+
+// ###### LIFETIME HINTS ######
+// Transient blocks come from pools of their own (the SDL_TLSF_TAG_TRANSIENT tag heap), so long-lived blocks
+// never pin them and they empty out and get released. Persistent and unhinted blocks share the instance's pools
+// and current tag like sdl_tlsf_malloc. Free them as usual
+void *sdl_tlsf_malloc_hint(size_t bytes, tlsf_lifetime lifetime);
+
+// Allocate from a given instance without making it the active one, for the C++ memory resources
+void *sdl_tlsf_instance_alloc(tlsf_instance *instance, size_t align, size_t bytes);
+
+// bytes is the size the block was requested with, as for sdl_tlsf_free_sized
+void sdl_tlsf_instance_free(tlsf_instance *instance, void *ptr, size_t bytes);
+
 
 // Debugging, returns 0 if no errors
 int sdl_tlsf_check_active_instance();
@@ -117,4 +519,78 @@ int sdl_tlsf_check_pool(pool_t pool);
 // Gets the  pool based on the address of the pointer
 tlsf_pool *sdl_tlsf_get_pool(size_t ptr_addr);
 
+// Huge blocks, mapped individually and resized with mremap
+// align is 0 for the default or a power of two, anything else returns NULL
+void *sdl_tlsf_huge_alloc(tlsf_instance *instance, size_t align, size_t bytes);
+void *sdl_tlsf_huge_realloc(tlsf_instance *instance, tlsf_huge_block *block, size_t bytes);
+int sdl_tlsf_huge_expand(tlsf_instance *instance, tlsf_huge_block *block, size_t bytes);
+void sdl_tlsf_huge_free(tlsf_instance *instance, tlsf_huge_block *block);
+tlsf_huge_block *sdl_tlsf_get_huge_block(tlsf_instance *instance, void *ptr);
+
+// ###### SHARED INSTANCES ######
+// Creates a heap other processes can map, named with shm_open or an anonymous memfd when name is NULL
+// Pass the fd on (fork, SCM_RIGHTS) and open it with sdl_tlsf_shared_open_fd
+tlsf_shared_instance *sdl_tlsf_shared_create(const char *name, size_t bytes);
+tlsf_shared_instance *sdl_tlsf_shared_open(const char *name);
+tlsf_shared_instance *sdl_tlsf_shared_open_fd(int fd);
+
+// Unmaps the heap in this process, the memory lives on until every process closes it (and the name is unlinked)
+void sdl_tlsf_shared_close(tlsf_shared_instance *shared);
+
+// Allocation from the shared heap, any process can free what another allocated
+// A process that dies holding the lock is recovered from when the heap still checks out, otherwise every call after
+// it fails (NULL, or does nothing)
+void *sdl_tlsf_shared_malloc(tlsf_shared_instance *shared, size_t bytes);
+void sdl_tlsf_shared_free(tlsf_shared_instance *shared, void *ptr);
+
+// Pointers only mean something in one process, send these offsets instead
+size_t sdl_tlsf_shared_to_offset(tlsf_shared_instance *shared, const void *ptr);
+void *sdl_tlsf_shared_from_offset(tlsf_shared_instance *shared, size_t offset);
+
+// A single well known object so a process that just mapped the heap can find things in it
+void sdl_tlsf_shared_set_root(tlsf_shared_instance *shared, void *ptr);
+void *sdl_tlsf_shared_get_root(tlsf_shared_instance *shared);
+
+// ###### PERSISTENT INSTANCES ######
+// Creates an instance that lives in one reserved region at a fixed address and can be saved to a file
+// Pools are added inside the region up to max_bytes, there are no huge blocks. address NULL picks a default
+tlsf_instance *sdl_tlsf_create_persistent_instance(size_t pool_size, size_t max_bytes, void *address, const tlsf_variant *variant);
+
+// Writes the instance, its pools and all allocations to path, atomically replacing the last snapshot. 0 on success
+int sdl_tlsf_checkpoint_instance(tlsf_instance *instance, const char *path);
+
+// Maps a snapshot back in, the whole file is read once to check it wasn't torn or corrupted
+// Pointers into the heap stay valid at the saved address, if it's taken only packed heaps can move (use offsets then)
+tlsf_instance *sdl_tlsf_restore_instance(const char *path);
+
+// The object a restored run starts from, kept as an offset so it survives the heap moving
+void sdl_tlsf_persist_set_root(tlsf_instance *instance, void *ptr);
+void *sdl_tlsf_persist_get_root(tlsf_instance *instance);
+
+// ###### SNAPSHOT INSTANCES ######
+// A persistent instance whose region is a private mapping of a memfd, the memfd holds the last snapshot
+// and every page written since is a copy-on-write copy
+tlsf_instance *sdl_tlsf_create_snapshot_instance(size_t pool_size, size_t max_bytes, const tlsf_variant *variant);
+
+// Returned by the snapshot calls below when the page table or the memfd couldn't be read or written
+#define SDL_TLSF_SNAPSHOT_FAILED ((size_t)-1)
+
+// Snapshots the instance, only the pages written since the last snapshot are copied. Returns that page count
+// On failure the heap is left as it is, but there's no snapshot to restore until a clone succeeds
+size_t sdl_tlsf_clone_instance(tlsf_instance *instance);
+
+// Returns the instance to its last snapshot by remapping, pointers from before the snapshot are valid again
+// Returns the number of pages thrown away
+size_t sdl_tlsf_restore_clone(tlsf_instance *instance);
+
+// Pages written since the last snapshot
+size_t sdl_tlsf_dirty_pages(tlsf_instance *instance);
+
+// Looks a variant up by name, NULL if this build doesn't have it
+const tlsf_variant *sdl_tlsf_find_variant(const char *name);
+
+#if defined(__cplusplus)
+};
+#endif
+
 #endif //TLSF_SDL_TLSF_H
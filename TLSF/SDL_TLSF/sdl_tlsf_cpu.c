@@ -0,0 +1,295 @@
+//
+// Created by bee on 10/19/26.
+//
+
+// sched_getcpu is a GNU extension
+#define _GNU_SOURCE
+
+#include "sdl_tlsf_cpu.h"
+
+#include <sched.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 35)
+#include <sys/rseq.h>
+#define SDL_TLSF_HAVE_RSEQ 1
+#else
+#define SDL_TLSF_HAVE_RSEQ 0
+#endif
+
+// One CPU's lists, on their own cache lines so CPUs don't share any
+typedef struct {
+	_Alignas(64) void *heads[SDL_TLSF_CPU_CLASSES];
+	int lock; // Spinlock fallback only
+} tlsf_cpu_slab;
+
+struct tlsf_cpu_cache {
+	int num_cpus;
+	int use_rseq;
+	size_t max_depth;
+	size_t map_size;
+	tlsf_cpu_slab *slabs;
+};
+
+// What a cached block holds
+typedef struct tlsf_cpu_node {
+	struct tlsf_cpu_node *next;
+	size_t depth; // Blocks from here to the end of the list
+} tlsf_cpu_node;
+
+#if SDL_TLSF_HAVE_RSEQ
+
+#define SDL_TLSF_STR2(x) #x
+#define SDL_TLSF_STR(x) SDL_TLSF_STR2(x)
+
+// glibc registers every thread's rseq area, it sits at a fixed offset from the thread pointer
+static struct rseq *sdl_tlsf_rseq_area(void) {
+
+	return (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+}
+
+// The descriptor tells the kernel where the sequence starts, where it commits and where to restart.
+// The abort handler has to be preceded by the signature glibc registered with
+#define SDL_TLSF_RSEQ_CS \
+	".pushsection __rseq_cs, \"aw\"\n\t" \
+	".balign 32\n\t" \
+	"3:\n\t" \
+	".long 0x0, 0x0\n\t" \
+	".quad 1f, (2f - 1f), 4f\n\t" \
+	".popsection\n\t" \
+	"leaq 3b(%%rip), %%rax\n\t" \
+	"movq %%rax, %[rseq_cs]\n\t"
+
+#define SDL_TLSF_RSEQ_ABORT \
+	".pushsection __rseq_failure, \"ax\"\n\t" \
+	".byte 0x0f, 0xb9, 0x3d\n\t" \
+	".long " SDL_TLSF_STR(RSEQ_SIG) "\n\t" \
+	"4:\n\t" \
+	"jmp %l[abort]\n\t" \
+	".popsection\n\t"
+
+// Pops the head of *head if we are still on cpu. 1 with the block in *out, 0 if empty, -1 to retry
+static int sdl_tlsf_rseq_pop(struct rseq *rs, int cpu, void **head, void **out) {
+
+	__asm__ __volatile__ goto (
+		SDL_TLSF_RSEQ_CS
+		"1:\n\t"
+		"cmpl %[cpu], %[cpu_id]\n\t"
+		"jnz %l[abort]\n\t"
+		"movq %[head], %%rbx\n\t"
+		"testq %%rbx, %%rbx\n\t"
+		"jz %l[empty]\n\t"
+		"movq (%%rbx), %%rcx\n\t"
+		"movq %%rcx, %[head]\n\t" // Commit
+		"2:\n\t"
+		"movq %%rbx, (%[out])\n\t"
+		SDL_TLSF_RSEQ_ABORT
+		:
+		: [cpu_id] "m" (rs -> cpu_id), [rseq_cs] "m" (rs -> rseq_cs), [cpu] "r" (cpu),
+		  [head] "m" (*head), [out] "r" (out)
+		: "memory", "cc", "rax", "rbx", "rcx"
+		: abort, empty
+	);
+	return 1;
+
+abort:
+	return -1;
+
+empty:
+	return 0;
+}
+
+// Pushes node onto *head unless that list already holds max_depth blocks. 1 when pushed, 0 if full, -1 to retry
+static int sdl_tlsf_rseq_push(struct rseq *rs, int cpu, void **head, void *node, size_t max_depth) {
+
+	// Writes to node before the commit are harmless if we restart, nobody else can see it yet
+	__asm__ __volatile__ goto (
+		SDL_TLSF_RSEQ_CS
+		"1:\n\t"
+		"cmpl %[cpu], %[cpu_id]\n\t"
+		"jnz %l[abort]\n\t"
+		"movq %[head], %%rbx\n\t"
+		"movq $1, %%rcx\n\t"
+		"testq %%rbx, %%rbx\n\t"
+		"jz 5f\n\t"
+		"movq 8(%%rbx), %%rcx\n\t"
+		"cmpq %[max], %%rcx\n\t"
+		"jae %l[full]\n\t"
+		"addq $1, %%rcx\n\t"
+		"5:\n\t"
+		"movq %%rbx, (%[node])\n\t"
+		"movq %%rcx, 8(%[node])\n\t"
+		"movq %[node], %[head]\n\t" // Commit
+		"2:\n\t"
+		SDL_TLSF_RSEQ_ABORT
+		:
+		: [cpu_id] "m" (rs -> cpu_id), [rseq_cs] "m" (rs -> rseq_cs), [cpu] "r" (cpu),
+		  [head] "m" (*head), [node] "r" (node), [max] "r" (max_depth)
+		: "memory", "cc", "rax", "rbx", "rcx"
+		: abort, full
+	);
+	return 1;
+
+abort:
+	return -1;
+
+full:
+	return 0;
+}
+
+#endif
+
+// The fallback's idea of the current CPU, a stale answer only costs some sharing
+static tlsf_cpu_slab *sdl_tlsf_cpu_lock(tlsf_cpu_cache *cache) {
+
+	int cpu = sched_getcpu();
+	if (cpu < 0 || cpu >= cache -> num_cpus) {
+		cpu = 0;
+	}
+
+	tlsf_cpu_slab *slab = &cache -> slabs[cpu];
+	while (__atomic_exchange_n(&slab -> lock, 1, __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+	return slab;
+}
+
+static void sdl_tlsf_cpu_unlock(tlsf_cpu_slab *slab) {
+
+	__atomic_store_n(&slab -> lock, 0, __ATOMIC_RELEASE);
+}
+
+tlsf_cpu_cache *sdl_tlsf_cpu_cache_create(size_t max_depth, int use_rseq) {
+
+	int num_cpus = get_nprocs_conf();
+	if (num_cpus < 1) {
+		num_cpus = 1;
+	}
+
+	size_t slabs_offset = (sizeof(tlsf_cpu_cache) + 63) & ~(size_t)63;
+	size_t map_size = slabs_offset + (size_t)num_cpus * sizeof(tlsf_cpu_slab);
+
+	void *mem = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+
+	tlsf_cpu_cache *cache = mem;
+	cache -> num_cpus = num_cpus;
+	cache -> max_depth = max_depth;
+	cache -> map_size = map_size;
+	cache -> slabs = (tlsf_cpu_slab *)((char *)mem + slabs_offset);
+	cache -> use_rseq = 0;
+
+#if SDL_TLSF_HAVE_RSEQ
+	// Registration can be turned off with glibc.pthread.rseq=0, or the kernel may not have it
+	if (use_rseq && __rseq_size > 0 && (int)sdl_tlsf_rseq_area() -> cpu_id >= 0) {
+		cache -> use_rseq = 1;
+	}
+#endif
+
+	return cache;
+}
+
+void sdl_tlsf_cpu_cache_destroy(tlsf_cpu_cache *cache) {
+
+	munmap(cache, cache -> map_size);
+}
+
+void *sdl_tlsf_cpu_cache_pop(tlsf_cpu_cache *cache, int size_class) {
+
+#if SDL_TLSF_HAVE_RSEQ
+	if (cache -> use_rseq) {
+		struct rseq *rs = sdl_tlsf_rseq_area();
+		void *node;
+
+		// Only a preemption, signal or migration in the middle sends us around again
+		for (;;) {
+			int cpu = (int)__atomic_load_n(&rs -> cpu_id_start, __ATOMIC_RELAXED);
+			int result = sdl_tlsf_rseq_pop(rs, cpu, &cache -> slabs[cpu].heads[size_class], &node);
+			if (result >= 0) {
+				return result ? node : NULL;
+			}
+		}
+	}
+#endif
+
+	tlsf_cpu_slab *slab = sdl_tlsf_cpu_lock(cache);
+
+	tlsf_cpu_node *node = slab -> heads[size_class];
+	if (node != NULL) {
+		slab -> heads[size_class] = node -> next;
+	}
+
+	sdl_tlsf_cpu_unlock(slab);
+	return node;
+}
+
+int sdl_tlsf_cpu_cache_push(tlsf_cpu_cache *cache, int size_class, void *ptr) {
+
+#if SDL_TLSF_HAVE_RSEQ
+	if (cache -> use_rseq) {
+		struct rseq *rs = sdl_tlsf_rseq_area();
+
+		for (;;) {
+			int cpu = (int)__atomic_load_n(&rs -> cpu_id_start, __ATOMIC_RELAXED);
+			int result = sdl_tlsf_rseq_push(rs, cpu, &cache -> slabs[cpu].heads[size_class], ptr, cache -> max_depth);
+			if (result >= 0) {
+				return result;
+			}
+		}
+	}
+#endif
+
+	tlsf_cpu_slab *slab = sdl_tlsf_cpu_lock(cache);
+
+	tlsf_cpu_node *head = slab -> heads[size_class];
+	size_t depth = head ? head -> depth : 0;
+
+	int pushed = depth < cache -> max_depth;
+	if (pushed) {
+		tlsf_cpu_node *node = ptr;
+		node -> next = head;
+		node -> depth = depth + 1;
+		slab -> heads[size_class] = node;
+	}
+
+	sdl_tlsf_cpu_unlock(slab);
+	return pushed;
+}
+
+void *sdl_tlsf_cpu_cache_take(tlsf_cpu_cache *cache, int cpu, int size_class) {
+
+	void *list = cache -> slabs[cpu].heads[size_class];
+	cache -> slabs[cpu].heads[size_class] = NULL;
+
+	return list;
+}
+
+int sdl_tlsf_cpu_cache_num_cpus(tlsf_cpu_cache *cache) {
+
+	return cache -> num_cpus;
+}
+
+size_t sdl_tlsf_cpu_cache_count(tlsf_cpu_cache *cache) {
+
+	size_t count = 0;
+
+	for (int cpu = 0; cpu < cache -> num_cpus; cpu++) {
+		for (int c = 0; c < SDL_TLSF_CPU_CLASSES; c++) {
+			tlsf_cpu_node *head = __atomic_load_n(&cache -> slabs[cpu].heads[c], __ATOMIC_RELAXED);
+			if (head != NULL) {
+				count += head -> depth;
+			}
+		}
+	}
+	return count;
+}
+
+int sdl_tlsf_cpu_cache_uses_rseq(tlsf_cpu_cache *cache) {
+
+	return cache -> use_rseq;
+}
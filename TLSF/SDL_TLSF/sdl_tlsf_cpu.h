@@ -0,0 +1,54 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_SDL_TLSF_CPU_H
+#define TLSF_SDL_TLSF_CPU_H
+
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Per-CPU free lists of small blocks, one list per size class on every CPU
+// Pushes and pops run as restartable sequences where the kernel and libc support them (x86-64 Linux,
+// glibc 2.35+), so they never lock and never need a CAS. Anywhere else each CPU's lists sit behind a spinlock
+// Cached blocks are linked through their first word and keep the list depth in their second
+
+// Requests up to 256 bytes are cached, in 16 byte classes
+#define SDL_TLSF_CPU_CLASS_SHIFT 4
+#define SDL_TLSF_CPU_CLASSES 17
+#define SDL_TLSF_CPU_MAX_SIZE ((size_t)(SDL_TLSF_CPU_CLASSES - 1) << SDL_TLSF_CPU_CLASS_SHIFT)
+
+// Blocks a miss takes from TLSF at once, the extras go on the list
+#define SDL_TLSF_CPU_REFILL 8
+
+typedef struct tlsf_cpu_cache tlsf_cpu_cache;
+
+// max_depth is the most blocks one CPU keeps per class, use_rseq 0 forces the spinlock fallback
+tlsf_cpu_cache *sdl_tlsf_cpu_cache_create(size_t max_depth, int use_rseq);
+void sdl_tlsf_cpu_cache_destroy(tlsf_cpu_cache *cache);
+
+// A block from the calling CPU's list, NULL if it's empty
+void *sdl_tlsf_cpu_cache_pop(tlsf_cpu_cache *cache, int size_class);
+
+// Puts ptr on the calling CPU's list, 0 if that list is full
+int sdl_tlsf_cpu_cache_push(tlsf_cpu_cache *cache, int size_class, void *ptr);
+
+// Unlinks a whole list from any CPU. Nothing may be using the cache at the same time
+void *sdl_tlsf_cpu_cache_take(tlsf_cpu_cache *cache, int cpu, int size_class);
+
+int sdl_tlsf_cpu_cache_num_cpus(tlsf_cpu_cache *cache);
+
+// Blocks held by every list, read without stopping anyone so it's only a snapshot
+size_t sdl_tlsf_cpu_cache_count(tlsf_cpu_cache *cache);
+
+// 1 if the lists run on restartable sequences, 0 on the spinlock fallback
+int sdl_tlsf_cpu_cache_uses_rseq(tlsf_cpu_cache *cache);
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif //TLSF_SDL_TLSF_CPU_H
@@ -0,0 +1,375 @@
+//
+// Created by bee on 10/19/26.
+//
+
+// mremap is a GNU extension
+#define _GNU_SOURCE
+
+#include "sdl_tlsf_epoch.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+#define SDL_TLSF_EPOCH_INITIAL_ENTRIES 1024
+
+// A block waiting out the readers
+typedef struct {
+	void *ptr;
+	tlsf_instance *instance;
+	Uint64 epoch; // Global epoch when it was retired
+	size_t bytes;
+} tlsf_epoch_entry;
+
+// One per thread, records are never unmapped, a thread that exits leaves its record for the next one
+typedef struct tlsf_epoch_record {
+
+	// (epoch << 1) | active, read by every thread trying to advance so it gets a cache line to itself
+	_Alignas(64) Uint64 state;
+	int in_use;
+
+	_Alignas(64) int nesting;
+	size_t limit;
+
+	// Oldest first, entries[first] up to entries[count]
+	tlsf_epoch_entry *entries;
+	size_t first;
+	size_t count;
+	size_t capacity;
+
+	// Written by the owner only, read by sdl_tlsf_epoch_get_stats
+	size_t pending_bytes;
+	size_t peak_pending_bytes;
+	size_t retired;
+	size_t reclaimed;
+	size_t overruns;
+
+	struct tlsf_epoch_record *next;
+
+} tlsf_epoch_record;
+
+static Uint64 global_epoch = 2;
+static size_t epoch_advances = 0;
+static tlsf_epoch_record *epoch_records = NULL;
+
+static _Thread_local tlsf_epoch_record *epoch_record = NULL;
+
+static pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t epoch_key;
+
+// Drains record and gives it up, from the thread that owns it
+static void sdl_tlsf_epoch_release_record(tlsf_epoch_record *record);
+
+static void sdl_tlsf_epoch_destructor(void *record) {
+
+	sdl_tlsf_epoch_release_record(record);
+}
+
+static void sdl_tlsf_epoch_make_key(void) {
+
+	pthread_key_create(&epoch_key, sdl_tlsf_epoch_destructor);
+}
+
+// The calling thread's record, picking up a free one or mapping a new one the first time
+static tlsf_epoch_record *sdl_tlsf_epoch_get_record(void) {
+
+	if (epoch_record != NULL) {
+		return epoch_record;
+	}
+
+	tlsf_epoch_record *record = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE);
+	while (record != NULL) {
+		int expected = 0;
+		if (__atomic_compare_exchange_n(&record -> in_use, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			break;
+		}
+		record = record -> next;
+	}
+
+	if (record == NULL) {
+		record = mmap(NULL, sizeof(tlsf_epoch_record), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (record == MAP_FAILED) {
+			SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to map an epoch record\n");
+			return NULL;
+		}
+		record -> in_use = 1;
+
+		record -> next = __atomic_load_n(&epoch_records, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&epoch_records, &record -> next, record, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+
+	// Whatever the last owner left behind was drained before it gave the record up
+	record -> nesting = 0;
+	record -> limit = SDL_TLSF_EPOCH_DEFAULT_LIMIT;
+	record -> peak_pending_bytes = 0;
+
+	pthread_once(&epoch_key_once, sdl_tlsf_epoch_make_key);
+	pthread_setspecific(epoch_key, record);
+
+	epoch_record = record;
+	return record;
+}
+
+// Moves the epoch on if every thread in a critical section has seen the current one
+static void sdl_tlsf_epoch_try_advance(void) {
+
+	Uint64 epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+	for (tlsf_epoch_record *record = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE); record; record = record -> next) {
+		Uint64 state = __atomic_load_n(&record -> state, __ATOMIC_SEQ_CST);
+		if ((state & 1) && (state >> 1) != epoch) {
+			return;
+		}
+	}
+
+	if (__atomic_compare_exchange_n(&global_epoch, &epoch, epoch + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		__atomic_fetch_add(&epoch_advances, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// Hands a run of blocks back to their instance, which stops counting them as retired
+static void sdl_tlsf_epoch_flush(tlsf_instance *instance, void **batch, size_t count) {
+
+	sdl_tlsf_free_batch(instance, batch, count);
+	__atomic_fetch_sub(&instance -> retired_pending, count, __ATOMIC_RELEASE);
+}
+
+// Frees the entries two epochs old, a reader can lag the global epoch by one but never by two
+static size_t sdl_tlsf_epoch_collect(tlsf_epoch_record *record) {
+
+	sdl_tlsf_epoch_try_advance();
+
+	Uint64 epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+	size_t freed = 0;
+	size_t bytes = 0;
+
+	void *batch[SDL_TLSF_EPOCH_BATCH];
+	size_t batch_count = 0;
+	tlsf_instance *batch_instance = NULL;
+
+	while (record -> first < record -> count && record -> entries[record -> first].epoch + 2 <= epoch) {
+		tlsf_epoch_entry *entry = &record -> entries[record -> first];
+
+		// Runs of the same instance go through the lock together
+		if (batch_count == SDL_TLSF_EPOCH_BATCH || (batch_count > 0 && entry -> instance != batch_instance)) {
+			sdl_tlsf_epoch_flush(batch_instance, batch, batch_count);
+			batch_count = 0;
+		}
+
+		batch_instance = entry -> instance;
+		batch[batch_count++] = entry -> ptr;
+		bytes += entry -> bytes;
+
+		record -> first++;
+		freed++;
+	}
+
+	if (batch_count > 0) {
+		sdl_tlsf_epoch_flush(batch_instance, batch, batch_count);
+	}
+
+	if (record -> first == record -> count) {
+		record -> first = 0;
+		record -> count = 0;
+	}
+
+	__atomic_store_n(&record -> pending_bytes, record -> pending_bytes - bytes, __ATOMIC_RELAXED);
+	__atomic_store_n(&record -> reclaimed, record -> reclaimed + freed, __ATOMIC_RELAXED);
+	return freed;
+}
+
+// Makes room for one more entry, sliding the live ones down before growing the mapping
+static int sdl_tlsf_epoch_reserve(tlsf_epoch_record *record) {
+
+	if (record -> count < record -> capacity) {
+		return 1;
+	}
+
+	if (record -> capacity > 0 && record -> first >= record -> capacity / 2) {
+		memmove(record -> entries, record -> entries + record -> first, (record -> count - record -> first) * sizeof(tlsf_epoch_entry));
+		record -> count -= record -> first;
+		record -> first = 0;
+		return 1;
+	}
+
+	size_t capacity = record -> capacity ? record -> capacity * 2 : SDL_TLSF_EPOCH_INITIAL_ENTRIES;
+	void *entries;
+
+	if (record -> entries == NULL) {
+		entries = mmap(NULL, capacity * sizeof(tlsf_epoch_entry), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	} else {
+		entries = mremap(record -> entries, record -> capacity * sizeof(tlsf_epoch_entry), capacity * sizeof(tlsf_epoch_entry), MREMAP_MAYMOVE);
+	}
+
+	if (entries == MAP_FAILED) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "Failed to grow the retired list to %zu entries\n", capacity);
+		return 0;
+	}
+
+	record -> entries = entries;
+	record -> capacity = capacity;
+	return 1;
+}
+
+void sdl_tlsf_epoch_enter(void) {
+
+	tlsf_epoch_record *record = sdl_tlsf_epoch_get_record();
+
+	if (record -> nesting++ == 0) {
+		Uint64 epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+		__atomic_store_n(&record -> state, (epoch << 1) | 1, __ATOMIC_RELAXED);
+
+		// The announcement has to be visible before anything the critical section reads
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+}
+
+void sdl_tlsf_epoch_leave(void) {
+
+	tlsf_epoch_record *record = epoch_record;
+
+	if (--record -> nesting == 0) {
+		__atomic_store_n(&record -> state, record -> state & ~(Uint64)1, __ATOMIC_RELEASE);
+	}
+}
+
+void sdl_tlsf_retire(void *ptr) {
+
+	sdl_tlsf_retire_from(sdl_tlsf_get_instance(), ptr);
+}
+
+void sdl_tlsf_retire_from(tlsf_instance *instance, void *ptr) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	tlsf_epoch_record *record = sdl_tlsf_epoch_get_record();
+
+	// No room to defer it, leaking would be worse than waiting for the readers right here
+	if (!sdl_tlsf_epoch_reserve(record)) {
+		sdl_tlsf_epoch_barrier();
+		if (!sdl_tlsf_epoch_reserve(record)) {
+			return;
+		}
+	}
+
+	// Read without the lock, huge blocks sit behind zeroed padding and count as the smallest they can be
+	size_t bytes = instance -> variant -> block_size(ptr);
+	if (bytes == 0) {
+		bytes = instance -> huge_threshold;
+	}
+
+	tlsf_epoch_entry *entry = &record -> entries[record -> count++];
+	entry -> ptr = ptr;
+	entry -> instance = instance;
+	entry -> epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+	entry -> bytes = bytes;
+	__atomic_fetch_add(&instance -> retired_pending, 1, __ATOMIC_RELAXED);
+
+	size_t pending_bytes = record -> pending_bytes + bytes;
+	__atomic_store_n(&record -> pending_bytes, pending_bytes, __ATOMIC_RELAXED);
+	__atomic_store_n(&record -> retired, record -> retired + 1, __ATOMIC_RELAXED);
+	if (pending_bytes > record -> peak_pending_bytes) {
+		__atomic_store_n(&record -> peak_pending_bytes, pending_bytes, __ATOMIC_RELAXED);
+	}
+
+	if (record -> retired % SDL_TLSF_EPOCH_BATCH == 0) {
+		sdl_tlsf_epoch_collect(record);
+	}
+
+	if (record -> pending_bytes <= record -> limit) {
+		return;
+	}
+
+	sdl_tlsf_epoch_collect(record);
+
+	// Waiting inside a critical section would hold the epoch back and never finish
+	if (record -> nesting > 0) {
+		if (record -> pending_bytes > record -> limit) {
+			__atomic_store_n(&record -> overruns, record -> overruns + 1, __ATOMIC_RELAXED);
+		}
+		return;
+	}
+
+	while (record -> pending_bytes > record -> limit) {
+		sched_yield();
+		sdl_tlsf_epoch_collect(record);
+	}
+}
+
+size_t sdl_tlsf_epoch_reclaim(void) {
+
+	return sdl_tlsf_epoch_collect(sdl_tlsf_epoch_get_record());
+}
+
+void sdl_tlsf_epoch_barrier(void) {
+
+	tlsf_epoch_record *record = sdl_tlsf_epoch_get_record();
+
+	if (record -> nesting > 0) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "sdl_tlsf_epoch_barrier called inside a critical section\n");
+		return;
+	}
+
+	sdl_tlsf_epoch_collect(record);
+	while (record -> first < record -> count) {
+		sched_yield();
+		sdl_tlsf_epoch_collect(record);
+	}
+}
+
+void sdl_tlsf_epoch_set_limit(size_t bytes) {
+
+	sdl_tlsf_epoch_get_record() -> limit = bytes;
+}
+
+void sdl_tlsf_epoch_get_stats(tlsf_epoch_stats *stats) {
+
+	memset(stats, 0, sizeof(tlsf_epoch_stats));
+
+	stats -> epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+	stats -> advances = __atomic_load_n(&epoch_advances, __ATOMIC_RELAXED);
+
+	// Other threads keep going while we add up, the totals are a snapshot
+	for (tlsf_epoch_record *record = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE); record; record = record -> next) {
+
+		if (__atomic_load_n(&record -> in_use, __ATOMIC_RELAXED)) {
+			stats -> threads++;
+		}
+
+		size_t retired = __atomic_load_n(&record -> retired, __ATOMIC_RELAXED);
+		size_t reclaimed = __atomic_load_n(&record -> reclaimed, __ATOMIC_RELAXED);
+		size_t peak = __atomic_load_n(&record -> peak_pending_bytes, __ATOMIC_RELAXED);
+
+		stats -> retired += retired;
+		stats -> reclaimed += reclaimed;
+		stats -> pending += retired - reclaimed;
+		stats -> pending_bytes += __atomic_load_n(&record -> pending_bytes, __ATOMIC_RELAXED);
+		stats -> overruns += __atomic_load_n(&record -> overruns, __ATOMIC_RELAXED);
+
+		if (peak > stats -> peak_pending_bytes) {
+			stats -> peak_pending_bytes = peak;
+		}
+	}
+}
+
+void sdl_tlsf_epoch_thread_exit(void) {
+
+	if (epoch_record != NULL) {
+		sdl_tlsf_epoch_release_record(epoch_record);
+	}
+}
+
+static void sdl_tlsf_epoch_release_record(tlsf_epoch_record *record) {
+
+	// A thread can exit from inside a critical section, it isn't reading anything any more
+	record -> nesting = 0;
+	__atomic_store_n(&record -> state, record -> state & ~(Uint64)1, __ATOMIC_RELEASE);
+
+	sdl_tlsf_epoch_barrier();
+
+	pthread_setspecific(epoch_key, NULL);
+	epoch_record = NULL;
+
+	__atomic_store_n(&record -> in_use, 0, __ATOMIC_RELEASE);
+}
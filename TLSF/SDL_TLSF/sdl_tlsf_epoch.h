@@ -0,0 +1,68 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_SDL_TLSF_EPOCH_H
+#define TLSF_SDL_TLSF_EPOCH_H
+
+#include "sdl_tlsf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Epoch based reclamation for lock-free structures
+// Readers wrap every access in sdl_tlsf_epoch_enter/leave. A writer that unlinks a node retires it instead of
+// freeing it, and it's freed once every thread that was inside an epoch at the time has left it
+// Each thread keeps its own retired list and frees it in batches, through sdl_tlsf_free_batch
+
+// Retires between attempts to advance the epoch and reclaim
+#define SDL_TLSF_EPOCH_BATCH 64
+
+// Per thread bound on retired bytes before retire starts waiting for readers
+#define SDL_TLSF_EPOCH_DEFAULT_LIMIT ((size_t)(1 << 20) * 4)
+
+typedef struct {
+
+	Uint64 epoch;
+	int threads; // Registered with the domain right now
+
+	size_t retired;
+	size_t reclaimed;
+	size_t pending; // Retired and not freed yet
+	size_t pending_bytes;
+	size_t peak_pending_bytes; // Highest any single thread got to
+
+	size_t advances;
+	size_t overruns; // Retires over the limit inside a critical section, which can't wait
+
+} tlsf_epoch_stats;
+
+// Critical sections nest, pointers read from a lock-free structure are only valid until the outermost leave
+void sdl_tlsf_epoch_enter(void);
+void sdl_tlsf_epoch_leave(void);
+
+// Frees ptr (from the active instance) once no reader can still hold it. Call after unlinking it
+void sdl_tlsf_retire(void *ptr);
+void sdl_tlsf_retire_from(tlsf_instance *instance, void *ptr);
+
+// Advances the epoch if every reader has caught up and frees what that made safe, returns the block count
+size_t sdl_tlsf_epoch_reclaim(void);
+
+// Waits until everything this thread retired is freed. Not from inside a critical section
+void sdl_tlsf_epoch_barrier(void);
+
+// Retired bytes the calling thread may hold. Over it, retire reclaims and waits for readers outside
+// a critical section, inside one it counts an overrun and carries on
+void sdl_tlsf_epoch_set_limit(size_t bytes);
+
+void sdl_tlsf_epoch_get_stats(tlsf_epoch_stats *stats);
+
+// Drains the calling thread's list and gives its slot up, runs on its own when the thread exits
+void sdl_tlsf_epoch_thread_exit(void);
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif //TLSF_SDL_TLSF_EPOCH_H
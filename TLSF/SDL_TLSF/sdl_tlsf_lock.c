@@ -0,0 +1,195 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#include "sdl_tlsf_lock.h"
+
+#include <string.h>
+
+static tlsf_lock_stats lock_stats;
+
+static const char *const lock_site_names[SDL_TLSF_LOCK_SITES] = {
+	"malloc", "calloc", "realloc", "aligned", "free", "usable_size", "get_pool", "add_pool", "free_pool",
+	"huge", "tag", "profile", "depot", "persist", "instance"
+};
+
+#ifdef SDL_TLSF_LOCK_STATS
+
+// How deep the calling thread is in the lock, and when and where its outermost acquisition happened
+static _Thread_local int lock_depth = 0;
+static _Thread_local tlsf_lock_site lock_owner_site;
+static _Thread_local Uint64 lock_since;
+
+static int sdl_tlsf_lock_bucket(Uint64 ns) {
+
+	if (ns == 0) {
+		return 0;
+	}
+
+	int bucket = 64 - __builtin_clzll(ns);
+
+	return bucket < SDL_TLSF_LOCK_BUCKETS ? bucket : SDL_TLSF_LOCK_BUCKETS - 1;
+}
+
+void sdl_tlsf_lock_acquire(SDL_Mutex *lock, tlsf_lock_site site) {
+
+	// Before init and after quit there's no lock to count
+	if (lock == NULL) {
+		return;
+	}
+
+	tlsf_lock_site_stats *stats = &lock_stats.sites[site];
+
+	// The mutex is recursive, we already own it so this can't wait
+	if (lock_depth > 0) {
+		SDL_LockMutex(lock);
+		lock_depth++;
+		stats -> acquisitions++;
+		stats -> nested++;
+		return;
+	}
+
+	// Only a failed try pays for the clock
+	Uint64 wait = 0;
+	int contended = SDL_TryLockMutex(lock) != 0;
+
+	if (contended) {
+		Uint64 start = SDL_GetTicksNS();
+		SDL_LockMutex(lock);
+		wait = SDL_GetTicksNS() - start;
+	}
+
+	lock_depth = 1;
+	lock_owner_site = site;
+	lock_since = SDL_GetTicksNS();
+
+	stats -> acquisitions++;
+
+	if (contended) {
+		stats -> contended++;
+		stats -> wait_ns += wait;
+		stats -> wait_histogram[sdl_tlsf_lock_bucket(wait)]++;
+
+		if (wait > stats -> max_wait_ns) {
+			stats -> max_wait_ns = wait;
+		}
+	}
+}
+
+void sdl_tlsf_lock_release(SDL_Mutex *lock) {
+
+	if (lock == NULL) {
+		return;
+	}
+
+	// Still held by the outer acquisition
+	if (--lock_depth > 0) {
+		SDL_UnlockMutex(lock);
+		return;
+	}
+
+	tlsf_lock_site_stats *stats = &lock_stats.sites[lock_owner_site];
+	Uint64 hold = SDL_GetTicksNS() - lock_since;
+
+	stats -> hold_ns += hold;
+	stats -> hold_histogram[sdl_tlsf_lock_bucket(hold)]++;
+
+	if (hold > stats -> max_hold_ns) {
+		stats -> max_hold_ns = hold;
+	}
+
+	SDL_UnlockMutex(lock);
+}
+
+#endif
+
+void sdl_tlsf_lock_copy_stats(tlsf_lock_stats *stats) {
+
+	*stats = lock_stats;
+
+#ifdef SDL_TLSF_LOCK_STATS
+	stats -> enabled = 1;
+#endif
+}
+
+void sdl_tlsf_lock_clear_stats(void) {
+
+	memset(&lock_stats, 0, sizeof(lock_stats));
+}
+
+const char *sdl_tlsf_lock_site_name(tlsf_lock_site site) {
+
+	return site < SDL_TLSF_LOCK_SITES ? lock_site_names[site] : "unknown";
+}
+
+Uint64 sdl_tlsf_lock_percentile(const Uint64 *histogram, double fraction) {
+
+	Uint64 total = 0;
+
+	for (int i = 0; i < SDL_TLSF_LOCK_BUCKETS; i++) {
+		total += histogram[i];
+	}
+
+	if (total == 0) {
+		return 0;
+	}
+
+	// Walk up until the bucket that crosses the wanted rank
+	Uint64 rank = (Uint64)(fraction * (double)total);
+	Uint64 seen = 0;
+
+	for (int i = 0; i < SDL_TLSF_LOCK_BUCKETS; i++) {
+		seen += histogram[i];
+
+		if (seen > rank || i == SDL_TLSF_LOCK_BUCKETS - 1) {
+			return i == 0 ? 1 : (Uint64)1 << i;
+		}
+	}
+
+	return 0;
+}
+
+void sdl_tlsf_lock_print_stats(const tlsf_lock_stats *stats) {
+
+	if (!stats -> enabled) {
+		return;
+	}
+
+	Uint64 total = 0;
+	Uint64 contended = 0;
+
+	for (int i = 0; i < SDL_TLSF_LOCK_SITES; i++) {
+		total += stats -> sites[i].acquisitions;
+		contended += stats -> sites[i].contended;
+	}
+
+	SDL_Log("tlsf_lock: %llu acquisitions, %llu contended (%.2f%%)\n", (unsigned long long)total,
+			(unsigned long long)contended, total ? 100.0 * (double)contended / (double)total : 0.0);
+
+	for (int i = 0; i < SDL_TLSF_LOCK_SITES; i++) {
+
+		const tlsf_lock_site_stats *site = &stats -> sites[i];
+
+		if (site -> acquisitions == 0) {
+			continue;
+		}
+
+		Uint64 outer = site -> acquisitions - site -> nested;
+		char wait[96] = "no waits";
+
+		if (site -> contended) {
+			SDL_snprintf(wait, sizeof(wait), "wait avg %llu p99 <%llu max %llu ns",
+					(unsigned long long)(site -> wait_ns / site -> contended),
+					(unsigned long long)sdl_tlsf_lock_percentile(site -> wait_histogram, 0.99),
+					(unsigned long long)site -> max_wait_ns);
+		}
+
+		SDL_Log("  %-11s %10llu taken, %8llu contended, %8llu nested | %s | hold avg %llu p50 <%llu p99 <%llu max %llu ns\n",
+				lock_site_names[i], (unsigned long long)site -> acquisitions, (unsigned long long)site -> contended,
+				(unsigned long long)site -> nested, wait,
+				(unsigned long long)(outer ? site -> hold_ns / outer : 0),
+				(unsigned long long)sdl_tlsf_lock_percentile(site -> hold_histogram, 0.50),
+				(unsigned long long)sdl_tlsf_lock_percentile(site -> hold_histogram, 0.99),
+				(unsigned long long)site -> max_hold_ns);
+	}
+}
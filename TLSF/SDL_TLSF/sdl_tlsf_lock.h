@@ -0,0 +1,89 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_SDL_TLSF_LOCK_H
+#define TLSF_SDL_TLSF_LOCK_H
+
+#include "../SDL/include/SDL3/SDL.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Instrumented wrapper around tlsf_lock. Built with SDL_TLSF_LOCK_STATS every acquisition is counted against the
+// call site that took it, contended ones are timed while they wait and the outermost one of each thread is timed
+// until it lets go. Without it the wrappers are plain SDL_LockMutex / SDL_UnlockMutex and the stats stay zero
+// Every counter is written while holding the lock, so none of them need to be atomic
+
+// Who took the lock, nested acquisitions count against the inner site and their hold time against the outer one
+typedef enum {
+	SDL_TLSF_LOCK_MALLOC,
+	SDL_TLSF_LOCK_CALLOC,
+	SDL_TLSF_LOCK_REALLOC,
+	SDL_TLSF_LOCK_ALIGNED,
+	SDL_TLSF_LOCK_FREE,
+	SDL_TLSF_LOCK_USABLE_SIZE,
+	SDL_TLSF_LOCK_GET_POOL,
+	SDL_TLSF_LOCK_ADD_POOL,
+	SDL_TLSF_LOCK_FREE_POOL,
+	SDL_TLSF_LOCK_HUGE,
+	SDL_TLSF_LOCK_TAG,
+	SDL_TLSF_LOCK_PROFILE,
+	SDL_TLSF_LOCK_DEPOT,
+	SDL_TLSF_LOCK_PERSIST,
+	SDL_TLSF_LOCK_INSTANCE, // Instance setup, settings, checks and stats
+	SDL_TLSF_LOCK_SITES
+} tlsf_lock_site;
+
+// Bucket 0 counts times under 1 ns, bucket i times in [2^(i-1), 2^i) ns and the last one everything from ~1 s up
+#define SDL_TLSF_LOCK_BUCKETS 32
+
+typedef struct {
+
+	Uint64 acquisitions; // Including nested ones
+	Uint64 contended; // Had to wait for another thread
+	Uint64 nested; // Taken by a thread that already held it
+
+	Uint64 wait_ns; // Total over the contended acquisitions
+	Uint64 max_wait_ns;
+	Uint64 hold_ns; // Total over the outermost acquisitions
+	Uint64 max_hold_ns;
+
+	Uint64 wait_histogram[SDL_TLSF_LOCK_BUCKETS]; // Contended acquisitions only
+	Uint64 hold_histogram[SDL_TLSF_LOCK_BUCKETS]; // Outermost acquisitions only
+
+} tlsf_lock_site_stats;
+
+typedef struct {
+
+	int enabled; // 0 when built without SDL_TLSF_LOCK_STATS
+	tlsf_lock_site_stats sites[SDL_TLSF_LOCK_SITES];
+
+} tlsf_lock_stats;
+
+#ifdef SDL_TLSF_LOCK_STATS
+void sdl_tlsf_lock_acquire(SDL_Mutex *lock, tlsf_lock_site site);
+void sdl_tlsf_lock_release(SDL_Mutex *lock);
+#else
+#define sdl_tlsf_lock_acquire(lock, site) SDL_LockMutex(lock)
+#define sdl_tlsf_lock_release(lock) SDL_UnlockMutex(lock)
+#endif
+
+// The lock has to be held for these two, sdl_tlsf_get_lock_stats and sdl_tlsf_reset_lock_stats take it
+void sdl_tlsf_lock_copy_stats(tlsf_lock_stats *stats);
+void sdl_tlsf_lock_clear_stats(void);
+
+const char *sdl_tlsf_lock_site_name(tlsf_lock_site site);
+
+// Upper bound of the bucket holding the given fraction (0 to 1) of a histogram, 0 for an empty one
+Uint64 sdl_tlsf_lock_percentile(const Uint64 *histogram, double fraction);
+
+// One line per site that took the lock, nothing when built without SDL_TLSF_LOCK_STATS
+void sdl_tlsf_lock_print_stats(const tlsf_lock_stats *stats);
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif //TLSF_SDL_TLSF_LOCK_H
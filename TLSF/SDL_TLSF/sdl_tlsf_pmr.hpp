@@ -0,0 +1,235 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_SDL_TLSF_PMR_HPP
+#define TLSF_SDL_TLSF_PMR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+#include "sdl_tlsf.h"
+
+// Routes C++ containers to a TLSF instance without touching the active instance:
+//
+//	sdl_tlsf::instance_resource level_memory(level_instance);
+//	std::pmr::vector<Entity> entities(&level_memory);
+//
+//	sdl_tlsf::allocator<Particle> particle_alloc(&level_memory);
+//	std::vector<Particle, sdl_tlsf::allocator<Particle>> particles(particle_alloc);
+
+namespace sdl_tlsf {
+
+// Thread safe, every call goes through the SDL_TLSF lock
+class instance_resource final : public std::pmr::memory_resource {
+
+public:
+	explicit instance_resource(tlsf_instance *instance) noexcept : instance_(instance) {}
+
+	tlsf_instance *instance() const noexcept { return instance_; }
+
+private:
+	void *do_allocate(std::size_t bytes, std::size_t align) override {
+
+		void *ptr = sdl_tlsf_instance_alloc(instance_, align, bytes);
+		if (ptr == nullptr) {
+			throw std::bad_alloc();
+		}
+		return ptr;
+	}
+
+	// The container hands the size back, which spares huge blocks the pool walk
+	void do_deallocate(void *ptr, std::size_t bytes, std::size_t /*align*/) override {
+
+		sdl_tlsf_instance_free(instance_, ptr, bytes);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+
+		const instance_resource *resource = dynamic_cast<const instance_resource *>(&other);
+		return resource != nullptr && resource -> instance_ == instance_;
+	}
+
+	tlsf_instance *instance_;
+};
+
+// A private TLSF heap on chunks taken from an upstream resource, with no locking at all
+// Only for containers that stay on one thread. The chunks go back upstream on release() or destruction
+class unsynchronized_resource final : public std::pmr::memory_resource {
+
+public:
+	explicit unsynchronized_resource(std::size_t chunk_size = (1 << 20) * 4,
+									 std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+		: upstream_(upstream), chunk_size_(chunk_size) {}
+
+	unsynchronized_resource(const unsynchronized_resource &) = delete;
+	unsynchronized_resource &operator=(const unsynchronized_resource &) = delete;
+
+	~unsynchronized_resource() override { release(); }
+
+	// Frees everything at once, outstanding allocations become invalid
+	void release() noexcept {
+
+		while (chunks_ != nullptr) {
+			chunk *next = chunks_ -> next;
+			upstream_ -> deallocate(chunks_, chunks_ -> bytes, tlsf_align_size());
+			chunks_ = next;
+		}
+		tlsf_ = nullptr;
+	}
+
+	std::pmr::memory_resource *upstream_resource() const noexcept { return upstream_; }
+
+private:
+	// Sits at the start of every chunk
+	struct alignas(std::max_align_t) chunk {
+		chunk *next;
+		std::size_t bytes;
+	};
+
+	// A chunk whose pool is sure to serve bytes at align. The first chunk also holds the control structure
+	pool_t add_chunk(std::size_t bytes, std::size_t align) {
+
+		// Searches round the request up to the next list, the pool's one free block has to reach that
+		std::size_t fit = tlsf_fit_size(bytes, align);
+		if (fit == 0) {
+			throw std::bad_alloc();
+		}
+
+		std::size_t needed = sizeof(chunk) + fit + tlsf_pool_overhead();
+		if (tlsf_ == nullptr) {
+			needed += tlsf_size();
+		}
+
+		std::size_t chunk_bytes = needed > chunk_size_ ? needed : chunk_size_;
+		chunk_bytes = (chunk_bytes + tlsf_align_size() - 1) & ~(tlsf_align_size() - 1);
+
+		chunk *mem = static_cast<chunk *>(upstream_ -> allocate(chunk_bytes, tlsf_align_size()));
+		mem -> next = chunks_;
+		mem -> bytes = chunk_bytes;
+		chunks_ = mem;
+
+		pool_t pool;
+		if (tlsf_ == nullptr) {
+			tlsf_ = tlsf_create_with_pool(mem + 1, chunk_bytes - sizeof(chunk));
+			pool = tlsf_ ? tlsf_get_pool(tlsf_) : nullptr;
+		} else {
+			pool = tlsf_add_pool(tlsf_, mem + 1, chunk_bytes - sizeof(chunk));
+		}
+
+		if (pool == nullptr) {
+			remove_chunk(nullptr);
+			throw std::bad_alloc();
+		}
+		return pool;
+	}
+
+	// Gives the newest chunk back upstream, pool is its pool or nullptr if it never became one
+	void remove_chunk(pool_t pool) noexcept {
+
+		// The control structure lives in the first chunk, nothing else is left to keep
+		if (chunks_ -> next == nullptr) {
+			release();
+			return;
+		}
+
+		if (pool != nullptr) {
+			tlsf_remove_pool(tlsf_, pool);
+		}
+
+		chunk *next = chunks_ -> next;
+		upstream_ -> deallocate(chunks_, chunks_ -> bytes, tlsf_align_size());
+		chunks_ = next;
+	}
+
+	void *try_allocate(std::size_t bytes, std::size_t align) noexcept {
+
+		if (tlsf_ == nullptr) {
+			return nullptr;
+		}
+		return align <= tlsf_align_size() ? tlsf_malloc(tlsf_, bytes) : tlsf_memalign(tlsf_, align, bytes);
+	}
+
+	void *do_allocate(std::size_t bytes, std::size_t align) override {
+
+		void *ptr = try_allocate(bytes, align);
+		if (ptr == nullptr) {
+			pool_t pool = add_chunk(bytes, align);
+			ptr = try_allocate(bytes, align);
+			if (ptr == nullptr) {
+				remove_chunk(pool);
+				throw std::bad_alloc();
+			}
+		}
+		return ptr;
+	}
+
+	void do_deallocate(void *ptr, std::size_t /*bytes*/, std::size_t /*align*/) override {
+
+		tlsf_free(tlsf_, ptr);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+
+		return this == &other;
+	}
+
+	std::pmr::memory_resource *upstream_;
+	std::size_t chunk_size_;
+	tlsf_t tlsf_ = nullptr;
+	chunk *chunks_ = nullptr;
+};
+
+// STL allocator over one of the resources above. Unlike std::pmr::polymorphic_allocator it knows the
+// concrete resource type, so the calls aren't virtual, and it moves and copies along with its container
+template <typename T, typename Resource = instance_resource>
+class allocator {
+
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	explicit allocator(Resource *resource) noexcept : resource_(resource) {}
+
+	template <typename U>
+	allocator(const allocator<U, Resource> &other) noexcept : resource_(other.resource()) {}
+
+	T *allocate(std::size_t n) {
+
+		if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+			throw std::bad_array_new_length();
+		}
+		return static_cast<T *>(resource_ -> allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *ptr, std::size_t n) noexcept {
+
+		resource_ -> deallocate(ptr, n * sizeof(T), alignof(T));
+	}
+
+	Resource *resource() const noexcept { return resource_; }
+
+private:
+	Resource *resource_;
+};
+
+template <typename T, typename U, typename Resource>
+bool operator==(const allocator<T, Resource> &a, const allocator<U, Resource> &b) noexcept {
+
+	return a.resource() == b.resource() || a.resource() -> is_equal(*b.resource());
+}
+
+template <typename T, typename U, typename Resource>
+bool operator!=(const allocator<T, Resource> &a, const allocator<U, Resource> &b) noexcept {
+
+	return !(a == b);
+}
+
+} // namespace sdl_tlsf
+
+#endif //TLSF_SDL_TLSF_PMR_HPP
@@ -0,0 +1,495 @@
+//
+// Created by bee on 10/19/26.
+//
+
+// dladdr is a GNU extension
+#define _GNU_SOURCE
+
+#include "sdl_tlsf_profile.h"
+#include "sdl_tlsf.h"
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// Sample slots, twice the live samples so probe runs stay short
+#define SDL_TLSF_PROFILE_SLOT_BITS 17
+#define SDL_TLSF_PROFILE_SLOTS ((size_t)1 << SDL_TLSF_PROFILE_SLOT_BITS)
+
+// Live samples per pointer hash, a free only takes the lock when its counter is set
+#define SDL_TLSF_PROFILE_FILTER_BITS 16
+#define SDL_TLSF_PROFILE_FILTER ((size_t)1 << SDL_TLSF_PROFILE_FILTER_BITS)
+
+typedef struct {
+	void *ptr; // NULL for an empty slot
+	struct tlsf_instance *instance;
+	size_t bytes;
+	uint32_t stack;
+} tlsf_profile_sample;
+
+// Stacks are deduplicated and kept until the profiler stops, even once no live sample uses them
+typedef struct {
+	uint64_t hash; // 0 for an empty slot
+	size_t live; // Samples using the stack right now
+	size_t allocs;
+	size_t alloc_bytes;
+	int depth;
+	void *frames[SDL_TLSF_PROFILE_DEPTH];
+
+	// Filled in by a dump
+	size_t dump_objects;
+	size_t dump_bytes;
+	double dump_scaled_bytes;
+} tlsf_profile_stack;
+
+// A new thread starts as if the profiler was stopped, its first allocation isn't a sample
+__thread intptr_t tlsf_profile_countdown = SDL_TLSF_PROFILE_IDLE_BYTES;
+size_t tlsf_profile_live = 0;
+
+static __thread uint64_t profile_seed = 0;
+
+// The tables are mapped on the first start and never unmapped, frees read them without the lock
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t profile_sample_bytes = 0;
+static void *profile_map = NULL;
+static size_t profile_map_size = 0;
+static tlsf_profile_sample *profile_samples;
+static tlsf_profile_stack *profile_stacks;
+static uint32_t *profile_filter;
+
+static size_t profile_taken = 0;
+static size_t profile_num_stacks = 0;
+static size_t profile_dropped = 0;
+
+static uint64_t sdl_tlsf_profile_hash(const void *ptr) {
+
+	return ((uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ull;
+}
+
+static size_t sdl_tlsf_profile_slot(const void *ptr) {
+
+	return sdl_tlsf_profile_hash(ptr) >> (64 - SDL_TLSF_PROFILE_SLOT_BITS);
+}
+
+static size_t sdl_tlsf_profile_filter_index(const void *ptr) {
+
+	return (sdl_tlsf_profile_hash(ptr) >> 16) & (SDL_TLSF_PROFILE_FILTER - 1);
+}
+
+// Bytes until the next sample, exponential with the given mean so sampling doesn't line up with any pattern
+static intptr_t sdl_tlsf_profile_interval(size_t mean) {
+
+	if (profile_seed == 0) {
+		profile_seed = ((uint64_t)(uintptr_t)&profile_seed ^ (uint64_t)time(NULL) * 0x9E3779B97F4A7C15ull) | 1;
+	}
+
+	// xorshift64, 53 bits of it make a uniform in (0, 1]
+	profile_seed ^= profile_seed << 13;
+	profile_seed ^= profile_seed >> 7;
+	profile_seed ^= profile_seed << 17;
+	double uniform = (double)((profile_seed >> 11) + 1) * (1.0 / 9007199254740992.0);
+
+	double next = -SDL_log(uniform) * (double)mean;
+	if (next < 1) {
+		return 1;
+	}
+	return next > (double)(INTPTR_MAX / 2) ? INTPTR_MAX / 2 : (intptr_t)next;
+}
+
+// Index of the stack, added if it's new. -1 when the table is full
+static int sdl_tlsf_profile_intern(void **frames, int depth) {
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (int i = 0; i < depth; i++) {
+		hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 0x100000001b3ull;
+	}
+	hash |= 1;
+
+	size_t mask = SDL_TLSF_PROFILE_MAX_STACKS - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		tlsf_profile_stack *stack = &profile_stacks[i];
+
+		if (stack -> hash == hash && stack -> depth == depth && memcmp(stack -> frames, frames, sizeof(void *) * depth) == 0) {
+			return (int)i;
+		}
+
+		if (stack -> hash == 0) {
+			// Kept three quarters full at most, so a probe always ends
+			if (profile_num_stacks >= SDL_TLSF_PROFILE_MAX_STACKS / 4 * 3) {
+				return -1;
+			}
+
+			stack -> hash = hash;
+			stack -> depth = depth;
+			memcpy(stack -> frames, frames, sizeof(void *) * depth);
+			profile_num_stacks++;
+			return (int)i;
+		}
+	}
+}
+
+// Empties slot i, moving later entries of the same probe run back so lookups never need tombstones
+static void sdl_tlsf_profile_delete(size_t i) {
+
+	size_t mask = SDL_TLSF_PROFILE_SLOTS - 1;
+
+	for (;;) {
+		profile_samples[i].ptr = NULL;
+
+		size_t j = i;
+		for (;;) {
+			j = (j + 1) & mask;
+			if (profile_samples[j].ptr == NULL) {
+				return;
+			}
+
+			// The entry at j can fill i unless its home slot lies cyclically in (i, j]
+			size_t home = sdl_tlsf_profile_slot(profile_samples[j].ptr);
+			int stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+			if (!stays) {
+				break;
+			}
+		}
+
+		profile_samples[i] = profile_samples[j];
+		i = j;
+	}
+}
+
+// Drops the sample in slot i and everything counting it
+static void sdl_tlsf_profile_drop(size_t i) {
+
+	tlsf_profile_sample *sample = &profile_samples[i];
+
+	__atomic_fetch_sub(&profile_filter[sdl_tlsf_profile_filter_index(sample -> ptr)], 1, __ATOMIC_RELAXED);
+	profile_stacks[sample -> stack].live--;
+	__atomic_fetch_sub(&tlsf_profile_live, 1, __ATOMIC_RELAXED);
+
+	sdl_tlsf_profile_delete(i);
+}
+
+// Zeroed tables, the pages go back to the kernel and fault in empty
+static void sdl_tlsf_profile_clear(void) {
+
+	madvise(profile_map, profile_map_size, MADV_DONTNEED);
+
+	__atomic_store_n(&tlsf_profile_live, 0, __ATOMIC_RELAXED);
+	profile_num_stacks = 0;
+	profile_taken = 0;
+	profile_dropped = 0;
+}
+
+int sdl_tlsf_profile_start(size_t sample_bytes) {
+
+	pthread_mutex_lock(&profile_lock);
+
+	if (profile_map == NULL) {
+		size_t samples_size = sizeof(tlsf_profile_sample) * SDL_TLSF_PROFILE_SLOTS;
+		size_t stacks_size = sizeof(tlsf_profile_stack) * SDL_TLSF_PROFILE_MAX_STACKS;
+		size_t filter_size = sizeof(uint32_t) * SDL_TLSF_PROFILE_FILTER;
+
+		void *map = mmap(NULL, samples_size + stacks_size + filter_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED) {
+			pthread_mutex_unlock(&profile_lock);
+			return -1;
+		}
+
+		profile_map_size = samples_size + stacks_size + filter_size;
+		profile_samples = map;
+		profile_stacks = (tlsf_profile_stack *)((char *)map + samples_size);
+		profile_filter = (uint32_t *)((char *)map + samples_size + stacks_size);
+		profile_map = map;
+	} else {
+		sdl_tlsf_profile_clear();
+	}
+
+	// The unwinder loads on the first backtrace and may allocate, better here than inside an allocation
+	void *frames[1];
+	backtrace(frames, 1);
+
+	__atomic_store_n(&profile_sample_bytes, sample_bytes, __ATOMIC_RELAXED);
+	tlsf_profile_countdown = sample_bytes ? sdl_tlsf_profile_interval(sample_bytes) : SDL_TLSF_PROFILE_IDLE_BYTES;
+
+	pthread_mutex_unlock(&profile_lock);
+	return 0;
+}
+
+void sdl_tlsf_profile_stop(void) {
+
+	pthread_mutex_lock(&profile_lock);
+
+	__atomic_store_n(&profile_sample_bytes, 0, __ATOMIC_RELAXED);
+	if (profile_map != NULL) {
+		sdl_tlsf_profile_clear();
+	}
+
+	pthread_mutex_unlock(&profile_lock);
+}
+
+size_t sdl_tlsf_profile_sampling(void) {
+
+	size_t mean = __atomic_load_n(&profile_sample_bytes, __ATOMIC_RELAXED);
+	if (mean == 0) {
+		tlsf_profile_countdown = SDL_TLSF_PROFILE_IDLE_BYTES;
+	}
+
+	return mean;
+}
+
+void sdl_tlsf_profile_record(struct tlsf_instance *instance, void *ptr, size_t bytes) {
+
+	size_t mean = sdl_tlsf_profile_sampling();
+	if (mean == 0) {
+		return;
+	}
+
+	tlsf_profile_countdown = sdl_tlsf_profile_interval(mean);
+	if (ptr == NULL) {
+		return;
+	}
+
+	// This function is left out, the allocator's own frames stay as the leaves
+	void *frames[SDL_TLSF_PROFILE_DEPTH + 1];
+	int depth = backtrace(frames, SDL_TLSF_PROFILE_DEPTH + 1) - 1;
+
+	pthread_mutex_lock(&profile_lock);
+
+	// Stopped while we were unwinding
+	if (profile_sample_bytes == 0) {
+		pthread_mutex_unlock(&profile_lock);
+		return;
+	}
+
+	profile_taken++;
+
+	int stack = sdl_tlsf_profile_intern(frames + 1, depth);
+	if (stack < 0 || tlsf_profile_live >= SDL_TLSF_PROFILE_MAX_SAMPLES) {
+		profile_dropped++;
+		pthread_mutex_unlock(&profile_lock);
+		return;
+	}
+
+	size_t mask = SDL_TLSF_PROFILE_SLOTS - 1;
+	size_t i = sdl_tlsf_profile_slot(ptr);
+	while (profile_samples[i].ptr != NULL) {
+		i = (i + 1) & mask;
+	}
+
+	profile_samples[i].ptr = ptr;
+	profile_samples[i].instance = instance;
+	profile_samples[i].bytes = bytes;
+	profile_samples[i].stack = (uint32_t)stack;
+
+	profile_stacks[stack].live++;
+	profile_stacks[stack].allocs++;
+	profile_stacks[stack].alloc_bytes += bytes;
+
+	__atomic_fetch_add(&profile_filter[sdl_tlsf_profile_filter_index(ptr)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&tlsf_profile_live, 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(&profile_lock);
+}
+
+void sdl_tlsf_profile_remove(void *ptr) {
+
+	if (ptr == NULL || __atomic_load_n(&profile_filter[sdl_tlsf_profile_filter_index(ptr)], __ATOMIC_RELAXED) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&profile_lock);
+
+	size_t mask = SDL_TLSF_PROFILE_SLOTS - 1;
+	for (size_t i = sdl_tlsf_profile_slot(ptr); profile_samples[i].ptr != NULL; i = (i + 1) & mask) {
+		if (profile_samples[i].ptr == ptr) {
+			sdl_tlsf_profile_drop(i);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&profile_lock);
+}
+
+void sdl_tlsf_profile_forget_instance(struct tlsf_instance *instance) {
+
+	if (__atomic_load_n(&tlsf_profile_live, __ATOMIC_RELAXED) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&profile_lock);
+
+	// A delete pulls later entries back into slot i, so it's looked at again before moving on
+	for (size_t i = 0; i < SDL_TLSF_PROFILE_SLOTS;) {
+		if (profile_samples[i].ptr != NULL && profile_samples[i].instance == instance) {
+			sdl_tlsf_profile_drop(i);
+		} else {
+			i++;
+		}
+	}
+
+	pthread_mutex_unlock(&profile_lock);
+}
+
+// Whether a sample from heap belongs in a dump of instance
+static int sdl_tlsf_profile_matches(tlsf_instance *heap, tlsf_instance *instance) {
+
+	return instance == NULL || heap == instance || heap -> parent == instance;
+}
+
+// Live bytes a sample stands for. Allocations of s bytes are picked with probability 1 - e^(-s / mean)
+static double sdl_tlsf_profile_weight(size_t bytes, size_t mean) {
+
+	return 1.0 / (1.0 - SDL_exp(-(double)bytes / (double)mean));
+}
+
+// Sums the matching live samples into their stacks
+static void sdl_tlsf_profile_gather(tlsf_instance *instance) {
+
+	for (size_t s = 0; s < SDL_TLSF_PROFILE_MAX_STACKS; s++) {
+		profile_stacks[s].dump_objects = 0;
+		profile_stacks[s].dump_bytes = 0;
+		profile_stacks[s].dump_scaled_bytes = 0;
+	}
+
+	for (size_t i = 0; i < SDL_TLSF_PROFILE_SLOTS; i++) {
+		tlsf_profile_sample *sample = &profile_samples[i];
+
+		if (sample -> ptr != NULL && sdl_tlsf_profile_matches(sample -> instance, instance)) {
+			tlsf_profile_stack *stack = &profile_stacks[sample -> stack];
+
+			stack -> dump_objects++;
+			stack -> dump_bytes += sample -> bytes;
+			stack -> dump_scaled_bytes += (double)sample -> bytes * sdl_tlsf_profile_weight(sample -> bytes, profile_sample_bytes);
+		}
+	}
+}
+
+// Function name for a frame, or module+offset for anything the dynamic symbol table doesn't cover
+static void sdl_tlsf_profile_write_frame(FILE *file, void *frame) {
+
+	Dl_info info;
+
+	if (dladdr(frame, &info) && info.dli_sname != NULL) {
+		fputs(info.dli_sname, file);
+	} else if (info.dli_fname != NULL) {
+		const char *name = strrchr(info.dli_fname, '/');
+		fprintf(file, "%s+0x%zx", name ? name + 1 : info.dli_fname, (size_t)((char *)frame - (char *)info.dli_fbase));
+	} else {
+		fprintf(file, "%p", frame);
+	}
+}
+
+// gperftools' heap_v2 text format. Counts are the raw samples, pprof scales them with the period in the header
+static void sdl_tlsf_profile_write_pprof(FILE *file) {
+
+	size_t objects = 0, bytes = 0, allocs = 0, alloc_bytes = 0;
+	for (size_t s = 0; s < SDL_TLSF_PROFILE_MAX_STACKS; s++) {
+		objects += profile_stacks[s].dump_objects;
+		bytes += profile_stacks[s].dump_bytes;
+		allocs += profile_stacks[s].allocs;
+		alloc_bytes += profile_stacks[s].alloc_bytes;
+	}
+
+	fprintf(file, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", objects, bytes, allocs, alloc_bytes, profile_sample_bytes);
+
+	for (size_t s = 0; s < SDL_TLSF_PROFILE_MAX_STACKS; s++) {
+		tlsf_profile_stack *stack = &profile_stacks[s];
+		if (stack -> hash == 0 || (stack -> dump_objects == 0 && stack -> allocs == 0)) {
+			continue;
+		}
+
+		fprintf(file, "%zu: %zu [%zu: %zu] @", stack -> dump_objects, stack -> dump_bytes, stack -> allocs, stack -> alloc_bytes);
+		for (int f = 0; f < stack -> depth; f++) {
+			fprintf(file, " %p", stack -> frames[f]);
+		}
+		fputc('\n', file);
+	}
+
+	// pprof needs the mappings to symbolize the addresses
+	fputs("\nMAPPED_LIBRARIES:\n", file);
+
+	FILE *maps = fopen("/proc/self/maps", "r");
+	if (maps != NULL) {
+		char line[512];
+		while (fgets(line, sizeof(line), maps) != NULL) {
+			fputs(line, file);
+		}
+		fclose(maps);
+	}
+}
+
+// Root first, the live bytes the stack's samples stand for at the end
+static void sdl_tlsf_profile_write_collapsed(FILE *file) {
+
+	for (size_t s = 0; s < SDL_TLSF_PROFILE_MAX_STACKS; s++) {
+		tlsf_profile_stack *stack = &profile_stacks[s];
+		if (stack -> dump_objects == 0) {
+			continue;
+		}
+
+		for (int f = stack -> depth - 1; f >= 0; f--) {
+			sdl_tlsf_profile_write_frame(file, stack -> frames[f]);
+			fputc(f ? ';' : ' ', file);
+		}
+		fprintf(file, "%.0f\n", stack -> dump_scaled_bytes);
+	}
+}
+
+int sdl_tlsf_profile_dump(const char *path, tlsf_profile_format format, struct tlsf_instance *instance) {
+
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&profile_lock);
+
+	if (profile_sample_bytes == 0) {
+		pthread_mutex_unlock(&profile_lock);
+		fclose(file);
+		return -1;
+	}
+
+	// Everything is written under the lock, frees that hit a sample wait for it
+	sdl_tlsf_profile_gather(instance);
+
+	if (format == SDL_TLSF_PROFILE_PPROF) {
+		sdl_tlsf_profile_write_pprof(file);
+	} else {
+		sdl_tlsf_profile_write_collapsed(file);
+	}
+
+	pthread_mutex_unlock(&profile_lock);
+
+	return fclose(file) == 0 ? 0 : -1;
+}
+
+void sdl_tlsf_profile_get_stats(tlsf_profile_stats *stats) {
+
+	pthread_mutex_lock(&profile_lock);
+
+	memset(stats, 0, sizeof(tlsf_profile_stats));
+	stats -> sample_bytes = profile_sample_bytes;
+	stats -> samples = profile_taken;
+	stats -> live_samples = tlsf_profile_live;
+	stats -> dropped = profile_dropped;
+
+	if (profile_map != NULL && profile_sample_bytes != 0) {
+		for (size_t s = 0; s < SDL_TLSF_PROFILE_MAX_STACKS; s++) {
+			stats -> live_stacks += profile_stacks[s].live != 0;
+		}
+
+		double live_bytes = 0;
+		for (size_t i = 0; i < SDL_TLSF_PROFILE_SLOTS; i++) {
+			if (profile_samples[i].ptr != NULL) {
+				size_t bytes = profile_samples[i].bytes;
+				live_bytes += (double)bytes * sdl_tlsf_profile_weight(bytes, profile_sample_bytes);
+			}
+		}
+		stats -> live_bytes = (size_t)live_bytes;
+	}
+
+	pthread_mutex_unlock(&profile_lock);
+}
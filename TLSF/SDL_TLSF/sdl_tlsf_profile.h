@@ -0,0 +1,96 @@
+//
+// Created by bee on 10/19/26.
+//
+
+#ifndef TLSF_SDL_TLSF_PROFILE_H
+#define TLSF_SDL_TLSF_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Sampling heap profiler. Roughly one allocation every sample_bytes is picked, with the gaps between samples
+// drawn from an exponential distribution so every byte has the same chance. A picked allocation gets its
+// backtrace stored until it's freed, so the live samples scaled by their weight add up to the live heap
+// An allocation that isn't picked only pays one decrement of a thread local counter
+
+// Frames kept per backtrace, and how many samples and distinct stacks can be live at once
+#define SDL_TLSF_PROFILE_DEPTH 32
+#define SDL_TLSF_PROFILE_MAX_SAMPLES 65536
+#define SDL_TLSF_PROFILE_MAX_STACKS 8192
+
+// What a thread counts down while the profiler is off, so a start reaches it within this many bytes
+#define SDL_TLSF_PROFILE_IDLE_BYTES ((intptr_t)1 << 20)
+
+struct tlsf_instance;
+
+typedef enum {
+	SDL_TLSF_PROFILE_PPROF, // gperftools heap profile text, readable by pprof with the binary
+	SDL_TLSF_PROFILE_COLLAPSED // One "root;...;leaf bytes" line per stack, for flamegraph.pl and friends
+} tlsf_profile_format;
+
+typedef struct {
+
+	size_t sample_bytes; // 0 when stopped
+	size_t samples; // Taken since the start
+	size_t live_samples;
+	size_t live_stacks;
+	size_t live_bytes; // Estimated live heap behind the samples
+	size_t dropped; // Samples that didn't fit in the tables
+
+} tlsf_profile_stats;
+
+// Starts sampling on every instance, one sample per sample_bytes on average. Restarting drops the old samples
+// Returns -1 if the tables can't be mapped
+int sdl_tlsf_profile_start(size_t sample_bytes);
+
+// Stops sampling and drops every sample
+void sdl_tlsf_profile_stop(void);
+
+// Writes the live samples of instance and its tags to path, NULL instance for every instance. Returns -1 on failure
+int sdl_tlsf_profile_dump(const char *path, tlsf_profile_format format, struct tlsf_instance *instance);
+
+void sdl_tlsf_profile_get_stats(tlsf_profile_stats *stats);
+
+// ###### ALLOCATOR HOOKS ######
+// Used by sdl_tlsf.c, not meant to be called directly
+
+// __thread rather than _Thread_local so the header also builds as C++
+extern __thread intptr_t tlsf_profile_countdown;
+extern size_t tlsf_profile_live;
+
+// Whether an allocation of bytes is the one to sample
+static inline int sdl_tlsf_profile_tick(size_t bytes) {
+
+	tlsf_profile_countdown -= (intptr_t)bytes;
+	return tlsf_profile_countdown < 0;
+}
+
+// Bytes per sample, or 0 with the countdown pushed back by SDL_TLSF_PROFILE_IDLE_BYTES while stopped
+// Lets the allocator skip finding the heap, and its lock, when there's nothing to record
+size_t sdl_tlsf_profile_sampling(void);
+
+// Stores a sample for ptr (NULL just resets the countdown), instance is the heap it came from
+void sdl_tlsf_profile_record(struct tlsf_instance *instance, void *ptr, size_t bytes);
+
+void sdl_tlsf_profile_remove(void *ptr);
+
+// Drops ptr's sample if it has one
+static inline void sdl_tlsf_profile_forget(void *ptr) {
+
+	if (__atomic_load_n(&tlsf_profile_live, __ATOMIC_RELAXED) != 0) {
+		sdl_tlsf_profile_remove(ptr);
+	}
+}
+
+// Drops every sample of an instance that's going away
+void sdl_tlsf_profile_forget_instance(struct tlsf_instance *instance);
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif //TLSF_SDL_TLSF_PROFILE_H
@@ -3,13 +3,135 @@
 //
 
 #include "tlsf.h"
+#include "MemTasks/perf_counters.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+
+// Prints the footprint and malloc/free cost per request size, build with different TLSF_ALIGN_SIZE values to compare
+void alignment_overhead_test(tlsf_t tlsf) {
+
+	const size_t sizes[] = { 1, 8, 16, 24, 32, 48, 64, 100, 128, 256, 1000, 4096, 65536 };
+	const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+	const int iterations = 100000;
+	void *ptrs[64];
+
+	printf("Alignment: %zu bytes, minimum block: %zu bytes, header overhead: %zu bytes\n",
+		   tlsf_align_size(), tlsf_block_size_min(), tlsf_alloc_overhead());
+	printf("%10s %10s %10s %10s %10s\n", "request", "block", "footprint", "waste", "ns/op");
+
+	for (int i = 0; i < num_sizes; i++) {
+
+		void *ptr = tlsf_malloc(tlsf, sizes[i]);
+		size_t block = tlsf_block_size(ptr);
+		size_t footprint = block + tlsf_alloc_overhead();
+		tlsf_free(tlsf, ptr);
+
+		// Batches of 64 so the blocks are actually split and coalesced
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int j = 0; j < iterations; j += 64) {
+			for (int k = 0; k < 64; k++) {
+				ptrs[k] = tlsf_malloc(tlsf, sizes[i]);
+			}
+			for (int k = 0; k < 64; k++) {
+				tlsf_free(tlsf, ptrs[k]);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+		printf("%10zu %10zu %10zu %10zu %10.1f\n", sizes[i], block, footprint, footprint - sizes[i], ns / iterations);
+	}
+}
+
+// A free block with too little room to split off its alignment gap must not be handed back misaligned
+// Runs on a fresh heap so the hole is the first block the plain size search finds
+void memalign_gap_test() {
+
+	void *mem = aligned_alloc(tlsf_align_size(), 1 << 16);
+	tlsf_t tlsf = tlsf_create_with_pool(mem, (1 << 16) - tlsf_pool_overhead());
+
+	void *before = tlsf_malloc(tlsf, 32);
+	void *hole = tlsf_malloc(tlsf, 64);
+	void *after = tlsf_malloc(tlsf, 8);
+	tlsf_free(tlsf, hole);
+
+	void *ptr = tlsf_memalign(tlsf, 16, 6);
+	if (ptr == NULL || (size_t)ptr % 16 != 0) {
+		printf("tlsf_memalign(): Aligned allocation failed (%p)\n", ptr);
+	} else {
+		printf("tlsf_memalign(): Aligned allocation succeeded\n");
+	}
+
+	tlsf_free(tlsf, ptr);
+	tlsf_free(tlsf, after);
+	tlsf_free(tlsf, before);
+
+	tlsf_destroy(tlsf);
+	free(mem);
+}
+
+// Random small object churn over many size classes, prints L1D and LLC misses per malloc/free pair
+// Build with TLSF_CACHE_LINE_SIZE=0 to compare against the unpadded control layout
+void cache_miss_test() {
+
+	const size_t pool_bytes = (1 << 20) * 64;
+	const int num_slots = 1 << 15;
+	const int operations = 1 << 21;
+
+	// Line aligned, like the mmap'd pools of the SDL layer
+	void *mem = aligned_alloc(64, pool_bytes);
+	tlsf_t tlsf = tlsf_create_with_pool(mem, pool_bytes);
+	void **slots = calloc(num_slots, sizeof(void *));
+
+	unsigned int seed = 231;
+	for (int i = 0; i < num_slots; i++) {
+		seed = seed * 1103515245 + 12345;
+		slots[i] = tlsf_malloc(tlsf, 16 + (seed >> 8) % 4096);
+	}
+
+	mem_perf_counters counters;
+	static mem_perf_report report;
+	report.count = 0;
+	mem_perf_open(&counters);
+
+	mem_perf_begin(&counters);
+	for (int i = 0; i < operations; i++) {
+		seed = seed * 1103515245 + 12345;
+		int slot = (seed >> 4) % num_slots;
+		tlsf_free(tlsf, slots[slot]);
+		slots[slot] = tlsf_malloc(tlsf, 16 + (seed >> 8) % 4096);
+	}
+	mem_perf_end(&counters, &report, "tlsf", "cache_miss", "churn", operations);
+	mem_perf_close(&counters);
+
+	const mem_perf_sample *sample = &report.samples[0];
+	printf("Control: %zu bytes, %d malloc/free pairs, %.1f ns/pair\n", tlsf_size(), operations,
+		   (double)sample -> ns / operations);
+	if (sample -> valid[MEM_PERF_L1D_MISSES]) {
+		printf("L1D read misses/pair: %.3f\n", (double)sample -> values[MEM_PERF_L1D_MISSES] / operations);
+	} else {
+		printf("L1D read misses/pair: unavailable\n");
+	}
+	if (sample -> valid[MEM_PERF_LLC_MISSES]) {
+		printf("LLC misses/pair: %.3f\n", (double)sample -> values[MEM_PERF_LLC_MISSES] / operations);
+	} else {
+		printf("LLC misses/pair: unavailable\n");
+	}
+
+	for (int i = 0; i < num_slots; i++) {
+		tlsf_free(tlsf, slots[i]);
+	}
+	free(slots);
+	tlsf_destroy(tlsf);
+	free(mem);
+}
 
 int main() {
 
 	// Create some memory for the tlsf instance
-	void *mem = malloc((1 << 20) * 8);
+	void *mem = aligned_alloc(tlsf_align_size(), (1 << 20) * 8);
 
 	// Create a new instance of tlsf using the memory
 	tlsf_t tlsf = tlsf_create_with_pool(mem, ((1 << 20) * 8) - tlsf_pool_overhead());
@@ -81,7 +203,7 @@ int main() {
 	tlsf_free(tlsf, ptr2);
 
 	// Testing Adding a pool
-	void *mem2 = malloc(1 << 20);
+	void *mem2 = aligned_alloc(tlsf_align_size(), 1 << 20);
 	size_t pool_size = (1 << 20) - tlsf_pool_overhead();
 	pool_t pool = tlsf_add_pool(tlsf, mem2, pool_size);
 	if (pool == NULL) {
@@ -91,7 +213,7 @@ int main() {
 	}
 
 
-	void *mem3 = malloc(1 << 20);
+	void *mem3 = aligned_alloc(tlsf_align_size(), 1 << 20);
 	pool_t pool2 = tlsf_add_pool(tlsf, mem3, pool_size);
 	if (pool2 == NULL) {
 		printf("tlsf_add_pool(): Memory allocation failed\n");
@@ -116,6 +238,55 @@ int main() {
 	}
 	tlsf_free(tlsf, ptr);
 
+	memalign_gap_test();
+
+	// Expand Check, the block should grow into the free space behind it without moving
+	ptr = tlsf_malloc(tlsf, 64);
+	size_t expanded = tlsf_expand(tlsf, ptr, 256, 1024);
+	if (expanded < 256 || expanded > 1024) {
+		printf("tlsf_expand(): In place expansion failed\n");
+	} else {
+		printf("tlsf_expand(): In place expansion succeeded\n");
+	}
+	tlsf_free(tlsf, ptr);
+
+	// Growing to max_size would leave a rest too small to split off, it mustn't end up in the block
+	ptr = tlsf_malloc(tlsf, 64);
+	void *gap = tlsf_malloc(tlsf, 192);
+	void *guard = tlsf_malloc(tlsf, 64);
+	tlsf_free(tlsf, gap);
+	expanded = tlsf_expand(tlsf, ptr, 128, 256);
+	if (expanded < 128 || expanded > 256) {
+		printf("tlsf_expand(): Bounded expansion failed (%zu)\n", expanded);
+	} else {
+		printf("tlsf_expand(): Bounded expansion succeeded\n");
+	}
+	tlsf_free(tlsf, guard);
+	tlsf_free(tlsf, ptr);
+
+	// Deferred Free Check, a same-size request should get the parked block back
+	tlsf_set_deferred_free(tlsf, 1);
+	ptr = tlsf_malloc(tlsf, 64);
+	tlsf_free(tlsf, ptr);
+	void *ptr3 = tlsf_malloc(tlsf, 64);
+	if (ptr3 != ptr) {
+		printf("tlsf_set_deferred_free(): Parked block was not reused\n");
+	} else {
+		printf("tlsf_set_deferred_free(): Parked block was reused\n");
+	}
+	tlsf_free(tlsf, ptr3);
+
+	tlsf_compact(tlsf);
+	if (tlsf_check(tlsf) != 0) {
+		printf("tlsf_compact(): Memory check failed\n");
+	} else {
+		printf("tlsf_compact(): Memory check succeeded\n");
+	}
+	tlsf_set_deferred_free(tlsf, 0);
+
+	alignment_overhead_test(tlsf);
+	cache_miss_test();
+
 	// Remove the pool
 	tlsf_remove_pool(tlsf, pool);
 	tlsf_remove_pool(tlsf, pool2);
@@ -5,13 +5,204 @@
 #include "SDL/include/SDL3/SDL.h"
 #include "SDL_TLSF/sdl_tlsf.h"
 #include "MemTasks/mem_ops.h"
+#include "MemTasks/shared_ops.h"
+#include "MemTasks/persist_ops.h"
+#include "MemTasks/pmr_ops.h"
+#include "MemTasks/remote_ops.h"
+#include "MemTasks/cpu_ops.h"
+#include "MemTasks/epoch_ops.h"
+#include "MemTasks/depot_ops.h"
+#include "MemTasks/budget_ops.h"
+#include "MemTasks/growth_ops.h"
+#include "MemTasks/tag_ops.h"
+#include "MemTasks/lifetime_ops.h"
+#include "MemTasks/profile_ops.h"
+#include "MemTasks/lock_ops.h"
 
 #include <time.h>    // For time()
 
+// Scratch files the workloads make and delete again go here, results only go to --out
+static const char *scratch_dir = "/tmp";
+static const char *out_dir = NULL;
+
+// Twenty-Three is number one
+static const size_t base_seed = 231;
+
+static void run_stress(void) {
+
+	memory_stress_test(base_seed);
+}
+
+static void run_shared(void) {
+
+	shared_message_test(200000, 4096);
+}
+
+static void run_persist(void) {
+
+	char path[512];
+	SDL_snprintf(path, sizeof(path), "%s/sdl_tlsf_persist.bin", scratch_dir);
+	persist_startup_test(path, 1000000);
+}
+
+static void run_snapshot(void) {
+
+	snapshot_rollback_test(200000, 100, 500);
+}
+
+static void run_pmr(void) {
+
+	pmr_container_test(20);
+}
+
+static void run_remote(void) {
+
+	remote_free_test(500000, 4096);
+}
+
+static void run_cpu(void) {
+
+	cpu_cache_test(64, 4, 1000000);
+}
+
+static void run_epoch(void) {
+
+	epoch_reclaim_test(3, 2, 200000);
+}
+
+static void run_depot(void) {
+
+	depot_level_test(20, (1 << 20) * 2, (1 << 20) * 64);
+}
+
+static void run_budget(void) {
+
+	budget_pressure_test(2000, 256 * 1024, (1 << 20) * 48, (1 << 20) * 64);
+}
+
+static void run_growth(void) {
+
+	growth_ramp_test((1 << 20) * 4, (1 << 20) * 256, (size_t)(1 << 20) * 1024);
+}
+
+static void run_tag(void) {
+
+	tag_release_test(200000);
+}
+
+static void run_lifetime(void) {
+
+	lifetime_fragmentation_test(5000, 4096, 1 << 20);
+}
+
+static void run_profile(void) {
+
+	char path[512];
+	SDL_snprintf(path, sizeof(path), "%s/sdl_tlsf_profile", scratch_dir);
+	profile_sampling_test(1000000, 512 * 1024, path);
+}
+
+static void run_lock(void) {
+
+	lock_contention_test(4, 500000);
+}
+
+static void run_perf(void) {
+
+	const mem_perf_backend perf_backends[] = {
+		{ "tlsf", sdl_tlsf_malloc, sdl_tlsf_realloc, sdl_tlsf_free },
+		{ "libc", malloc, realloc, free }
+	};
+
+	char csv_path[512], json_path[512];
+	if (out_dir) {
+		SDL_snprintf(csv_path, sizeof(csv_path), "%s/mem_perf_tlsf.csv", out_dir);
+		SDL_snprintf(json_path, sizeof(json_path), "%s/mem_perf_tlsf.json", out_dir);
+	}
+
+	mem_perf_compare(perf_backends, 2, out_dir ? csv_path : NULL, out_dir ? json_path : NULL);
+}
+
+typedef struct {
+	const char *name;
+	void (*run)(void);
+} sdl_test_workload;
+
+static const sdl_test_workload workloads[] = {
+	{ "stress", run_stress },
+	{ "shared", run_shared },
+	{ "persist", run_persist },
+	{ "snapshot", run_snapshot },
+	{ "pmr", run_pmr },
+	{ "remote", run_remote },
+	{ "cpu", run_cpu },
+	{ "epoch", run_epoch },
+	{ "depot", run_depot },
+	{ "budget", run_budget },
+	{ "growth", run_growth },
+	{ "tag", run_tag },
+	{ "lifetime", run_lifetime },
+	{ "profile", run_profile },
+	{ "lock", run_lock },
+	{ "perf", run_perf }
+};
+
+#define NUM_WORKLOADS (int)(sizeof(workloads) / sizeof(workloads[0]))
+
+static void print_usage(const char *program) {
+
+	char names[256] = "";
+	for (int i = 0; i < NUM_WORKLOADS; i++) {
+		SDL_strlcat(names, " ", sizeof(names));
+		SDL_strlcat(names, workloads[i].name, sizeof(names));
+	}
+
+	SDL_Log("Usage: %s [--out dir] [all | workload...]\n", program);
+	SDL_Log("Workloads:%s. Without any only stress runs, results are written to dir only with --out\n", names);
+}
+
+static const sdl_test_workload *find_workload(const char *name) {
+
+	for (int i = 0; i < NUM_WORKLOADS; i++) {
+		if (SDL_strcmp(workloads[i].name, name) == 0) {
+			return &workloads[i];
+		}
+	}
+	return NULL;
+}
+
 
 int main(int argc, char *argv[]) {
-	(void) argc;
-	(void) argv;
+
+	// Nothing runs until every argument checks out
+	int selected[NUM_WORKLOADS] = {0};
+	int any = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (SDL_strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			out_dir = argv[++i];
+		} else if (SDL_strcmp(argv[i], "all") == 0) {
+			for (int w = 0; w < NUM_WORKLOADS; w++) {
+				selected[w] = 1;
+			}
+			any = 1;
+		} else if (find_workload(argv[i]) != NULL) {
+			selected[find_workload(argv[i]) - workloads] = 1;
+			any = 1;
+		} else {
+			print_usage(argv[0]);
+			return SDL_strcmp(argv[i], "--help") == 0 ? 0 : 1;
+		}
+	}
+
+	// The original benchmark
+	if (!any) {
+		selected[0] = 1;
+	}
+
+	if (SDL_getenv("TMPDIR") != NULL) {
+		scratch_dir = SDL_getenv("TMPDIR");
+	}
 
 	// Initialize primary memory management with a significant amount of memory.
     sdl_tlsf_init_with_size((1 << 20) * 128);  // 128MB
@@ -28,9 +219,6 @@ int main(int argc, char *argv[]) {
 //    config.test_reallocation = 1;  // Enable reallocation testing
 //    config.test_deallocation = 1;  // Enable deallocation testing
 
-	// Twenty-Three is number one
-	size_t base_seed = 231;
-
 	// Perform this test 5 times increase the seed by 1 each time
 //	for (int i = 0; i < 50	; i++) {
 
@@ -40,7 +228,11 @@ int main(int argc, char *argv[]) {
 
 //		SDL_Log("Running test %d", i + 1);
 //		mem_speed_test(config, base_seed + i);
-		memory_stress_test(base_seed);
+		for (int i = 0; i < NUM_WORKLOADS; i++) {
+			if (selected[i]) {
+				workloads[i].run();
+			}
+		}
 
 //	}
 
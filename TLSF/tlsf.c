@@ -5,6 +5,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* Specialized copies of this file rename their entry points. */
+#if defined (TLSF_PREFIX)
+#include "tlsf_prefix.h"
+#endif
+
 #include "tlsf.h"
 
 #if defined(__cplusplus)
@@ -201,6 +206,114 @@ tlsf_decl int tlsf_fls_sizet(size_t size)
 ** Constants.
 */
 
+/*
+** Minimum alignment of every allocation. Defaults to the word size; build
+** with TLSF_ALIGN_SIZE set to 8, 16, 32 or 64 for SIMD-friendly blocks.
+** Larger values raise the per-block overhead and minimum block size.
+*/
+#if defined (TLSF_64BIT)
+#define TLSF_WORD_SIZE 8
+#else
+#define TLSF_WORD_SIZE 4
+#endif
+
+#if !defined (TLSF_ALIGN_SIZE)
+#define TLSF_ALIGN_SIZE TLSF_WORD_SIZE
+#endif
+
+#if TLSF_ALIGN_SIZE == 4
+#define TLSF_ALIGN_SIZE_LOG2 2
+#elif TLSF_ALIGN_SIZE == 8
+#define TLSF_ALIGN_SIZE_LOG2 3
+#elif TLSF_ALIGN_SIZE == 16
+#define TLSF_ALIGN_SIZE_LOG2 4
+#elif TLSF_ALIGN_SIZE == 32
+#define TLSF_ALIGN_SIZE_LOG2 5
+#elif TLSF_ALIGN_SIZE == 64
+#define TLSF_ALIGN_SIZE_LOG2 6
+#else
+#error "TLSF_ALIGN_SIZE must be 4, 8, 16, 32 or 64"
+#endif
+
+#if TLSF_ALIGN_SIZE < TLSF_WORD_SIZE
+#error "TLSF_ALIGN_SIZE can't be smaller than the word size"
+#endif
+
+#if !defined (TLSF_DEFERRED_FREE_COUNT)
+#define TLSF_DEFERRED_FREE_COUNT 16
+#endif
+
+/*
+** Shape of the free list index. The defaults give the stock layout;
+** tlsf_small.c, tlsf_fine.c and tlsf_large.c override them to build
+** specialized copies of this file side by side, see tlsf_variants.h.
+*/
+#if !defined (TLSF_SL_INDEX_COUNT_LOG2)
+#define TLSF_SL_INDEX_COUNT_LOG2 5
+#endif
+
+/*
+** Build with TLSF_OFFSET_HEADERS set to 1 to store the block links as
+** 32-bit offsets instead of pointers, see block_header_t. Blocks are then
+** limited to 2 GB and every pool must lie within 8 GB of the control
+** structure, which is what tlsf_packed.c is built for.
+*/
+#if !defined (TLSF_OFFSET_HEADERS)
+#define TLSF_OFFSET_HEADERS 0
+#endif
+
+#if !defined (TLSF_FL_INDEX_MAX)
+#if TLSF_OFFSET_HEADERS
+#define TLSF_FL_INDEX_MAX 31
+#elif defined (TLSF_64BIT)
+#define TLSF_FL_INDEX_MAX 32
+#else
+#define TLSF_FL_INDEX_MAX 30
+#endif
+#endif
+
+/*
+** Free list bitmaps are 32 bits wide unless there are more than 32
+** second-level lists or first-level lists to track.
+*/
+#if (1 << TLSF_SL_INDEX_COUNT_LOG2) > 32 \
+	|| (TLSF_FL_INDEX_MAX - TLSF_SL_INDEX_COUNT_LOG2 - TLSF_ALIGN_SIZE_LOG2 + 1) > 32
+typedef unsigned long long tlsf_bitmap_t;
+
+static int tlsf_ffs_bitmap(tlsf_bitmap_t word)
+{
+	const unsigned int low = (unsigned int)(word & 0xffffffff);
+	if (low)
+	{
+		return tlsf_ffs(low);
+	}
+	return word ? 32 + tlsf_ffs((unsigned int)(word >> 32)) : -1;
+}
+#else
+typedef unsigned int tlsf_bitmap_t;
+#define tlsf_ffs_bitmap tlsf_ffs
+#endif
+
+/*
+** Cache line size the control structure is laid out for. The bitmaps
+** and the null block are packed at the front and the free list heads
+** start on a fresh line, so a search touches as few lines as possible
+** when the control memory is itself line aligned (pages from mmap are).
+** Set to 0 to get the unpadded layout and no prefetching.
+*/
+#if !defined (TLSF_CACHE_LINE_SIZE)
+#define TLSF_CACHE_LINE_SIZE 64
+#endif
+
+#if TLSF_CACHE_LINE_SIZE > 0 && (defined (__GNUC__) || defined (__clang__))
+#define tlsf_prefetch(ptr) __builtin_prefetch((ptr), 1)
+#elif TLSF_CACHE_LINE_SIZE > 0 && defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64))
+#include <xmmintrin.h>
+#define tlsf_prefetch(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#else
+#define tlsf_prefetch(ptr) ((void)0)
+#endif
+
 /* Public constants: may be modified. */
 enum tlsf_public
 {
@@ -208,41 +321,38 @@ enum tlsf_public
     ** values require more memory in the control structure. Values of
     ** 4 or 5 are typical.
     */
-    SL_INDEX_COUNT_LOG2 = 5,
+    SL_INDEX_COUNT_LOG2 = TLSF_SL_INDEX_COUNT_LOG2,
+
+    /* Number of freed blocks an instance can park without coalescing when
+    ** deferred freeing is enabled (see tlsf_set_deferred_free). Set
+    ** TLSF_DEFERRED_FREE_COUNT to 0 to compile the feature out.
+    */
+    DEFERRED_FREE_COUNT = TLSF_DEFERRED_FREE_COUNT,
 };
 
 /* Private constants: do not modify. */
 enum tlsf_private
 {
-#if defined (TLSF_64BIT)
-    /* All allocation sizes and addresses are aligned to 8 bytes. */
-	ALIGN_SIZE_LOG2 = 3,
-#else
-    /* All allocation sizes and addresses are aligned to 4 bytes. */
-    ALIGN_SIZE_LOG2 = 2,
-#endif
+    /* All allocation sizes and addresses are aligned to TLSF_ALIGN_SIZE bytes. */
+    ALIGN_SIZE_LOG2 = TLSF_ALIGN_SIZE_LOG2,
     ALIGN_SIZE = (1 << ALIGN_SIZE_LOG2),
 
     /*
     ** We support allocations of sizes up to (1 << FL_INDEX_MAX) bits.
     ** However, because we linearly subdivide the second-level lists, and
-    ** our minimum size granularity is 4 bytes, it doesn't make sense to
-    ** create first-level lists for sizes smaller than SL_INDEX_COUNT * 4,
-    ** or (1 << (SL_INDEX_COUNT_LOG2 + 2)) bytes, as there we will be
+    ** our minimum size granularity is ALIGN_SIZE bytes, it doesn't make sense
+    ** to create first-level lists for sizes smaller than SL_INDEX_COUNT *
+    ** ALIGN_SIZE, or (1 << FL_INDEX_SHIFT) bytes, as there we will be
     ** trying to split size ranges into more slots than we have available.
     ** Instead, we calculate the minimum threshold size, and place all
     ** blocks below that size into the 0th first-level list.
     */
 
-#if defined (TLSF_64BIT)
     /*
-	** TODO: We can increase this to support larger sizes, at the expense
-	** of more overhead in the TLSF structure.
-	*/
-	FL_INDEX_MAX = 32,
-#else
-    FL_INDEX_MAX = 30,
-#endif
+    ** Larger values support larger blocks at the expense of more overhead
+    ** in the TLSF structure, see tlsf_large.c.
+    */
+    FL_INDEX_MAX = TLSF_FL_INDEX_MAX,
     SL_INDEX_COUNT = (1 << SL_INDEX_COUNT_LOG2),
     FL_INDEX_SHIFT = (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2),
     FL_INDEX_COUNT = (FL_INDEX_MAX - FL_INDEX_SHIFT + 1),
@@ -280,11 +390,26 @@ tlsf_static_assert(sizeof(size_t) * CHAR_BIT >= 32);
 tlsf_static_assert(sizeof(size_t) * CHAR_BIT <= 64);
 
 /* SL_INDEX_COUNT must be <= number of bits in sl_bitmap's storage type. */
-tlsf_static_assert(sizeof(unsigned int) * CHAR_BIT >= SL_INDEX_COUNT);
+tlsf_static_assert(sizeof(tlsf_bitmap_t) * CHAR_BIT >= SL_INDEX_COUNT);
+
+/* Likewise for FL_INDEX_COUNT and fl_bitmap. */
+tlsf_static_assert(sizeof(tlsf_bitmap_t) * CHAR_BIT >= FL_INDEX_COUNT);
+
+/* Block sizes must be representable in a size_t. */
+tlsf_static_assert(sizeof(size_t) * CHAR_BIT > FL_INDEX_MAX);
+
+/* Offset headers keep the size in 32 bits. */
+#if TLSF_OFFSET_HEADERS && TLSF_FL_INDEX_MAX > 31
+#error "TLSF_OFFSET_HEADERS limits TLSF_FL_INDEX_MAX to 31"
+#endif
 
 /* Ensure we've properly tuned our sizes. */
 tlsf_static_assert(ALIGN_SIZE == SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
 
+/* The size field and its padding must fill whole alignment units. */
+tlsf_static_assert(sizeof(size_t) == TLSF_WORD_SIZE);
+tlsf_static_assert(FL_INDEX_COUNT > 0);
+
 /*
 ** Data structures and associated constants.
 */
@@ -298,18 +423,39 @@ tlsf_static_assert(ALIGN_SIZE == SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
 **   previous block. It appears at the beginning of this structure only to
 **   simplify the implementation.
 ** - The next_free / prev_free fields are only valid if the block is free.
+** - With an alignment larger than the header word, padding in front of
+**   the size field keeps the header overhead a multiple of ALIGN_SIZE, so
+**   every user pointer stays aligned.
+** - With TLSF_OFFSET_HEADERS the links are signed 32-bit distances from
+**   the block holding them, counted in header words, and the size is 32
+**   bits. The minimum block drops to 16 bytes on 64-bit targets. The
+**   links are only read and written through block_link_get/block_link_to.
 */
+#if TLSF_OFFSET_HEADERS
+typedef int tlsf_link_t;
+typedef unsigned int tlsf_size_field_t;
+#define TLSF_HEADER_WORD 4
+#else
+typedef struct block_header_t* tlsf_link_t;
+typedef size_t tlsf_size_field_t;
+#define TLSF_HEADER_WORD TLSF_WORD_SIZE
+#endif
+
 typedef struct block_header_t
 {
     /* Points to the previous physical block. */
-    struct block_header_t* prev_phys_block;
+    tlsf_link_t prev_phys_block;
+
+#if TLSF_ALIGN_SIZE > TLSF_HEADER_WORD
+    unsigned char align_padding[TLSF_ALIGN_SIZE - TLSF_HEADER_WORD];
+#endif
 
     /* The size of this block, excluding the block header. */
-    size_t size;
+    tlsf_size_field_t size;
 
     /* Next and previous free blocks. */
-    struct block_header_t* next_free;
-    struct block_header_t* prev_free;
+    tlsf_link_t next_free;
+    tlsf_link_t prev_free;
 } block_header_t;
 
 /*
@@ -322,39 +468,96 @@ static const size_t block_header_free_bit = 1 << 0;
 static const size_t block_header_prev_free_bit = 1 << 1;
 
 /*
-** The size of the block header exposed to used blocks is the size field.
-** The prev_phys_block field is stored *inside* the previous free block.
+** The size of the block header exposed to used blocks is the size field
+** and any alignment padding. The prev_phys_block field is stored *inside*
+** the previous free block.
 */
-static const size_t block_header_overhead = sizeof(size_t);
+static const size_t block_header_overhead =
+        offsetof(block_header_t, size) + sizeof(tlsf_size_field_t) - sizeof(tlsf_link_t);
 
 /* User data starts directly after the size field in a used block. */
 static const size_t block_start_offset =
-        offsetof(block_header_t, size) + sizeof(size_t);
+        offsetof(block_header_t, size) + sizeof(tlsf_size_field_t);
 
 /*
-** A free block must be large enough to store its header minus the size of
-** the prev_phys_block field, and no larger than the number of addressable
-** bits for FL_INDEX.
+** The next block's header starts this many bytes before the end of a
+** block's payload, its prev_phys_block field overlaps the last word.
+*/
+static const size_t block_header_link = sizeof(tlsf_link_t);
+
+/*
+** A free block must be large enough to store the free list links and the
+** next block's prev_phys_block field, rounded up to the alignment, and no
+** larger than the number of addressable bits for FL_INDEX.
 */
 static const size_t block_size_min =
-        sizeof(block_header_t) - sizeof(block_header_t*);
+        (sizeof(block_header_t) - offsetof(block_header_t, next_free)
+         + sizeof(tlsf_link_t) + ALIGN_SIZE - 1) & ~(size_t)(ALIGN_SIZE - 1);
 static const size_t block_size_max = tlsf_cast(size_t, 1) << FL_INDEX_MAX;
 
 
+/*
+** Bytes taken by the fields at the front of control_t, rounded up to a
+** cache line. Overestimates by a pointer to cover struct padding.
+*/
+#if TLSF_CACHE_LINE_SIZE > 0
+#define TLSF_CONTROL_HOT_SIZE \
+        ((sizeof(tlsf_bitmap_t) * (FL_INDEX_COUNT + 1) + sizeof(block_header_t) \
+          + sizeof(void*) + TLSF_CACHE_LINE_SIZE - 1) & ~(size_t)(TLSF_CACHE_LINE_SIZE - 1))
+#else
+#define TLSF_CONTROL_HOT_SIZE 1
+#endif
+
 /* The TLSF control structure. */
 typedef struct control_t
 {
-    /* Empty lists point at this block to indicate they are free. */
-    block_header_t block_null;
+    union
+    {
+        struct
+        {
+            /*
+            ** Bitmaps for free lists. fl_bitmap shares the first line
+            ** with the second-level maps of the small size classes.
+            */
+            tlsf_bitmap_t fl_bitmap;
+            tlsf_bitmap_t sl_bitmap[FL_INDEX_COUNT];
+
+            /*
+            ** Empty lists point at this block to indicate they are free.
+            ** Every unlink of a list's last block writes it, so it stays
+            ** next to the bitmaps that get updated at the same time.
+            */
+            block_header_t block_null;
+        };
+
+        /* Pads the fields above so the list heads start on a new line. */
+        unsigned char hot_lines[TLSF_CONTROL_HOT_SIZE];
+    };
 
-    /* Bitmaps for free lists. */
-    unsigned int fl_bitmap;
-    unsigned int sl_bitmap[FL_INDEX_COUNT];
+    /*
+    ** Head of free lists, each first-level row starts on a cache line.
+    ** Links from block_null like the ones in the block headers, so with
+    ** TLSF_OFFSET_HEADERS the control holds no absolute addresses and a
+    ** heap can be mapped at a different address in every process.
+    */
+    tlsf_link_t blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
 
-    /* Head of free lists. */
-    block_header_t* blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    /*
+    ** Freed blocks waiting to be coalesced. They stay marked as used so
+    ** their neighbors never merge with them, and are handed straight back
+    ** to same-sized requests.
+    */
+    int deferred_enabled;
+    unsigned int deferred_count;
+    tlsf_link_t deferred[DEFERRED_FREE_COUNT];
+#endif
 } control_t;
 
+#if TLSF_CACHE_LINE_SIZE > 0
+tlsf_static_assert(offsetof(control_t, blocks) % TLSF_CACHE_LINE_SIZE == 0);
+#endif
+
 /* A type used for casting when doing pointer arithmetic. */
 typedef ptrdiff_t tlsfptr_t;
 
@@ -370,7 +573,8 @@ static size_t block_size(const block_header_t* block)
 static void block_set_size(block_header_t* block, size_t size)
 {
     const size_t oldsize = block->size;
-    block->size = size | (oldsize & (block_header_free_bit | block_header_prev_free_bit));
+    block->size = tlsf_cast(tlsf_size_field_t,
+                            size | (oldsize & (block_header_free_bit | block_header_prev_free_bit)));
 }
 
 static int block_is_last(const block_header_t* block)
@@ -420,6 +624,63 @@ static void* block_to_ptr(const block_header_t* block)
                      tlsf_cast(unsigned char*, block) + block_start_offset);
 }
 
+/* Resolve a link stored in a block's header. */
+static block_header_t* block_link_get(const block_header_t* block, tlsf_link_t link)
+{
+#if TLSF_OFFSET_HEADERS
+    return tlsf_cast(block_header_t*,
+                     tlsf_cast(tlsfptr_t, block) + tlsf_cast(tlsfptr_t, link) * TLSF_HEADER_WORD);
+#else
+    (void)block;
+    return link;
+#endif
+}
+
+/* Build a link from a block's header to target. */
+static tlsf_link_t block_link_to(const block_header_t* block, block_header_t* target)
+{
+#if TLSF_OFFSET_HEADERS
+    const tlsfptr_t distance =
+            (tlsf_cast(tlsfptr_t, target) - tlsf_cast(tlsfptr_t, block)) / TLSF_HEADER_WORD;
+    tlsf_assert(distance == tlsf_cast(tlsf_link_t, distance) && "block out of link range");
+    return tlsf_cast(tlsf_link_t, distance);
+#else
+    (void)block;
+    return target;
+#endif
+}
+
+static block_header_t* block_free_next(const block_header_t* block)
+{
+    return block_link_get(block, block->next_free);
+}
+
+static block_header_t* block_free_prev(const block_header_t* block)
+{
+    return block_link_get(block, block->prev_free);
+}
+
+static void block_set_free_next(block_header_t* block, block_header_t* next)
+{
+    block->next_free = block_link_to(block, next);
+}
+
+static void block_set_free_prev(block_header_t* block, block_header_t* prev)
+{
+    block->prev_free = block_link_to(block, prev);
+}
+
+/* Links held by the control structure are relative to its null block. */
+static block_header_t* control_link_get(const control_t* control, tlsf_link_t link)
+{
+    return block_link_get(&control->block_null, link);
+}
+
+static tlsf_link_t control_link_to(const control_t* control, block_header_t* block)
+{
+    return block_link_to(&control->block_null, block);
+}
+
 /* Return location of next block after block of given size. */
 static block_header_t* offset_to_block(const void* ptr, size_t size)
 {
@@ -430,14 +691,14 @@ static block_header_t* offset_to_block(const void* ptr, size_t size)
 static block_header_t* block_prev(const block_header_t* block)
 {
     tlsf_assert(block_is_prev_free(block) && "previous block must be free");
-    return block->prev_phys_block;
+    return block_link_get(block, block->prev_phys_block);
 }
 
 /* Return location of next existing block. */
 static block_header_t* block_next(const block_header_t* block)
 {
     block_header_t* next = offset_to_block(block_to_ptr(block),
-                                           block_size(block) - block_header_overhead);
+                                           block_size(block) - block_header_link);
     tlsf_assert(!block_is_last(block));
     return next;
 }
@@ -446,7 +707,7 @@ static block_header_t* block_next(const block_header_t* block)
 static block_header_t* block_link_next(block_header_t* block)
 {
     block_header_t* next = block_next(block);
-    next->prev_phys_block = block;
+    next->prev_phys_block = block_link_to(next, block);
     return next;
 }
 
@@ -534,7 +795,7 @@ static void mapping_search(size_t size, int* fli, int* sli)
 {
     if (size >= SMALL_BLOCK_SIZE)
     {
-        const size_t round = (1 << (tlsf_fls_sizet(size) - SL_INDEX_COUNT_LOG2)) - 1;
+        const size_t round = (tlsf_cast(size_t, 1) << (tlsf_fls_sizet(size) - SL_INDEX_COUNT_LOG2)) - 1;
         size += round;
     }
     mapping_insert(size, fli, sli);
@@ -549,53 +810,59 @@ static block_header_t* search_suitable_block(control_t* control, int* fli, int*
     ** First, search for a block in the list associated with the given
     ** fl/sl index.
     */
-    unsigned int sl_map = control->sl_bitmap[fl] & (~0U << sl);
+    tlsf_bitmap_t sl_map = control->sl_bitmap[fl] & (~tlsf_cast(tlsf_bitmap_t, 0) << sl);
     if (!sl_map)
     {
         /* No block exists. Search in the next largest first-level list. */
-        const unsigned int fl_map = control->fl_bitmap & (~0U << (fl + 1));
+        const tlsf_bitmap_t fl_map = control->fl_bitmap & (~tlsf_cast(tlsf_bitmap_t, 0) << (fl + 1));
         if (!fl_map)
         {
             /* No free blocks available, memory has been exhausted. */
             return 0;
         }
 
-        fl = tlsf_ffs(fl_map);
+        fl = tlsf_ffs_bitmap(fl_map);
         *fli = fl;
         sl_map = control->sl_bitmap[fl];
     }
     tlsf_assert(sl_map && "internal error - second level bitmap is null");
-    sl = tlsf_ffs(sl_map);
+    sl = tlsf_ffs_bitmap(sl_map);
     *sli = sl;
 
     /* Return the first block in the free list. */
-    return control->blocks[fl][sl];
+    return control_link_get(control, control->blocks[fl][sl]);
 }
 
 /* Remove a free block from the free list.*/
 static void remove_free_block(control_t* control, block_header_t* block, int fl, int sl)
 {
-    block_header_t* prev = block->prev_free;
-    block_header_t* next = block->next_free;
+    block_header_t* prev = block_free_prev(block);
+    block_header_t* next = block_free_next(block);
     tlsf_assert(prev && "prev_free field can not be null");
     tlsf_assert(next && "next_free field can not be null");
-    next->prev_free = prev;
-    prev->next_free = next;
+    block_set_free_prev(next, prev);
+    block_set_free_next(prev, next);
 
     /* If this block is the head of the free list, set new head. */
-    if (control->blocks[fl][sl] == block)
+    if (control_link_get(control, control->blocks[fl][sl]) == block)
     {
-        control->blocks[fl][sl] = next;
+        control->blocks[fl][sl] = control_link_to(control, next);
+
+        /*
+        ** The new head was just written so it is cached, the block after
+        ** it is what the next pop from this list will write to.
+        */
+        tlsf_prefetch(block_free_next(next));
 
         /* If the new head is null, clear the bitmap. */
         if (next == &control->block_null)
         {
-            control->sl_bitmap[fl] &= ~(1U << sl);
+            control->sl_bitmap[fl] &= ~(tlsf_cast(tlsf_bitmap_t, 1) << sl);
 
             /* If the second bitmap is now empty, clear the fl bitmap. */
             if (!control->sl_bitmap[fl])
             {
-                control->fl_bitmap &= ~(1U << fl);
+                control->fl_bitmap &= ~(tlsf_cast(tlsf_bitmap_t, 1) << fl);
             }
         }
     }
@@ -604,12 +871,12 @@ static void remove_free_block(control_t* control, block_header_t* block, int fl,
 /* Insert a free block into the free block list. */
 static void insert_free_block(control_t* control, block_header_t* block, int fl, int sl)
 {
-    block_header_t* current = control->blocks[fl][sl];
+    block_header_t* current = control_link_get(control, control->blocks[fl][sl]);
     tlsf_assert(current && "free list cannot have a null entry");
     tlsf_assert(block && "cannot insert a null entry into the free list");
-    block->next_free = current;
-    block->prev_free = &control->block_null;
-    current->prev_free = block;
+    block_set_free_next(block, current);
+    block_set_free_prev(block, &control->block_null);
+    block_set_free_prev(current, block);
 
     tlsf_assert(block_to_ptr(block) == align_ptr(block_to_ptr(block), ALIGN_SIZE)
                 && "block not aligned properly");
@@ -617,9 +884,9 @@ static void insert_free_block(control_t* control, block_header_t* block, int fl,
     ** Insert the new block at the head of the list, and mark the first-
     ** and second-level bitmaps appropriately.
     */
-    control->blocks[fl][sl] = block;
-    control->fl_bitmap |= (1U << fl);
-    control->sl_bitmap[fl] |= (1U << sl);
+    control->blocks[fl][sl] = control_link_to(control, block);
+    control->fl_bitmap |= (tlsf_cast(tlsf_bitmap_t, 1) << fl);
+    control->sl_bitmap[fl] |= (tlsf_cast(tlsf_bitmap_t, 1) << sl);
 }
 
 /* Remove a given block from the free list. */
@@ -640,7 +907,7 @@ static void block_insert(control_t* control, block_header_t* block)
 
 static int block_can_split(block_header_t* block, size_t size)
 {
-    return block_size(block) >= sizeof(block_header_t) + size;
+    return block_size(block) >= block_size_min + block_header_overhead + size;
 }
 
 /* Split a block into two, the second of which is free. */
@@ -648,7 +915,7 @@ static block_header_t* block_split(block_header_t* block, size_t size)
 {
     /* Calculate the amount of space left in the remaining block. */
     block_header_t* remaining =
-            offset_to_block(block_to_ptr(block), size - block_header_overhead);
+            offset_to_block(block_to_ptr(block), size - block_header_link);
 
     const size_t remain_size = block_size(block) - (size + block_header_overhead);
 
@@ -750,6 +1017,41 @@ static block_header_t* block_trim_free_leading(control_t* control, block_header_
     return remaining_block;
 }
 
+/* A leading gap must be able to hold a free block of its own. */
+static size_t block_gap_minimum(void)
+{
+    return block_size_min + block_header_overhead;
+}
+
+/*
+** Distance from a free block's payload to the first suitably aligned
+** address that leaves either no gap or one large enough to trim off.
+*/
+static size_t block_align_gap(const block_header_t* block, size_t align)
+{
+    const size_t gap_minimum = block_gap_minimum();
+    void* ptr = block_to_ptr(block);
+    void* aligned = align_ptr(ptr, align);
+    size_t gap = tlsf_cast(size_t,
+                           tlsf_cast(tlsfptr_t, aligned) - tlsf_cast(tlsfptr_t, ptr));
+
+    /* If gap size is too small, offset to next aligned boundary. */
+    if (gap && gap < gap_minimum)
+    {
+        const size_t gap_remain = gap_minimum - gap;
+        const size_t offset = tlsf_max(gap_remain, align);
+        const void* next_aligned = tlsf_cast(void*,
+                                             tlsf_cast(tlsfptr_t, aligned) + offset);
+
+        aligned = align_ptr(next_aligned, align);
+        gap = tlsf_cast(size_t,
+                        tlsf_cast(tlsfptr_t, aligned) - tlsf_cast(tlsfptr_t, ptr));
+    }
+
+    tlsf_assert((!gap || gap >= gap_minimum) && "gap size too small");
+    return gap;
+}
+
 static block_header_t* block_locate_free(control_t* control, size_t size)
 {
     int fl = 0, sl = 0;
@@ -793,13 +1095,139 @@ static void* block_prepare_used(control_t* control, block_header_t* block, size_
     return p;
 }
 
+/* Return a used block to the free lists, coalescing with its neighbors. */
+static void block_release(control_t* control, block_header_t* block)
+{
+    block_mark_as_free(block);
+    block = block_merge_prev(control, block);
+    block = block_merge_next(control, block);
+    block_insert(control, block);
+}
+
+#if TLSF_DEFERRED_FREE_COUNT > 0
+/* Coalesce every parked block, oldest first. */
+static void deferred_flush(control_t* control)
+{
+    unsigned int i;
+    for (i = 0; i < control->deferred_count; ++i)
+    {
+        block_release(control, control_link_get(control, control->deferred[i]));
+    }
+    control->deferred_count = 0;
+}
+
+/* Park a freed block, flushing the list first if it is full. */
+static void deferred_push(control_t* control, block_header_t* block)
+{
+    if (control->deferred_count == DEFERRED_FREE_COUNT)
+    {
+        deferred_flush(control);
+    }
+    control->deferred[control->deferred_count++] = control_link_to(control, block);
+}
+
+/*
+** Take back a parked block for a request of the given size. Only blocks
+** from the same size class are reused, so a large parked block is never
+** carved up for a small request.
+*/
+static block_header_t* deferred_take(control_t* control, size_t size)
+{
+    unsigned int i = control->deferred_count;
+    int fl, sl;
+
+    if (!size || !i)
+    {
+        return 0;
+    }
+
+    mapping_insert(size, &fl, &sl);
+
+    /* Most recently freed first, its memory is the most likely to be cached. */
+    while (i--)
+    {
+        block_header_t* block = control_link_get(control, control->deferred[i]);
+        const size_t bsize = block_size(block);
+        int bfl, bsl;
+
+        mapping_insert(bsize, &bfl, &bsl);
+        if (bsize >= size && bfl == fl && bsl == sl)
+        {
+            control->deferred[i] = control->deferred[--control->deferred_count];
+            return block;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+/*
+** Grow a used block by absorbing a free previous neighbor, and the next
+** neighbor too if it is free. The payload is moved down to the start of
+** the previous block. Returns the new user pointer, or null if the
+** neighbors don't offer enough space or the previous block's payload
+** doesn't have the requested alignment.
+*/
+static void* block_grow_into_prev(control_t* control, block_header_t* block, size_t size, size_t align)
+{
+    block_header_t* prev;
+    size_t cursize;
+    size_t combined;
+    void* p;
+
+    if (!block_is_prev_free(block))
+    {
+        return 0;
+    }
+
+    prev = block_prev(block);
+    tlsf_assert(block_is_free(prev) && "prev block is not free though marked as such");
+
+    /* Moving down must not break the caller's alignment. */
+    if (tlsf_cast(tlsfptr_t, block_to_ptr(prev)) & (align - 1))
+    {
+        return 0;
+    }
+
+    cursize = block_size(block);
+    combined = block_size(prev) + cursize + block_header_overhead;
+    if (block_is_free(block_next(block)))
+    {
+        combined += block_size(block_next(block)) + block_header_overhead;
+    }
+
+    if (size > combined)
+    {
+        return 0;
+    }
+
+    /* Take the next block while our header is still intact. */
+    block = block_merge_next(control, block);
+    combined = block_size(prev) + block_size(block) + block_header_overhead;
+
+    /*
+    ** We can't block_absorb here: linking the next block would write into
+    ** the tail of the payload before it has been moved.
+    */
+    block_remove(control, prev);
+    p = block_to_ptr(prev);
+    memmove(p, block_to_ptr(block), cursize);
+
+    block_set_size(prev, combined);
+    block_mark_as_used(prev);
+    block_trim_used(control, prev, size);
+
+    return p;
+}
+
 /* Clear structure and point all empty lists at the null block. */
 static void control_construct(control_t* control)
 {
     int i, j;
 
-    control->block_null.next_free = &control->block_null;
-    control->block_null.prev_free = &control->block_null;
+    block_set_free_next(&control->block_null, &control->block_null);
+    block_set_free_prev(&control->block_null, &control->block_null);
 
     control->fl_bitmap = 0;
     for (i = 0; i < FL_INDEX_COUNT; ++i)
@@ -807,9 +1235,14 @@ static void control_construct(control_t* control)
         control->sl_bitmap[i] = 0;
         for (j = 0; j < SL_INDEX_COUNT; ++j)
         {
-            control->blocks[i][j] = &control->block_null;
+            control->blocks[i][j] = control_link_to(control, &control->block_null);
         }
     }
+
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    control->deferred_enabled = 0;
+    control->deferred_count = 0;
+#endif
 }
 
 /*
@@ -853,10 +1286,10 @@ int tlsf_check(tlsf_t tlsf)
     {
         for (j = 0; j < SL_INDEX_COUNT; ++j)
         {
-            const int fl_map = control->fl_bitmap & (1U << i);
-            const int sl_list = control->sl_bitmap[i];
-            const int sl_map = sl_list & (1U << j);
-            const block_header_t* block = control->blocks[i][j];
+            const tlsf_bitmap_t fl_map = control->fl_bitmap & (tlsf_cast(tlsf_bitmap_t, 1) << i);
+            const tlsf_bitmap_t sl_list = control->sl_bitmap[i];
+            const tlsf_bitmap_t sl_map = sl_list & (tlsf_cast(tlsf_bitmap_t, 1) << j);
+            const block_header_t* block = control_link_get(control, control->blocks[i][j]);
 
             /* Check that first- and second-level lists agree. */
             if (!fl_map)
@@ -885,7 +1318,7 @@ int tlsf_check(tlsf_t tlsf)
 
                 mapping_insert(block_size(block), &fli, &sli);
                 tlsf_insist(fli == i && sli == j && "block size indexed in wrong list");
-                block = block->next_free;
+                block = block_free_next(block);
             }
         }
     }
@@ -905,7 +1338,7 @@ void tlsf_walk_pool(pool_t pool, tlsf_walker walker, void* user)
 {
     tlsf_walker pool_walker = walker ? walker : default_walker;
     block_header_t* block =
-            offset_to_block(pool, -(int)block_header_overhead);
+            offset_to_block(pool, -(int)block_header_link);
 
     while (block && !block_is_last(block))
     {
@@ -944,7 +1377,8 @@ int tlsf_check_pool(pool_t pool)
 */
 size_t tlsf_size(void)
 {
-    return sizeof(control_t);
+    /* Rounded up so a pool placed right after the control stays aligned. */
+    return align_up(sizeof(control_t), ALIGN_SIZE);
 }
 
 size_t tlsf_align_size(void)
@@ -952,6 +1386,11 @@ size_t tlsf_align_size(void)
     return ALIGN_SIZE;
 }
 
+size_t tlsf_control_align(void)
+{
+    return tlsf_max(tlsf_cast(size_t, TLSF_CACHE_LINE_SIZE), tlsf_cast(size_t, ALIGN_SIZE));
+}
+
 size_t tlsf_block_size_min(void)
 {
     return block_size_min;
@@ -977,6 +1416,34 @@ size_t tlsf_alloc_overhead(void)
     return block_header_overhead;
 }
 
+/*
+** Size of the smallest free block a search for size bytes at the given
+** alignment always takes: the request with its alignment gap, rounded up
+** to the start of the next second level list the way mapping_search does.
+** A pool serves the request for sure once it is this size plus
+** tlsf_pool_overhead. Returns 0 if no block could ever serve it.
+*/
+size_t tlsf_fit_size(size_t size, size_t align)
+{
+    size_t fit = adjust_request_size(size, ALIGN_SIZE);
+
+    if (fit && align > ALIGN_SIZE)
+    {
+        fit = adjust_request_size(fit + align + block_gap_minimum(), align);
+    }
+
+    if (fit >= SMALL_BLOCK_SIZE)
+    {
+        const size_t round = (tlsf_cast(size_t, 1) << (tlsf_fls_sizet(fit) - SL_INDEX_COUNT_LOG2)) - 1;
+        fit += round;
+
+        /* Down to the start of the list it maps to, which may be a level up. */
+        fit &= ~((tlsf_cast(size_t, 1) << (tlsf_fls_sizet(fit) - SL_INDEX_COUNT_LOG2)) - 1);
+    }
+
+    return fit < block_size_max ? fit : 0;
+}
+
 pool_t tlsf_add_pool(tlsf_t tlsf, void* mem, size_t bytes)
 {
     block_header_t* block;
@@ -1006,12 +1473,26 @@ pool_t tlsf_add_pool(tlsf_t tlsf, void* mem, size_t bytes)
         return 0;
     }
 
+#if TLSF_OFFSET_HEADERS && defined (TLSF_64BIT)
+    /* Free list links from this pool must reach the control's null block. */
+    {
+        const tlsfptr_t reach = tlsf_cast(tlsfptr_t, INT_MAX) * TLSF_HEADER_WORD;
+        const tlsfptr_t start = tlsf_cast(tlsfptr_t, mem) - tlsf_cast(tlsfptr_t, tlsf);
+        const tlsfptr_t end = start + tlsf_cast(tlsfptr_t, bytes);
+        if (start < -reach || end > reach)
+        {
+            printf("tlsf_add_pool: Memory must lie within 8 GB of the tlsf instance.\n");
+            return 0;
+        }
+    }
+#endif
+
     /*
     ** Create the main free block. Offset the start of the block slightly
     ** so that the prev_phys_block field falls outside of the pool -
     ** it will never be used.
     */
-    block = offset_to_block(mem, -(tlsfptr_t)block_header_overhead);
+    block = offset_to_block(mem, -(tlsfptr_t)block_header_link);
     block_set_size(block, pool_bytes);
     block_set_free(block);
     block_set_prev_used(block);
@@ -1029,10 +1510,15 @@ pool_t tlsf_add_pool(tlsf_t tlsf, void* mem, size_t bytes)
 void tlsf_remove_pool(tlsf_t tlsf, pool_t pool)
 {
     control_t* control = tlsf_cast(control_t*, tlsf);
-    block_header_t* block = offset_to_block(pool, -(int)block_header_overhead);
+    block_header_t* block = offset_to_block(pool, -(int)block_header_link);
 
     int fl = 0, sl = 0;
 
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    /* Parked blocks still look used and would keep the pool from being whole. */
+    deferred_flush(control);
+#endif
+
     tlsf_assert(block_is_free(block) && "block should be free");
     tlsf_assert(!block_is_free(block_next(block)) && "next block should not be free");
     tlsf_assert(block_size(block_next(block)) == 0 && "next block size should be zero");
@@ -1116,7 +1602,28 @@ void* tlsf_malloc(tlsf_t tlsf, size_t size)
 {
     control_t* control = tlsf_cast(control_t*, tlsf);
     const size_t adjust = adjust_request_size(size, ALIGN_SIZE);
-    block_header_t* block = block_locate_free(control, adjust);
+    block_header_t* block;
+
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    block = deferred_take(control, adjust);
+    if (block)
+    {
+        block_trim_used(control, block, adjust);
+        return block_to_ptr(block);
+    }
+#endif
+
+    block = block_locate_free(control, adjust);
+
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    /* Coalescing the parked blocks may produce a large enough block. */
+    if (!block && adjust && control->deferred_count)
+    {
+        deferred_flush(control);
+        block = block_locate_free(control, adjust);
+    }
+#endif
+
     return block_prepare_used(control, block, adjust);
 }
 
@@ -1133,8 +1640,7 @@ void* tlsf_memalign(tlsf_t tlsf, size_t align, size_t size)
     ** the prev_phys_block field is not valid, and we can't simply adjust
     ** the size of that block.
     */
-    const size_t gap_minimum = sizeof(block_header_t);
-    const size_t size_with_gap = adjust_request_size(adjust + align + gap_minimum, align);
+    const size_t size_with_gap = adjust_request_size(adjust + align + block_gap_minimum(), align);
 
     /*
     ** If alignment is less than or equals base alignment, we're done.
@@ -1142,34 +1648,52 @@ void* tlsf_memalign(tlsf_t tlsf, size_t align, size_t size)
     */
     const size_t aligned_size = (adjust && align > ALIGN_SIZE) ? size_with_gap : adjust;
 
-    block_header_t* block = block_locate_free(control, aligned_size);
-
-    /* This can't be a static assert. */
-    tlsf_assert(sizeof(block_header_t) == block_size_min + block_header_overhead);
+    block_header_t* block = 0;
 
-    if (block)
+    /*
+    ** The first block big enough for the plain request is often already
+    ** aligned, or has room for the gap. Try it before asking for the worst
+    ** case, which costs a whole extra alignment per allocation. A gap is
+    ** only trimmed off if it can be split into a free block of its own,
+    ** anything less would hand back a misaligned pointer.
+    */
+    if (aligned_size != adjust)
     {
-        void* ptr = block_to_ptr(block);
-        void* aligned = align_ptr(ptr, align);
-        size_t gap = tlsf_cast(size_t,
-                               tlsf_cast(tlsfptr_t, aligned) - tlsf_cast(tlsfptr_t, ptr));
-
-        /* If gap size is too small, offset to next aligned boundary. */
-        if (gap && gap < gap_minimum)
+        block = block_locate_free(control, adjust);
+        if (block)
         {
-            const size_t gap_remain = gap_minimum - gap;
-            const size_t offset = tlsf_max(gap_remain, align);
-            const void* next_aligned = tlsf_cast(void*,
-                                                 tlsf_cast(tlsfptr_t, aligned) + offset);
-
-            aligned = align_ptr(next_aligned, align);
-            gap = tlsf_cast(size_t,
-                            tlsf_cast(tlsfptr_t, aligned) - tlsf_cast(tlsfptr_t, ptr));
+            const size_t gap = block_align_gap(block, align);
+            const size_t needed = gap ? gap + block_size_min + block_header_overhead + adjust : adjust;
+
+            if (block_size(block) < needed)
+            {
+                block_insert(control, block);
+                block = 0;
+            }
         }
+    }
+
+    if (!block)
+    {
+        block = block_locate_free(control, aligned_size);
+    }
+
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    if (!block && aligned_size && control->deferred_count)
+    {
+        deferred_flush(control);
+        block = block_locate_free(control, aligned_size);
+    }
+#endif
+
+    /* This can't be a static assert. */
+    tlsf_assert(block_header_overhead % ALIGN_SIZE == 0);
 
+    if (block)
+    {
+        const size_t gap = block_align_gap(block, align);
         if (gap)
         {
-            tlsf_assert(gap >= gap_minimum && "gap size too small");
             block = block_trim_free_leading(control, block, gap);
         }
     }
@@ -1185,14 +1709,42 @@ void tlsf_free(tlsf_t tlsf, void* ptr)
         control_t* control = tlsf_cast(control_t*, tlsf);
         block_header_t* block = block_from_ptr(ptr);
         tlsf_assert(!block_is_free(block) && "block already marked as free");
-        block_mark_as_free(block);
-        block = block_merge_prev(control, block);
-        block = block_merge_next(control, block);
-        block_insert(control, block);
+#if TLSF_DEFERRED_FREE_COUNT > 0
+        if (control->deferred_enabled)
+        {
+            deferred_push(control, block);
+            return;
+        }
+#endif
+        block_release(control, block);
     }
 	ptr = NULL;
 }
 
+void tlsf_set_deferred_free(tlsf_t tlsf, int enable)
+{
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    control_t* control = tlsf_cast(control_t*, tlsf);
+    if (!enable)
+    {
+        deferred_flush(control);
+    }
+    control->deferred_enabled = enable ? 1 : 0;
+#else
+    (void)tlsf;
+    (void)enable;
+#endif
+}
+
+void tlsf_compact(tlsf_t tlsf)
+{
+#if TLSF_DEFERRED_FREE_COUNT > 0
+    deferred_flush(tlsf_cast(control_t*, tlsf));
+#else
+    (void)tlsf;
+#endif
+}
+
 /*
 ** The TLSF block information provides us with enough information to
 ** provide a reasonably intelligent implementation of realloc, growing or
@@ -1205,8 +1757,21 @@ void tlsf_free(tlsf_t tlsf, void* ptr)
 **   untouched
 ** - an extended buffer size will leave the newly-allocated area with
 **   contents undefined
+** - growth absorbs free neighbors on either side before falling back to
+**   allocating and copying; growing into the previous block moves the
+**   buffer, so the returned pointer may differ even when no copy was made
+**   to a new block
 */
 void* tlsf_realloc(tlsf_t tlsf, void* ptr, size_t size)
+{
+    return tlsf_realloc_aligned(tlsf, ptr, ALIGN_SIZE, size);
+}
+
+/*
+** Same as tlsf_realloc, but a moved block keeps the given alignment. The
+** original block must have been allocated with at least that alignment.
+*/
+void* tlsf_realloc_aligned(tlsf_t tlsf, void* ptr, size_t align, size_t size)
 {
     control_t* control = tlsf_cast(control_t*, tlsf);
     void* p = 0;
@@ -1219,7 +1784,7 @@ void* tlsf_realloc(tlsf_t tlsf, void* ptr, size_t size)
         /* Requests with NULL pointers are treated as malloc. */
     else if (!ptr)
     {
-        p = tlsf_malloc(tlsf, size);
+        p = align > ALIGN_SIZE ? tlsf_memalign(tlsf, align, size) : tlsf_malloc(tlsf, size);
     }
     else
     {
@@ -1234,16 +1799,21 @@ void* tlsf_realloc(tlsf_t tlsf, void* ptr, size_t size)
 
         /*
         ** If the next block is used, or when combined with the current
-        ** block, does not offer enough space, we must reallocate and copy.
+        ** block, does not offer enough space, try sliding down into a free
+        ** previous block before we reallocate and copy.
         */
         if (adjust > cursize && (!block_is_free(next) || adjust > combined))
         {
-            p = tlsf_malloc(tlsf, size);
-            if (p)
+            p = block_grow_into_prev(control, block, adjust, align);
+            if (!p)
             {
-                const size_t minsize = tlsf_min(cursize, size);
-                memcpy(p, ptr, minsize);
-                tlsf_free(tlsf, ptr);
+                p = align > ALIGN_SIZE ? tlsf_memalign(tlsf, align, size) : tlsf_malloc(tlsf, size);
+                if (p)
+                {
+                    const size_t minsize = tlsf_min(cursize, size);
+                    memcpy(p, ptr, minsize);
+                    tlsf_free(tlsf, ptr);
+                }
             }
         }
         else
@@ -1264,9 +1834,79 @@ void* tlsf_realloc(tlsf_t tlsf, void* ptr, size_t size)
     return p;
 }
 
+size_t tlsf_expand(tlsf_t tlsf, void* ptr, size_t min_size, size_t max_size)
+{
+    control_t* control = tlsf_cast(control_t*, tlsf);
+    block_header_t* block;
+    block_header_t* next;
+    size_t cursize, combined, min_adjust, max_adjust;
+
+    if (!ptr)
+    {
+        return 0;
+    }
+
+    block = block_from_ptr(ptr);
+    cursize = block_size(block);
+    tlsf_assert(!block_is_free(block) && "block already marked as free");
+
+    /* Already big enough, nothing to do. */
+    if (min_size <= cursize)
+    {
+        return cursize;
+    }
+
+    min_adjust = adjust_request_size(min_size, ALIGN_SIZE);
+    if (!min_adjust)
+    {
+        return 0;
+    }
+
+    next = block_next(block);
+    if (!block_is_free(next))
+    {
+        return 0;
+    }
+
+    combined = cursize + block_size(next) + block_header_overhead;
+    if (min_adjust > combined)
+    {
+        return 0;
+    }
+
+    /* Take as much of the next block as max_size allows, return the rest. */
+    max_adjust = tlsf_max(min_adjust, align_down(max_size, ALIGN_SIZE));
+    if (max_adjust > combined)
+    {
+        max_adjust = combined;
+    }
+
+    /*
+    ** A rest too small to be a free block would stay in this one and take it
+    ** past max_size. Leave room for the smallest free block instead, or fail
+    ** if that puts the block under min_size.
+    */
+    if (max_adjust < combined && combined - max_adjust < block_size_min + block_header_overhead)
+    {
+        if (combined - min_adjust < block_size_min + block_header_overhead)
+        {
+            return 0;
+        }
+        max_adjust = align_down(combined - block_size_min - block_header_overhead, ALIGN_SIZE);
+    }
+
+    block_merge_next(control, block);
+    block_mark_as_used(block);
+    block_trim_used(control, block, max_adjust);
+
+    return block_size(block);
+}
+
 void *tlsf_calloc(tlsf_t tlsf, size_t elem_size, size_t num_elems){
 
 	void *ptr = tlsf_malloc(tlsf, elem_size * num_elems);
-	memset(ptr, 0, elem_size * num_elems);
+	if (ptr) {
+		memset(ptr, 0, elem_size * num_elems);
+	}
 	return ptr;
 }
\ No newline at end of file
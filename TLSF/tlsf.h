@@ -63,19 +63,41 @@ void tlsf_remove_pool(tlsf_t tlsf, pool_t pool);
 void* tlsf_malloc(tlsf_t tlsf, size_t bytes);
 void* tlsf_memalign(tlsf_t tlsf, size_t align, size_t bytes);
 void* tlsf_realloc(tlsf_t tlsf, void* ptr, size_t size);
+void* tlsf_realloc_aligned(tlsf_t tlsf, void* ptr, size_t align, size_t size);
 void* tlsf_calloc(tlsf_t tlsf, size_t elem_size, size_t num_elems);
 void tlsf_free(tlsf_t tlsf, void* ptr);
 
+/*
+** Grow a used block in place to at least min_size and at most max_size
+** bytes. Returns the new internal block size, or 0 if the block can't
+** end up in that range without moving; the block is left untouched on
+** failure. A block already min_size or larger is returned as it is.
+*/
+size_t tlsf_expand(tlsf_t tlsf, void* ptr, size_t min_size, size_t max_size);
+
+/*
+** Deferred coalescing. When enabled, freed blocks are parked in a small
+** per-instance list and reused directly by same-sized requests; they are
+** coalesced when a search fails, when the list fills up, or on
+** tlsf_compact. Disabling the mode flushes the list.
+*/
+void tlsf_set_deferred_free(tlsf_t tlsf, int enable);
+void tlsf_compact(tlsf_t tlsf);
+
 /* Returns internal block size, not original request size */
 size_t tlsf_block_size(void* ptr);
 
 /* Overheads/limits of internal structures. */
 size_t tlsf_size(void);
 size_t tlsf_align_size(void);
+/* Alignment the memory given to tlsf_create should have for the cache line layout. */
+size_t tlsf_control_align(void);
 size_t tlsf_block_size_min(void);
 size_t tlsf_block_size_max(void);
 size_t tlsf_pool_overhead(void);
 size_t tlsf_alloc_overhead(void);
+/* Free block size sure to serve size bytes at align, 0 if nothing can. */
+size_t tlsf_fit_size(size_t size, size_t align);
 
 /* Debugging. */
 typedef void (*tlsf_walker)(void* ptr, size_t size, int used, void* user);
@@ -0,0 +1,8 @@
+/*
+** Fine-grained TLSF: 64 second-level lists per power of two, tracked in
+** 64-bit bitmaps, for heaps where size-class rounding causes fragmentation.
+*/
+#define TLSF_PREFIX tlsf_fine
+#define TLSF_SL_INDEX_COUNT_LOG2 6
+
+#include "tlsf.c"
@@ -0,0 +1,8 @@
+/*
+** Large-heap TLSF: first-level lists reach 1 TB, more than 32 of them, so
+** the first-level bitmap is 64 bits wide.
+*/
+#define TLSF_PREFIX tlsf_large
+#define TLSF_FL_INDEX_MAX 40
+
+#include "tlsf.c"
@@ -0,0 +1,11 @@
+/*
+** Packed-header TLSF: free list and physical links are 32-bit offsets
+** instead of pointers, so the minimum block is 16 bytes rather than 24 on
+** 64-bit targets. Blocks are limited to 256 MB and every pool has to be
+** mapped within 8 GB of the control structure.
+*/
+#define TLSF_PREFIX tlsf_packed
+#define TLSF_OFFSET_HEADERS 1
+#define TLSF_FL_INDEX_MAX 28
+
+#include "tlsf.c"
@@ -0,0 +1,50 @@
+#ifndef INCLUDED_tlsf_prefix
+#define INCLUDED_tlsf_prefix
+
+/*
+** Renames the public TLSF entry points so tlsf.c can be compiled several
+** times with different configurations in one program. Define TLSF_PREFIX
+** (and any configuration overrides) before including tlsf.c, e.g.
+**
+**	#define TLSF_PREFIX tlsf_small
+**	#define TLSF_FL_INDEX_MAX 24
+**	#include "tlsf.c"
+**
+** builds tlsf_small_malloc, tlsf_small_free and so on. The matching
+** declarations live in tlsf_variants.h.
+*/
+
+#define _tlsf_prefix2(p, name) p ## _ ## name
+#define _tlsf_prefix(p, name) _tlsf_prefix2(p, name)
+#define tlsf_prefixed(name) _tlsf_prefix(TLSF_PREFIX, name)
+
+#define tlsf_create tlsf_prefixed(create)
+#define tlsf_create_with_pool tlsf_prefixed(create_with_pool)
+#define tlsf_destroy tlsf_prefixed(destroy)
+#define tlsf_get_pool tlsf_prefixed(get_pool)
+#define tlsf_add_pool tlsf_prefixed(add_pool)
+#define tlsf_remove_pool tlsf_prefixed(remove_pool)
+#define tlsf_malloc tlsf_prefixed(malloc)
+#define tlsf_memalign tlsf_prefixed(memalign)
+#define tlsf_realloc tlsf_prefixed(realloc)
+#define tlsf_realloc_aligned tlsf_prefixed(realloc_aligned)
+#define tlsf_calloc tlsf_prefixed(calloc)
+#define tlsf_free tlsf_prefixed(free)
+#define tlsf_expand tlsf_prefixed(expand)
+#define tlsf_set_deferred_free tlsf_prefixed(set_deferred_free)
+#define tlsf_compact tlsf_prefixed(compact)
+#define tlsf_block_size tlsf_prefixed(block_size)
+#define tlsf_size tlsf_prefixed(size)
+#define tlsf_align_size tlsf_prefixed(align_size)
+#define tlsf_control_align tlsf_prefixed(control_align)
+#define tlsf_block_size_min tlsf_prefixed(block_size_min)
+#define tlsf_block_size_max tlsf_prefixed(block_size_max)
+#define tlsf_pool_overhead tlsf_prefixed(pool_overhead)
+#define tlsf_alloc_overhead tlsf_prefixed(alloc_overhead)
+#define tlsf_fit_size tlsf_prefixed(fit_size)
+#define tlsf_walk_pool tlsf_prefixed(walk_pool)
+#define tlsf_check tlsf_prefixed(check)
+#define tlsf_check_pool tlsf_prefixed(check_pool)
+#define test_ffs_fls tlsf_prefixed(test_ffs_fls)
+
+#endif
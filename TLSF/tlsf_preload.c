@@ -0,0 +1,543 @@
+/*
+** malloc replacement on TLSF for running unmodified programs:
+**
+**	LD_PRELOAD=./libtlsf_preload.so sort big.txt
+**
+** Everything below the huge threshold comes from TLSF pools committed out
+** of one reserved address range, so free can tell our blocks from huge
+** mappings with a range check. Small blocks go through a per-thread cache
+** and only touch the global lock in batches.
+**
+** Nothing here calls into libc's allocator: the heap is set up with mmap on
+** the first request, which may come from the dynamic loader or another
+** library's constructor before ours has run.
+*/
+#define _GNU_SOURCE
+#define TLSF_PREFIX tlsf_preload
+#define TLSF_ALIGN_SIZE 16
+
+#include "tlsf.c"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define PRELOAD_EXPORT __attribute__((visibility("default")))
+
+// Address space for the pools, halved until the kernel agrees
+#define PRELOAD_RESERVE ((size_t)1 << 36)
+#define PRELOAD_RESERVE_MIN ((size_t)1 << 30)
+
+#define PRELOAD_POOL_SIZE ((size_t)(1 << 20) * 64)
+
+// Requests from here up get their own mapping, like glibc's mmap threshold
+#define PRELOAD_HUGE_THRESHOLD ((size_t)(1 << 20) * 8)
+
+// Thread cache: one list per 16 byte size class up to 496 bytes
+#define PRELOAD_CLASS_SHIFT 4
+#define PRELOAD_NUM_CLASSES 32
+#define PRELOAD_MAX_CACHED ((size_t)(PRELOAD_NUM_CLASSES - 1) << PRELOAD_CLASS_SHIFT)
+#define PRELOAD_CACHE_COUNT 64
+#define PRELOAD_BATCH 16
+
+typedef struct preload_cache {
+	void *heads[PRELOAD_NUM_CLASSES];
+	unsigned short counts[PRELOAD_NUM_CLASSES];
+
+	// 0 until the exit destructor is set, -1 once the thread is exiting and caching stops
+	int state;
+} preload_cache;
+
+// Sits right in front of every huge allocation
+typedef struct preload_huge_header {
+	void *map;
+	size_t length;
+	size_t align; // As requested, 0 for the default
+	uintptr_t magic; // PRELOAD_HUGE_MAGIC ^ map, tells our mappings from pointers some other allocator handed out
+} preload_huge_header;
+
+#define PRELOAD_HUGE_MAGIC ((uintptr_t)0x746c7366687567ULL) // "tlsfhug"
+
+static pthread_mutex_t preload_lock = PTHREAD_MUTEX_INITIALIZER;
+static tlsf_t preload_tlsf;
+static char *preload_base;
+static size_t preload_used;
+static size_t preload_reserved;
+static size_t preload_page;
+static pthread_key_t preload_key;
+static int preload_atfork_done;
+
+// initial-exec so touching the cache never has the TLS machinery allocate
+static __thread preload_cache thread_cache __attribute__((tls_model("initial-exec")));
+
+static void preload_thread_exit(void *arg);
+
+static size_t preload_page_align(size_t bytes) {
+
+	return (bytes + preload_page - 1) & ~(preload_page - 1);
+}
+
+static int preload_owns(const void *ptr) {
+
+	return (size_t)((const char *)ptr - preload_base) < preload_reserved;
+}
+
+// Called with the lock held
+static int preload_init_locked(void) {
+
+	if (preload_tlsf != NULL) {
+		return 1;
+	}
+
+	preload_page = (size_t)sysconf(_SC_PAGESIZE);
+
+	for (size_t bytes = PRELOAD_RESERVE; bytes >= PRELOAD_RESERVE_MIN && preload_base == NULL; bytes /= 2) {
+		void *mem = mmap(NULL, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (mem != MAP_FAILED) {
+			preload_base = mem;
+			preload_reserved = bytes;
+		}
+	}
+
+	if (preload_base == NULL || mprotect(preload_base, PRELOAD_POOL_SIZE, PROT_READ | PROT_WRITE) != 0) {
+		return 0;
+	}
+
+	preload_used = PRELOAD_POOL_SIZE;
+	preload_tlsf = tlsf_create_with_pool(preload_base, PRELOAD_POOL_SIZE);
+	pthread_key_create(&preload_key, preload_thread_exit);
+	return preload_tlsf != NULL;
+}
+
+// Commits another pool big enough for bytes, called with the lock held
+static int preload_grow_locked(size_t bytes) {
+
+	size_t pool_bytes = preload_page_align(bytes + tlsf_pool_overhead() + tlsf_alloc_overhead());
+	if (pool_bytes < PRELOAD_POOL_SIZE) {
+		pool_bytes = PRELOAD_POOL_SIZE;
+	}
+
+	if (preload_used + pool_bytes > preload_reserved) {
+		return 0;
+	}
+
+	char *mem = preload_base + preload_used;
+	if (mprotect(mem, pool_bytes, PROT_READ | PROT_WRITE) != 0) {
+		return 0;
+	}
+
+	preload_used += pool_bytes;
+	return tlsf_add_pool(preload_tlsf, mem, pool_bytes) != NULL;
+}
+
+static void *preload_alloc_locked(size_t align, size_t size) {
+
+	if (!preload_init_locked()) {
+		return NULL;
+	}
+
+	void *ptr = align <= TLSF_ALIGN_SIZE ? tlsf_malloc(preload_tlsf, size) : tlsf_memalign(preload_tlsf, align, size);
+	if (ptr == NULL && preload_grow_locked(size + align)) {
+		ptr = align <= TLSF_ALIGN_SIZE ? tlsf_malloc(preload_tlsf, size) : tlsf_memalign(preload_tlsf, align, size);
+	}
+	return ptr;
+}
+
+// Fork only clones the calling thread, so the heap can't be mid-update in the child
+static void preload_fork_prepare(void) {
+
+	pthread_mutex_lock(&preload_lock);
+}
+
+static void preload_fork_release(void) {
+
+	pthread_mutex_unlock(&preload_lock);
+}
+
+// Done outside the lock since pthread_atfork may allocate
+static void preload_register_atfork(void) {
+
+	if (!__atomic_exchange_n(&preload_atfork_done, 1, __ATOMIC_ACQ_REL)) {
+		pthread_atfork(preload_fork_prepare, preload_fork_release, preload_fork_release);
+	}
+}
+
+static void *preload_alloc(size_t align, size_t size) {
+
+	pthread_mutex_lock(&preload_lock);
+	void *ptr = preload_alloc_locked(align, size);
+	pthread_mutex_unlock(&preload_lock);
+
+	if (!preload_atfork_done) {
+		preload_register_atfork();
+	}
+	if (ptr == NULL) {
+		errno = ENOMEM;
+	}
+	return ptr;
+}
+
+static void *preload_huge_alloc(size_t align, size_t size) {
+
+	// The reserve has to exist before free can tell a huge pointer from a foreign one
+	if (preload_tlsf == NULL) {
+		pthread_mutex_lock(&preload_lock);
+		int ready = preload_init_locked();
+		pthread_mutex_unlock(&preload_lock);
+		if (!ready) {
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	size_t requested = align;
+	if (align < sizeof(preload_huge_header)) {
+		align = sizeof(preload_huge_header);
+	}
+
+	size_t length = preload_page_align(size + align + sizeof(preload_huge_header));
+	if (length < size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	uintptr_t ptr = ((uintptr_t)map + sizeof(preload_huge_header) + align - 1) & ~(uintptr_t)(align - 1);
+	preload_huge_header *header = (preload_huge_header *)ptr - 1;
+	header -> map = map;
+	header -> length = length;
+	header -> align = requested;
+	header -> magic = PRELOAD_HUGE_MAGIC ^ (uintptr_t)map;
+	return (void *)ptr;
+}
+
+// The header of a huge block, NULL for a pointer we never mapped (from before the preload or another allocator)
+static preload_huge_header *preload_huge_header_of(void *ptr) {
+
+	preload_huge_header *header = (preload_huge_header *)ptr - 1;
+
+	if (header -> magic != (PRELOAD_HUGE_MAGIC ^ (uintptr_t)header -> map)
+		|| ((uintptr_t)header -> map & (preload_page - 1)) != 0
+		|| (size_t)((char *)ptr - (char *)header -> map) >= header -> length) {
+		return NULL;
+	}
+	return header;
+}
+
+static void preload_huge_free(preload_huge_header *header) {
+
+	// Cleared first, a second free of the same pointer then finds nothing to unmap
+	header -> magic = 0;
+	munmap(header -> map, header -> length);
+}
+
+static size_t preload_huge_usable(void *ptr) {
+
+	preload_huge_header *header = preload_huge_header_of(ptr);
+	return header ? header -> length - (size_t)((char *)ptr - (char *)header -> map) : 0;
+}
+
+// Hands a whole list back to TLSF
+static void preload_flush_class(preload_cache *cache, int c, int keep) {
+
+	pthread_mutex_lock(&preload_lock);
+	while (cache -> counts[c] > keep) {
+		void *block = cache -> heads[c];
+		cache -> heads[c] = *(void **)block;
+		cache -> counts[c]--;
+		tlsf_free(preload_tlsf, block);
+	}
+	pthread_mutex_unlock(&preload_lock);
+}
+
+static void preload_thread_exit(void *arg) {
+
+	preload_cache *cache = arg;
+	cache -> state = -1;
+	for (int c = 0; c < PRELOAD_NUM_CLASSES; c++) {
+		if (cache -> counts[c]) {
+			preload_flush_class(cache, c, 0);
+		}
+	}
+}
+
+// Takes a batch of class c blocks from TLSF, returns one and caches the rest
+static void *preload_refill(preload_cache *cache, int c) {
+
+	size_t size = (size_t)c << PRELOAD_CLASS_SHIFT;
+
+	if (cache -> state == 0) {
+		// Set first, pthread_setspecific can allocate and land back here
+		cache -> state = 1;
+		pthread_mutex_lock(&preload_lock);
+		int ready = preload_init_locked();
+		pthread_mutex_unlock(&preload_lock);
+		if (ready) {
+			pthread_setspecific(preload_key, cache);
+		}
+	}
+
+	if (cache -> state < 0) {
+		return preload_alloc(0, size);
+	}
+
+	pthread_mutex_lock(&preload_lock);
+	void *ptr = preload_alloc_locked(0, size);
+	for (int i = 1; ptr != NULL && i < PRELOAD_BATCH; i++) {
+		void *block = tlsf_malloc(preload_tlsf, size);
+		if (block == NULL) {
+			break;
+		}
+		*(void **)block = cache -> heads[c];
+		cache -> heads[c] = block;
+		cache -> counts[c]++;
+	}
+	pthread_mutex_unlock(&preload_lock);
+
+	if (!preload_atfork_done) {
+		preload_register_atfork();
+	}
+	if (ptr == NULL) {
+		errno = ENOMEM;
+	}
+	return ptr;
+}
+
+// The exported entry points call these rather than each other, which keeps the calls off the PLT and
+// stops the compiler from folding malloc plus memset inside calloc into a call to calloc
+static void *preload_malloc(size_t size) {
+
+	if (size <= PRELOAD_MAX_CACHED) {
+		int c = size ? (int)((size + (1 << PRELOAD_CLASS_SHIFT) - 1) >> PRELOAD_CLASS_SHIFT) : 1;
+		preload_cache *cache = &thread_cache;
+
+		void *block = cache -> heads[c];
+		if (block != NULL) {
+			cache -> heads[c] = *(void **)block;
+			cache -> counts[c]--;
+			return block;
+		}
+		return preload_refill(cache, c);
+	}
+
+	if (size >= PRELOAD_HUGE_THRESHOLD) {
+		return preload_huge_alloc(0, size);
+	}
+	return preload_alloc(0, size);
+}
+
+static void preload_free(void *ptr) {
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	if (!preload_owns(ptr)) {
+		// Pointers from before the heap existed or without our header can't be ours, leave them be
+		preload_huge_header *header = preload_base != NULL ? preload_huge_header_of(ptr) : NULL;
+		if (header != NULL) {
+			preload_huge_free(header);
+		}
+		return;
+	}
+
+	// Sizes are multiples of 16, so a block goes in the class it can fully serve
+	size_t size = tlsf_block_size(ptr);
+	preload_cache *cache = &thread_cache;
+
+	if (size <= PRELOAD_MAX_CACHED && cache -> state > 0) {
+		int c = (int)(size >> PRELOAD_CLASS_SHIFT);
+		if (cache -> counts[c] >= PRELOAD_CACHE_COUNT) {
+			preload_flush_class(cache, c, PRELOAD_CACHE_COUNT / 2);
+		}
+		*(void **)ptr = cache -> heads[c];
+		cache -> heads[c] = ptr;
+		cache -> counts[c]++;
+		return;
+	}
+
+	pthread_mutex_lock(&preload_lock);
+	tlsf_free(preload_tlsf, ptr);
+	pthread_mutex_unlock(&preload_lock);
+}
+
+static size_t preload_usable_size(void *ptr) {
+
+	if (ptr == NULL) {
+		return 0;
+	}
+	return preload_owns(ptr) ? tlsf_block_size(ptr) : preload_huge_usable(ptr);
+}
+
+static void *preload_memalign(size_t align, size_t size) {
+
+	if (align == 0 || (align & (align - 1)) != 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (align <= TLSF_ALIGN_SIZE) {
+		return preload_malloc(size);
+	}
+	if (size >= PRELOAD_HUGE_THRESHOLD || align >= PRELOAD_POOL_SIZE / 4) {
+		return preload_huge_alloc(align, size);
+	}
+	return preload_alloc(align, size);
+}
+
+static void *preload_realloc(void *ptr, size_t size) {
+
+	if (ptr == NULL) {
+		return preload_malloc(size);
+	}
+	if (size == 0) {
+		preload_free(ptr);
+		return NULL;
+	}
+
+	// Not ours, there's no telling how much of it is safe to copy
+	preload_huge_header *header = NULL;
+	if (!preload_owns(ptr) && (preload_base == NULL || (header = preload_huge_header_of(ptr)) == NULL)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	size_t current = preload_usable_size(ptr);
+	size_t align = header != NULL ? header -> align : 0;
+
+	// Shrinking by less than half isn't worth moving for
+	if (size <= current && size >= current / 2) {
+		return ptr;
+	}
+
+	if (header != NULL) {
+		size_t offset = (size_t)((char *)ptr - (char *)header -> map);
+
+		// mremap keeps the offset into the page, so only alignments up to a page survive a move
+		if (size >= PRELOAD_HUGE_THRESHOLD && align <= preload_page) {
+			size_t length = preload_page_align(size + offset);
+			void *map = mremap(header -> map, header -> length, length, MREMAP_MAYMOVE);
+			if (map == MAP_FAILED) {
+				errno = ENOMEM;
+				return NULL;
+			}
+			header = (preload_huge_header *)((char *)map + offset) - 1;
+			header -> map = map;
+			header -> length = length;
+			header -> magic = PRELOAD_HUGE_MAGIC ^ (uintptr_t)map;
+			return (char *)map + offset;
+		}
+	} else if (size < PRELOAD_HUGE_THRESHOLD) {
+		// TLSF grows into the next block when it's free
+		pthread_mutex_lock(&preload_lock);
+		void *moved = tlsf_realloc(preload_tlsf, ptr, size);
+		if (moved == NULL && preload_grow_locked(size)) {
+			moved = tlsf_realloc(preload_tlsf, ptr, size);
+		}
+		pthread_mutex_unlock(&preload_lock);
+
+		if (moved == NULL) {
+			errno = ENOMEM;
+		}
+		return moved;
+	}
+
+	// Anything that was asked for aligned stays aligned
+	void *moved = align > TLSF_ALIGN_SIZE ? preload_memalign(align, size) : preload_malloc(size);
+	if (moved != NULL) {
+		memcpy(moved, ptr, size < current ? size : current);
+		preload_free(ptr);
+	}
+	return moved;
+}
+
+PRELOAD_EXPORT void *malloc(size_t size) {
+
+	return preload_malloc(size);
+}
+
+PRELOAD_EXPORT void free(void *ptr) {
+
+	preload_free(ptr);
+}
+
+PRELOAD_EXPORT size_t malloc_usable_size(void *ptr) {
+
+	return preload_usable_size(ptr);
+}
+
+PRELOAD_EXPORT void *calloc(size_t num, size_t size) {
+
+	size_t bytes;
+	if (__builtin_mul_overflow(num, size, &bytes)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	void *ptr = preload_malloc(bytes);
+
+	// Fresh mappings are already zero
+	if (ptr != NULL && preload_owns(ptr)) {
+		memset(ptr, 0, bytes);
+	}
+	return ptr;
+}
+
+
+PRELOAD_EXPORT void *realloc(void *ptr, size_t size) {
+
+	return preload_realloc(ptr, size);
+}
+
+PRELOAD_EXPORT void *reallocarray(void *ptr, size_t num, size_t size) {
+
+	size_t bytes;
+	if (__builtin_mul_overflow(num, size, &bytes)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return preload_realloc(ptr, bytes);
+}
+
+PRELOAD_EXPORT void *memalign(size_t align, size_t size) {
+
+	return preload_memalign(align, size);
+}
+
+PRELOAD_EXPORT int posix_memalign(void **out, size_t align, size_t size) {
+
+	if (align < sizeof(void *) || (align & (align - 1)) != 0) {
+		return EINVAL;
+	}
+
+	void *ptr = preload_memalign(align, size);
+	if (ptr == NULL) {
+		return ENOMEM;
+	}
+	*out = ptr;
+	return 0;
+}
+
+PRELOAD_EXPORT void *aligned_alloc(size_t align, size_t size) {
+
+	return preload_memalign(align, size);
+}
+
+PRELOAD_EXPORT void *valloc(size_t size) {
+
+	return preload_memalign((size_t)sysconf(_SC_PAGESIZE), size);
+}
+
+PRELOAD_EXPORT void *pvalloc(size_t size) {
+
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	return preload_memalign(page, (size + page - 1) & ~(page - 1));
+}
@@ -0,0 +1,8 @@
+/*
+** Small-heap TLSF: first-level lists stop at 16 MB, which is all an object
+** pool of that size can ever use, so the control structure stays small.
+*/
+#define TLSF_PREFIX tlsf_small
+#define TLSF_FL_INDEX_MAX 24
+
+#include "tlsf.c"
@@ -0,0 +1,65 @@
+#ifndef INCLUDED_tlsf_variants
+#define INCLUDED_tlsf_variants
+
+/*
+** Specialized TLSF configurations, each compiled from tlsf.c under its
+** own prefix so they can be used side by side with the default one:
+**
+**	tlsf_small_*  FL_INDEX_MAX 24: blocks and pools up to 16 MB, with a
+**	              control structure a third smaller than the default.
+**	tlsf_fine_*   SL_INDEX_COUNT 64 on 64-bit bitmaps: twice as many size
+**	              classes per power of two, for fragmentation-sensitive heaps.
+**	tlsf_large_*  FL_INDEX_MAX 40: blocks and pools up to 1 TB.
+**	tlsf_packed_* 32-bit offset links in the block headers: 16-byte
+**	              minimum blocks, pools up to 256 MB mapped within 8 GB of
+**	              the control structure.
+**
+** The API matches tlsf.h. Memory must only be handed back to the
+** configuration that allocated it.
+*/
+
+#include "tlsf.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define TLSF_DECLARE_VARIANT(p) \
+	tlsf_t p##_create(void* mem); \
+	tlsf_t p##_create_with_pool(void* mem, size_t bytes); \
+	void p##_destroy(tlsf_t tlsf); \
+	pool_t p##_get_pool(tlsf_t tlsf); \
+	pool_t p##_add_pool(tlsf_t tlsf, void* mem, size_t bytes); \
+	void p##_remove_pool(tlsf_t tlsf, pool_t pool); \
+	void* p##_malloc(tlsf_t tlsf, size_t bytes); \
+	void* p##_memalign(tlsf_t tlsf, size_t align, size_t bytes); \
+	void* p##_realloc(tlsf_t tlsf, void* ptr, size_t size); \
+	void* p##_realloc_aligned(tlsf_t tlsf, void* ptr, size_t align, size_t size); \
+	void* p##_calloc(tlsf_t tlsf, size_t elem_size, size_t num_elems); \
+	void p##_free(tlsf_t tlsf, void* ptr); \
+	size_t p##_expand(tlsf_t tlsf, void* ptr, size_t min_size, size_t max_size); \
+	void p##_set_deferred_free(tlsf_t tlsf, int enable); \
+	void p##_compact(tlsf_t tlsf); \
+	size_t p##_block_size(void* ptr); \
+	size_t p##_size(void); \
+	size_t p##_align_size(void); \
+	size_t p##_control_align(void); \
+	size_t p##_block_size_min(void); \
+	size_t p##_block_size_max(void); \
+	size_t p##_pool_overhead(void); \
+	size_t p##_alloc_overhead(void); \
+	size_t p##_fit_size(size_t size, size_t align); \
+	void p##_walk_pool(pool_t pool, tlsf_walker walker, void* user); \
+	int p##_check(tlsf_t tlsf); \
+	int p##_check_pool(pool_t pool);
+
+TLSF_DECLARE_VARIANT(tlsf_small)
+TLSF_DECLARE_VARIANT(tlsf_fine)
+TLSF_DECLARE_VARIANT(tlsf_large)
+TLSF_DECLARE_VARIANT(tlsf_packed)
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif
@@ -33,6 +33,9 @@ int main(int argc, char *argv[]) {
 ////		mem_speed_test(config, base_seed + i);
 		memory_stress_test(base_seed);
 //	}
+
+	const mem_perf_backend perf_backend = { "sdl", SDL_malloc, SDL_realloc, SDL_free };
+	mem_perf_compare(&perf_backend, 1, "mem_perf_sdl.csv", "mem_perf_sdl.json");
 //	window_test("Generic SDL Test");
 
 	SDL_Quit();